@@ -160,5 +160,5 @@ setup(
     data_files=[
         ('licenses', glob('doc/guides/third_party_licences.adoc')),
     ],
-    scripts=['scripts/expyld'],
+    scripts=['scripts/expyld', 'scripts/expyzygote', 'scripts/mkfldpy'],
 )
@@ -1,23 +1,28 @@
 """Python3 bindings for writing Enduro/X clients and servers"""
 
 import sys
-import ctypes
+import os
 import io
 import traceback
 
-flags = sys.getdlopenflags()
+if __name__+".endurox" in sys.builtin_module_names:
+    # linked statically in the binary (expyld -s), runtime is already visible
+    from .endurox import *
+else:
+    flags = sys.getdlopenflags()
 
-# Need as Enduro/X XA drivers are dynamically loaded, and
-# they need to see Enduro/X runtime.
-sys.setdlopenflags(flags | ctypes.RTLD_GLOBAL)
-from .endurox import *
-# change module name... for importeds symbols
-sys.setdlopenflags(flags)
+    # Need as Enduro/X XA drivers are dynamically loaded, and
+    # they need to see Enduro/X runtime.
+    sys.setdlopenflags(flags | os.RTLD_GLOBAL)
+    from .endurox import *
+    # change module name... for importeds symbols
+    sys.setdlopenflags(flags)
 
 from .ubfdict import UbfDict
 from .ubfdict import UbfDictFld
 from .ubfdict import UbfDictItems
 from .ubfdict import UbfDictItemsOcc
+from .ubfdict import fldtab_load
 
 __all__ = ['endurox']
 
@@ -0,0 +1,286 @@
+"""asyncio event loop bridged onto the ATMI server poller.
+
+The loop does not run its own blocking select. File descriptors registered
+by the loop selector are monitored by the XATMI server dispatcher with
+:func:`.tpext_addpollerfd`, and ready callbacks are processed when the
+dispatcher reports events. Thus coroutines (async DB drivers, HTTP clients,
+etc.) can share the server main thread with the ATMI services. Loop timers
+are fired by the server timer wheel (:func:`.ndrxpy_call_later`, Linux
+**timerfd**), no helper thread is used.
+
+.. code-block:: python
+    :caption: asyncio in ATMI server
+    :name: aio-example
+
+        import sys, asyncio
+        import endurox as e
+        import endurox.aio
+
+        class Server:
+
+            def tpsvrinit(self, args):
+                self.loop = endurox.aio.install()
+                self.loop.create_task(some_coroutine())
+                e.tpadvertise('SVC', 'SVC', Server.SVC)
+                return 0
+
+            def tpsvrdone(self):
+                endurox.aio.uninstall()
+
+            def SVC(self, args):
+                self.loop.create_task(other_coroutine(args.data))
+                return e.tpreturn(e.TPSUCCESS, 0, {})
+
+        if __name__ == '__main__':
+            e.tprun(Server(), sys.argv)
+
+The loop applies to single threaded ATMI servers only. Loop shall not be
+run by :meth:`asyncio.AbstractEventLoop.run_forever` or
+:meth:`asyncio.AbstractEventLoop.run_until_complete`.
+"""
+
+import asyncio
+import select
+import selectors
+import threading
+from asyncio import events
+
+from .endurox import *
+
+class NdrxSelector(selectors._BaseSelectorImpl):
+    """Selector which registers file descriptors to the XATMI server poller.
+    :meth:`select` does not block, it returns events collected from the
+    poller callbacks.
+    """
+
+    def __init__(self):
+        super().__init__()
+        # fd -> ready selector events
+        self._ready = {}
+        # fds waiting for the server init to complete
+        self._pending = set()
+        # user before poll callback, chained while fds are pending
+        self._prev_b4poll = None
+        self._kqueue = 'kqueue' == ndrx_epoll_mode()
+        # single callback object, so that all fds are delivered in one batch
+        self._on_events_cb = self._on_events
+        self.loop = None
+
+    def _poll_mask(self, events):
+        """Convert selector events to Enduro/X poller events"""
+        if self._kqueue:
+            # Enduro/X uses uint32 type for poller flags.
+            if events == selectors.EVENT_READ:
+                return select.KQ_FILTER_READ + 2**32
+            elif events == selectors.EVENT_WRITE:
+                return select.KQ_FILTER_WRITE + 2**32
+            raise NotImplementedError("kqueue mode does not support read and write on single fd")
+
+        mask = 0
+        if events & selectors.EVENT_READ:
+            mask |= select.POLLIN
+        if events & selectors.EVENT_WRITE:
+            mask |= select.POLLOUT
+        return mask
+
+    def _sel_mask(self, events):
+        """Convert Enduro/X poller events to selector events"""
+        if self._kqueue:
+            if events == select.KQ_FILTER_READ + 2**32:
+                return selectors.EVENT_READ
+            return selectors.EVENT_WRITE
+
+        mask = 0
+        if events & (select.POLLIN | select.POLLHUP | select.POLLERR):
+            mask |= selectors.EVENT_READ
+        if events & (select.POLLOUT | select.POLLHUP | select.POLLERR):
+            mask |= selectors.EVENT_WRITE
+        return mask
+
+    def _on_events(self, evlist):
+        """Poller batch callback, collect the events of the poll iteration
+        and run the loop"""
+        for fd, events, ptr1 in evlist:
+            key = self._fd_to_key.get(fd)
+            if key is not None:
+                self._ready[fd] = self._ready.get(fd, 0) | (self._sel_mask(events) & key.events)
+        if self._ready and self.loop is not None:
+            self.loop._ndrx_dispatch()
+        return 0
+
+    def _b4poll(self):
+        """Register the fds added while server was not yet initialized,
+        then give the callback back to the user handler (if any)"""
+        pending = self._pending
+        self._pending = set()
+        prev = self._prev_b4poll
+        self._prev_b4poll = None
+
+        if prev is not None:
+            tpext_addb4pollcb(prev)
+        else:
+            tpext_delb4pollcb()
+
+        for fd in pending:
+            key = self._fd_to_key.get(fd)
+            if key is not None:
+                tpext_addpollerfd(fd, self._poll_mask(key.events), None, self._on_events_cb, batch=True)
+
+        if prev is not None:
+            return prev()
+        return 0
+
+    def _add(self, fd, events):
+        """Add fd to the poller, or defer if server is in init phase"""
+        if self._pending:
+            self._pending.add(fd)
+            return
+        try:
+            tpext_addpollerfd(fd, self._poll_mask(events), None, self._on_events_cb, batch=True)
+        except AtmiException as ex:
+            if ex.code != TPEPROTO:
+                raise
+            # tpext_addb4pollcb() replaces the current callback, chain it
+            self._prev_b4poll = tpext_getb4pollcb()
+            self._pending.add(fd)
+            tpext_addb4pollcb(self._b4poll)
+
+    def register(self, fileobj, events, data=None):
+        key = super().register(fileobj, events, data)
+        try:
+            self._add(key.fd, events)
+        except Exception:
+            super().unregister(fileobj)
+            raise
+        return key
+
+    def unregister(self, fileobj):
+        key = super().unregister(fileobj)
+        self._ready.pop(key.fd, None)
+        if key.fd in self._pending:
+            self._pending.discard(key.fd)
+        else:
+            tpext_delpollerfd(key.fd)
+        return key
+
+    def select(self, timeout=None):
+        ret = []
+        ready = self._ready
+        self._ready = {}
+        for fd, mask in ready.items():
+            key = self._fd_to_key.get(fd)
+            if key is not None and mask:
+                ret.append((key, mask))
+        return ret
+
+    def close(self):
+        for key in list(self._fd_to_key.values()):
+            try:
+                self.unregister(key.fileobj)
+            except Exception:
+                pass
+        super().close()
+
+class NdrxEventLoop(asyncio.SelectorEventLoop):
+    """asyncio event loop driven by the XATMI server poller"""
+
+    def __init__(self):
+        super().__init__(NdrxSelector())
+        self._ndrx_in_dispatch = False
+        # poller timer (ndrxpy_call_later()) of the earliest loop timer
+        self._ndrx_timer = None
+        self._ndrx_timer_when = None
+        self._selector.loop = self
+
+    def run_forever(self):
+        raise RuntimeError("NdrxEventLoop is driven by the ATMI server poller")
+
+    def run_until_complete(self, future):
+        raise RuntimeError("NdrxEventLoop is driven by the ATMI server poller")
+
+    def call_soon(self, callback, *args, **kwargs):
+        handle = super().call_soon(callback, *args, **kwargs)
+        if not self._ndrx_in_dispatch:
+            # scheduled from the service, process at next poll
+            self._write_to_self()
+        return handle
+
+    def call_at(self, when, callback, *args, **kwargs):
+        handle = super().call_at(when, callback, *args, **kwargs)
+        if not self._ndrx_in_dispatch:
+            self._ndrx_arm(when)
+        return handle
+
+    def _ndrx_arm(self, when):
+        """Arm the poller timer for loop time *when*, unless armed earlier"""
+        if self._ndrx_timer is not None:
+            if self._ndrx_timer_when <= when:
+                return
+            ndrxpy_timer_cancel(self._ndrx_timer)
+        self._ndrx_timer_when = when
+        self._ndrx_timer = ndrxpy_call_later(max(when - self.time(), 0.001), self._ndrx_on_timer)
+
+    def _ndrx_on_timer(self):
+        """Poller timer callback, run the expired loop timers"""
+        self._ndrx_timer = None
+        self._ndrx_timer_when = None
+        self._ndrx_dispatch()
+
+    def _ndrx_dispatch(self):
+        """Process collected events, expired timers and ready callbacks"""
+        if self._ndrx_in_dispatch or self.is_closed():
+            return
+
+        old = events._get_running_loop()
+        events._set_running_loop(self)
+        self._thread_id = threading.get_ident()
+        self._ndrx_in_dispatch = True
+        try:
+            self._run_once()
+        finally:
+            self._ndrx_in_dispatch = False
+            self._thread_id = None
+            events._set_running_loop(old)
+
+        if self._ready:
+            # more work, continue after the server has served the requests
+            self._write_to_self()
+        elif self._scheduled:
+            self._ndrx_arm(self._scheduled[0]._when)
+
+    def close(self):
+        if self._ndrx_timer is not None:
+            ndrxpy_timer_cancel(self._ndrx_timer)
+            self._ndrx_timer = None
+        super().close()
+
+# Loop installed for the server
+_loop = None
+
+def install():
+    """Create :class:`NdrxEventLoop` and set it as current event loop. Shall be
+    called from :py:meth:`Server.tpsvrinit()`. If file descriptors cannot be
+    added to the poller at init phase, they are added by the before poll
+    callback (:func:`.tpext_addb4pollcb`), which is removed after the first poll.
+    Before poll callback set by the user is chained and restored afterwards.
+
+    Returns
+    -------
+    loop : NdrxEventLoop
+        Installed event loop.
+    """
+    global _loop
+    if _loop is None:
+        _loop = NdrxEventLoop()
+        asyncio.set_event_loop(_loop)
+    return _loop
+
+def uninstall():
+    """Close the installed loop, shall be called from :py:meth:`Server.tpsvrdone()`."""
+    global _loop
+    if _loop is not None:
+        asyncio.set_event_loop(None)
+        _loop.close()
+        _loop = None
+
+# vim: set ts=4 sw=4 et smartindent:
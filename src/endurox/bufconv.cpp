@@ -334,7 +334,18 @@ expublic atmibuf ndrx_from_py(py::object obj, bool reset_ptr)
         ndrx_longptr_t ptr = data.attr("_buf").cast<py::int_>();
         atmibuf *data_buf = reinterpret_cast<atmibuf *>(ptr);
 
-        if (reset_ptr)
+        if (NDRXPY_SUBBUF_ARENA==data.attr("_is_sub_buffer").cast<int>())
+        {
+            //Arena memory is not XATMI buffer, pass the copy
+            UBFH *src = *data_buf->fbfr();
+            buf = atmibuf("UBF", Bused(src));
+
+            if (EXSUCCEED!=Bcpy(*buf.fbfr(), src))
+            {
+                throw ubf_exception(Berror);
+            }
+        }
+        else if (reset_ptr)
         {
             buf.p = data_buf->p;
             ndrxpy_reset_ptr_UbfDict(data);
@@ -50,18 +50,147 @@
 #include <pybind11/stl.h>
 
 #include <functional>
+#include <stdint.h>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
 
 namespace py = pybind11;
 
 /*---------------------------Externs------------------------------------*/
 /*---------------------------Macros-------------------------------------*/
+#define NDRXPY_UBFRAW_MAGIC     "UBFR"  /**< Raw UBF image magic            */
+#define NDRXPY_UBFRAW_VERSION   1       /**< Raw UBF image header version   */
+#define NDRXPY_UBFRAW_ENDIAN    0x0102  /**< Written in host byte order     */
 /*---------------------------Enums--------------------------------------*/
 /*---------------------------Typedefs-----------------------------------*/
+
+/**
+ * Header of the raw UBF image (pickle)
+ */
+typedef struct
+{
+    char magic[4];          /**< NDRXPY_UBFRAW_MAGIC                        */
+    uint16_t endian;        /**< NDRXPY_UBFRAW_ENDIAN                       */
+    uint8_t version;        /**< NDRXPY_UBFRAW_VERSION                      */
+    uint8_t longsz;         /**< sizeof(long) of the producer               */
+    uint32_t bufsz;         /**< Bsizeof() of the source buffer             */
+    uint32_t used;          /**< Bused() i.e. image length                  */
+} ndrxpy_ubfraw_hdr_t;
+
+/**
+ * Read-only buffer protocol view over the used part of the UbfDict buffer.
+ * Keeps the UbfDict alive while exported.
+ */
+struct ndrxpy_ubfraw
+{
+    py::object owner;       /**< UbfDict object                             */
+    char *data;             /**< UBF buffer                                 */
+    long len;               /**< Used length                                */
+};
+
+/**
+ * Field name/id cache. Immutable once published, each load adds
+ * table with the fields not known yet.
+ */
+struct ndrxpy_fldtab
+{
+    std::unordered_map<std::string, BFLDID> ids;    /**< name to id */
+    std::unordered_map<BFLDID, std::string> names;  /**< id to name */
+    ndrxpy_fldtab *next;                            /**< previous load */
+};
 /*---------------------------Globals------------------------------------*/
 /*---------------------------Statics------------------------------------*/
 py::module_ M_endurox;    /**< Loader module handle. Any houskeeping on unload? */
+
+/**
+ * Field tables, loaded from modules generated by mkfldpy, newest first.
+ * Head is published by pointer swap, as lookups run with GIL released.
+ * Tables are owned by the module and never freed, so that returned names
+ * stay valid. Memory is bounded by the number of distinct fields loaded,
+ * as reloads add only the changed entries.
+ */
+exprivate std::atomic<ndrxpy_fldtab *> M_fldtab {nullptr};
 /*---------------------------Prototypes---------------------------------*/
 
+/**
+ * Find field id in the loaded tables
+ * @param tab tables head
+ * @param name field name
+ * @return field id or BBADFLDID if not loaded
+ */
+exprivate BFLDID ndrxpy_fldtab_id(ndrxpy_fldtab *tab, const std::string &name)
+{
+    for (; nullptr!=tab; tab=tab->next)
+    {
+        auto it = tab->ids.find(name);
+
+        if (it!=tab->ids.end())
+        {
+            return it->second;
+        }
+    }
+
+    return BBADFLDID;
+}
+
+/**
+ * Find field name in the loaded tables
+ * @param tab tables head
+ * @param fldid field id
+ * @return field name or NULL if not loaded
+ */
+exprivate const std::string *ndrxpy_fldtab_name(ndrxpy_fldtab *tab, BFLDID fldid)
+{
+    for (; nullptr!=tab; tab=tab->next)
+    {
+        auto it = tab->names.find(fldid);
+
+        if (it!=tab->names.end())
+        {
+            return &it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * Resolve field id by name. Loaded field tables are used first, then
+ * the UBF library.
+ * @param name field name
+ * @return field id or BBADFLDID (Berror set)
+ */
+expublic BFLDID ndrxpy_fldid(const char *name)
+{
+    BFLDID fldid = ndrxpy_fldtab_id(M_fldtab.load(std::memory_order_acquire), name);
+
+    if (BBADFLDID!=fldid)
+    {
+        return fldid;
+    }
+
+    return Bfldid(const_cast<char *>(name));
+}
+
+/**
+ * Resolve field name by id. Loaded field tables are used first, then
+ * the UBF library.
+ * @param fldid field id
+ * @return field name or NULL (Berror set)
+ */
+expublic char *ndrxpy_fldname(BFLDID fldid)
+{
+    const std::string *name = ndrxpy_fldtab_name(M_fldtab.load(std::memory_order_acquire), fldid);
+
+    if (nullptr!=name)
+    {
+        return const_cast<char *>(name->c_str());
+    }
+
+    return Bfname(fldid);
+}
+
 /**
  * check is given object a UbfDict typed
  * @param data Python data object
@@ -306,7 +435,7 @@ expublic py::object ndrxpy_to_py_ubf(UBFH *fbfr, BFLDLEN buflen = 0)
         {
             val = py::list();
 
-            char *name = Bfname(fldid);
+            char *name = ndrxpy_fldname(fldid);
             if (name != nullptr)
             {
                 result[name] = val;
@@ -499,10 +628,32 @@ static void from_py1_ubf(atmibuf &buf, BFLDID fldid, BFLDOCC oc,
     }
     else if (ndrxpy_is_atmibuf_UbfDict(obj))
     {
-        if (BFLD_PTR==Bfldtype(fldid))
+        auto data = obj[NDRXPY_DATA_DATA];
+
+        if (BFLD_PTR==Bfldtype(fldid) && 
+            NDRXPY_SUBBUF_ARENA==data.attr("_is_sub_buffer").cast<int>())
+        {
+            //Arena memory is not XATMI buffer, field gets the copy and
+            //the view keeps its arena reference
+            atmibuf tmp = ndrx_from_py(obj.cast<py::object>(), false);
+
+            buf.mutate([&](UBFH *fbfr)
+                    { 
+                        if (chg)
+                        {
+                            return Bchg(fbfr, fldid, oc, reinterpret_cast<char *>(tmp.pp), 0); 
+                        }
+                        else
+                        {
+                            return Baddfast(fbfr, fldid, reinterpret_cast<char *>(tmp.pp), 0, loc); 
+                        }
+                    }, loc);
+
+            //Owned by the PTR field now
+            tmp.p = nullptr;
+        }
+        else if (BFLD_PTR==Bfldtype(fldid))
         {
-            auto data = obj[NDRXPY_DATA_DATA];
-            
             ndrx_longptr_t ptr = data.attr("_buf").cast<py::int_>();
             atmibuf *p_buf = reinterpret_cast<atmibuf *>(ptr);
             buf.mutate([&](UBFH *fbfr)
@@ -653,7 +804,7 @@ exprivate BFLDID ndrxpy_fldid_resolve(py::handle fld)
 	{
         std::string s = std::string(py::str(fld));
 		char *fldstr = const_cast<char *>(s.c_str());
-		fldid = Bfldid(fldstr);
+		fldid = ndrxpy_fldid(fldstr);
 
 		if (BBADFLDID==fldid)
 		{
@@ -782,6 +933,91 @@ exprivate BFLDOCC fix_occ(atmibuf *buf, BFLDID fldid, BFLDOCC oc)
     return oc;
 }
 
+/**
+ * Check is there any BFLD_PTR field in the buffer (incl. embedded UBFs).
+ * Such buffers cannot be moved to other process as raw image.
+ * @param p_ub UBF buffer
+ * @return true if have pointer fields
+ */
+exprivate bool ndrxpy_ubf_has_ptr(UBFH *p_ub)
+{
+    Bnext_state_t state;
+    BFLDID fldid = BFIRSTFLDID;
+    BFLDOCC oc;
+    char *d_ptr;
+    int ret;
+
+    while (1==(ret=Bnext2(&state, p_ub, &fldid, &oc, NULL, NULL, &d_ptr)))
+    {
+        int typ = Bfldtype(fldid);
+
+        if (BFLD_PTR==typ)
+        {
+            return true;
+        }
+        else if (BFLD_UBF==typ && ndrxpy_ubf_has_ptr(reinterpret_cast<UBFH *>(d_ptr)))
+        {
+            return true;
+        }
+    }
+
+    if (EXFAIL==ret)
+    {
+        throw ubf_exception(Berror);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Make sure buffer has free space for the data of other buffer,
+ *  so that bulk operations do not fail half way.
+ * @param buf destination buffer
+ * @param need bytes needed
+ */
+exprivate void ndrxpy_ubf_reserve(atmibuf *buf, long need)
+{
+    long unused = Bunused(*buf->fbfr());
+
+    if (EXFAIL==unused)
+    {
+        throw ubf_exception(Berror);
+    }
+
+    if (unused < need)
+    {
+        long size = Bsizeof(*buf->fbfr()) + need;
+        char *p = tprealloc(*buf->pp, size);
+
+        if (nullptr==p)
+        {
+            throw atmi_exception(tperrno);
+        }
+
+        *buf->pp = p;
+        buf->len = size;
+    }
+}
+
+/**
+ * @brief Resolve field names / ids to BBADFLDID terminated list
+ * @param fields iterable of field names or ids
+ * @return field id list
+ */
+exprivate std::vector<BFLDID> ndrxpy_fldlist_resolve(py::iterable fields)
+{
+    std::vector<BFLDID> ret;
+
+    for (auto fld : fields)
+    {
+        ret.push_back(ndrxpy_fldid_resolve(fld));
+    }
+
+    ret.push_back(BBADFLDID);
+
+    return ret;
+}
+
 /**
  * @brief Register UBF specific functions
  * 
@@ -1243,6 +1479,11 @@ expublic void ndrxpy_register_ubf(py::module &m)
             /*
              * Do not remove sub-buffer (i.e. do not destruct!)
              */
+            if (NDRXPY_SUBBUF_ARENA==is_sub_buffer)
+            {
+                ndrxpy_ubfarena_unref(buf->p);
+            }
+
             if (is_sub_buffer!=NDRXPY_SUBBUF_NORM)
             {
                 buf->p = nullptr;
@@ -1445,14 +1686,11 @@ expublic void ndrxpy_register_ubf(py::module &m)
 
             UBF_LOG(log_debug, "UbfDict_copy src_buf (atmi): %p", *src_buf->pp);
 
+            //Embedded and arena buffers are not XATMI buffers, 
+            //copy them as UBF
             long len = tptypes(*src_buf->pp, btype, stype);
 
-            if (EXFAIL==len)
-            {
-                throw atmi_exception(tperrno);
-            }
-
-            if (0!=strcmp(btype, "UBF"))
+            if (EXFAIL!=len && 0!=strcmp(btype, "UBF"))
             {
                 throw std::invalid_argument("Epxected UBF typed buffer, but got ["+std::string(btype)+"]");
             }
@@ -1466,17 +1704,25 @@ expublic void ndrxpy_register_ubf(py::module &m)
                 throw ubf_exception(Berror);
             }
 
-            char *ret_buf = tpalloc(btype, NULL, used);
+            char *ret_buf = tpalloc(const_cast<char *>("UBF"), NULL, used);
 
             if (nullptr==ret_buf)
             {
                 throw atmi_exception(tperrno);
             }
 
+            //Source buffer size may be larger than the new one,
+            //thus copy by UBF, not the memory
+            if (EXSUCCEED!=Bcpy(reinterpret_cast<UBFH *>(ret_buf), *src_buf->fbfr()))
+            {
+                UBF_LOG(log_error, "Failed to copy buffer [%p]: %s", 
+                    *src_buf->pp, Bstrerror(Berror));
+                tpfree(ret_buf);
+                throw ubf_exception(Berror);
+            }
+
             try
             {
-                //OK copy
-                memcpy(ret_buf, *src_buf->pp, used);
                 auto ret_atmibuf = new atmibuf();
                 ret_atmibuf->p = ret_buf;
                 ndrx_longptr_t ptr = reinterpret_cast<ndrx_longptr_t>(ret_atmibuf);
@@ -1505,6 +1751,169 @@ expublic void ndrxpy_register_ubf(py::module &m)
 
         )pbdoc", py::arg("ptr"));
 
+    m.def(
+        "UbfDict_update",
+        [](ndrx_longptr_t dst_ptr, ndrx_longptr_t src_ptr)
+        {
+            atmibuf *dst = reinterpret_cast<atmibuf *>(dst_ptr);
+            atmibuf *src = reinterpret_cast<atmibuf *>(src_ptr);
+            py::gil_scoped_release release;
+
+            ndrxpy_ubf_reserve(dst, Bused(*src->fbfr()));
+
+            if (EXSUCCEED!=Bupdate(*dst->fbfr(), *src->fbfr()))
+            {
+                UBF_LOG(log_error, "Bupdate failed: %s", Bstrerror(Berror));
+                throw ubf_exception(Berror);
+            }
+        },
+        R"pbdoc(
+        Update fields of the buffer from other buffer (**Bupdate(3)**).
+
+        Parameters
+        ----------
+        dst_ptr: int
+            C pointer to atmibuf which is updated
+        src_ptr: int
+            C pointer to atmibuf from which to take the fields
+
+        )pbdoc", py::arg("dst_ptr"), py::arg("src_ptr"));
+
+    m.def(
+        "UbfDict_concat",
+        [](ndrx_longptr_t dst_ptr, ndrx_longptr_t src_ptr)
+        {
+            atmibuf *dst = reinterpret_cast<atmibuf *>(dst_ptr);
+            atmibuf *src = reinterpret_cast<atmibuf *>(src_ptr);
+            py::gil_scoped_release release;
+
+            ndrxpy_ubf_reserve(dst, Bused(*src->fbfr()));
+
+            if (EXSUCCEED!=Bconcat(*dst->fbfr(), *src->fbfr()))
+            {
+                UBF_LOG(log_error, "Bconcat failed: %s", Bstrerror(Berror));
+                throw ubf_exception(Berror);
+            }
+        },
+        R"pbdoc(
+        Add all field occurrences of other buffer (**Bconcat(3)**).
+
+        Parameters
+        ----------
+        dst_ptr: int
+            C pointer to atmibuf to which fields are added
+        src_ptr: int
+            C pointer to atmibuf from which to take the fields
+
+        )pbdoc", py::arg("dst_ptr"), py::arg("src_ptr"));
+
+    m.def(
+        "UbfDict_project",
+        [](ndrx_longptr_t ptr, py::iterable fields)
+        {
+            atmibuf *buf = reinterpret_cast<atmibuf *>(ptr);
+            std::vector<BFLDID> flist = ndrxpy_fldlist_resolve(fields);
+            py::gil_scoped_release release;
+
+            if (EXSUCCEED!=Bproj(*buf->fbfr(), flist.data()))
+            {
+                UBF_LOG(log_error, "Bproj failed: %s", Bstrerror(Berror));
+                throw ubf_exception(Berror);
+            }
+        },
+        R"pbdoc(
+        Keep only given fields in the buffer (**Bproj(3)**).
+
+        Parameters
+        ----------
+        ptr: int
+            C pointer to atmibuf
+        fields: list
+            Field names or ids
+
+        )pbdoc", py::arg("ptr"), py::arg("fields"));
+
+    m.def(
+        "UbfDict_projcpy",
+        [](ndrx_longptr_t ptr, py::iterable fields)
+        {
+            atmibuf *src = reinterpret_cast<atmibuf *>(ptr);
+            std::vector<BFLDID> flist = ndrxpy_fldlist_resolve(fields);
+            char *ret_buf;
+
+            {
+                py::gil_scoped_release release;
+                long used = Bused(*src->fbfr());
+
+                if (EXFAIL==used)
+                {
+                    throw ubf_exception(Berror);
+                }
+
+                ret_buf = tpalloc(const_cast<char *>("UBF"), NULL, used);
+
+                if (nullptr==ret_buf)
+                {
+                    throw atmi_exception(tperrno);
+                }
+
+                if (EXSUCCEED!=Bprojcpy(reinterpret_cast<UBFH *>(ret_buf),
+                        *src->fbfr(), flist.data()))
+                {
+                    UBF_LOG(log_error, "Bprojcpy failed: %s", Bstrerror(Berror));
+                    tpfree(ret_buf);
+                    throw ubf_exception(Berror);
+                }
+            }
+
+            auto ret_atmibuf = new atmibuf();
+            ret_atmibuf->p = ret_buf;
+            return reinterpret_cast<ndrx_longptr_t>(ret_atmibuf);
+        },
+        R"pbdoc(
+        Copy given fields to new buffer (**Bprojcpy(3)**).
+
+        Parameters
+        ----------
+        ptr: int
+            C pointer to atmibuf from which to copy data.
+        fields: list
+            Field names or ids
+
+        Returns
+        -------
+        ret : int
+            Pointer to atmibuf
+
+        )pbdoc", py::arg("ptr"), py::arg("fields"));
+
+    m.def(
+        "UbfDict_delete_fields",
+        [](ndrx_longptr_t ptr, py::iterable fields)
+        {
+            atmibuf *buf = reinterpret_cast<atmibuf *>(ptr);
+            std::vector<BFLDID> flist = ndrxpy_fldlist_resolve(fields);
+            py::gil_scoped_release release;
+
+            //None of the fields present is not an error
+            if (EXSUCCEED!=Bdelete(*buf->fbfr(), flist.data()) && BNOTPRES!=Berror)
+            {
+                UBF_LOG(log_error, "Bdelete failed: %s", Bstrerror(Berror));
+                throw ubf_exception(Berror);
+            }
+        },
+        R"pbdoc(
+        Delete all occurrences of given fields (**Bdelete(3)**).
+
+        Parameters
+        ----------
+        ptr: int
+            C pointer to atmibuf
+        fields: list
+            Field names or ids
+
+        )pbdoc", py::arg("ptr"), py::arg("fields"));
+
     m.def(
         "UbfDict_len",
         [](ndrx_longptr_t ptr)
@@ -1649,7 +2058,7 @@ expublic void ndrxpy_register_ubf(py::module &m)
                 throw ubf_exception(Berror);
             }
 
-            char *fname = Bfname(buf->iter_fldid);
+            char *fname = ndrxpy_fldname(buf->iter_fldid);
 
             if (NULL!=fname)
             {
@@ -1706,7 +2115,7 @@ expublic void ndrxpy_register_ubf(py::module &m)
                 throw ubf_exception(Berror);
             }
 
-            char *fname = Bfname(buf->iter_fldid);
+            char *fname = ndrxpy_fldname(buf->iter_fldid);
 
             if (NULL!=fname)
             {
@@ -1764,7 +2173,7 @@ expublic void ndrxpy_register_ubf(py::module &m)
                 throw ubf_exception(Berror);
             }
 
-            char *fname = Bfname(buf->iter_fldid);
+            char *fname = ndrxpy_fldname(buf->iter_fldid);
 
             if (nullptr==fname)
             {
@@ -2291,6 +2700,52 @@ expublic void ndrxpy_register_ubf(py::module &m)
 
         )pbdoc", py::arg("do_use"));
 
+        m.def(
+        "ndrxpy_fldtab_load",
+        [](py::dict ids)
+        {
+            /* loads are serialized by GIL */
+            ndrxpy_fldtab *head = M_fldtab.load(std::memory_order_acquire);
+            std::unique_ptr<ndrxpy_fldtab> tab(new ndrxpy_fldtab());
+
+            tab->next = head;
+
+            for (auto it : ids)
+            {
+                std::string name = py::str(it.first);
+                BFLDID fldid = it.second.cast<BFLDID>();
+                const std::string *prev = ndrxpy_fldtab_name(head, fldid);
+
+                //Already loaded (e.g. module reload)
+                if (ndrxpy_fldtab_id(head, name)==fldid && nullptr!=prev && *prev==name)
+                {
+                    continue;
+                }
+
+                tab->ids[name] = fldid;
+                tab->names[fldid] = name;
+            }
+
+            UBF_LOG(log_debug, "Field table cache: %d new fields",
+                static_cast<int>(tab->ids.size()));
+
+            if (!tab->ids.empty())
+            {
+                M_fldtab.store(tab.release(), std::memory_order_release);
+            }
+        },
+        R"pbdoc(
+        Load field name/id table to the module cache, used by field
+        resolution before the UBF field tables. Called by modules generated
+        by **mkfldpy**.
+
+        Parameters
+        ----------
+        ids: dict
+            Field name to field id.
+
+        )pbdoc", py::arg("ids"));
+
         // Represent dictionary key
         m.def(
         "ndrxpy_ubfdict_delonset",
@@ -2340,6 +2795,133 @@ expublic void ndrxpy_register_ubf(py::module &m)
 
         )pbdoc", py::arg("delonset"));
 
+        py::class_<ndrxpy_ubfraw>(m, "UbfDictRaw", py::buffer_protocol())
+            .def_buffer([](ndrxpy_ubfraw &r) -> py::buffer_info
+            {
+                return py::buffer_info(r.data, sizeof(char), 
+                    py::format_descriptor<unsigned char>::format(), 1, 
+                    {r.len}, {1}, true);
+            });
+
+        m.def(
+        "UbfDict_raw",
+        [](py::object ubf_dict)
+        {
+            ndrx_longptr_t ptr = ubf_dict.attr("_buf").cast<py::int_>();
+            atmibuf *buf = reinterpret_cast<atmibuf *>(ptr);
+            UBFH *p_ub = *buf->fbfr();
+            ndrxpy_ubfraw_hdr_t hdr;
+            long used, size;
+
+            if (EXFAIL==(used = Bused(p_ub)) || EXFAIL==(size = Bsizeof(p_ub)))
+            {
+                throw ubf_exception(Berror);
+            }
+
+            if (ndrxpy_ubf_has_ptr(p_ub))
+            {
+                UBF_LOG(log_debug, "Buffer %p has BFLD_PTR fields, no raw image", p_ub);
+                return py::make_tuple(py::none(), py::none());
+            }
+
+            memset(&hdr, 0, sizeof(hdr));
+            memcpy(hdr.magic, NDRXPY_UBFRAW_MAGIC, sizeof(hdr.magic));
+            hdr.endian = NDRXPY_UBFRAW_ENDIAN;
+            hdr.version = NDRXPY_UBFRAW_VERSION;
+            hdr.longsz = sizeof(long);
+            hdr.bufsz = size;
+            hdr.used = used;
+
+            ndrxpy_ubfraw raw;
+            raw.owner = ubf_dict;
+            raw.data = reinterpret_cast<char *>(p_ub);
+            raw.len = used;
+
+            return py::make_tuple(py::bytes(reinterpret_cast<char *>(&hdr), sizeof(hdr)),
+                py::cast(std::move(raw)));
+        },
+        R"pbdoc(
+        Get raw image of the UBF buffer (used part), for pickling.
+
+        Parameters
+        ----------
+        ubf_dict: UbfDict
+            UBF Buffer dictionary
+
+        Returns
+        -------
+        hdr : bytes
+            Image header (version, byte order). **None** if buffer contains
+            :data:`.BFLD_PTR` fields, which cannot be moved to other process.
+        raw : UbfDictRaw
+            Read-only buffer protocol object over the UBF buffer. Buffer shall
+            not be modified while *raw* is in use.
+
+        )pbdoc", py::arg("ubf_dict"));
+
+        m.def(
+        "UbfDict_from_raw",
+        [](py::bytes pyhdr, py::buffer data)
+        {
+            std::string hdrs = pyhdr;
+            ndrxpy_ubfraw_hdr_t hdr;
+            py::buffer_info info = data.request();
+
+            if (hdrs.size()!=sizeof(hdr))
+            {
+                throw std::invalid_argument("Invalid UBF image header size");
+            }
+
+            memcpy(&hdr, hdrs.data(), sizeof(hdr));
+
+            if (0!=memcmp(hdr.magic, NDRXPY_UBFRAW_MAGIC, sizeof(hdr.magic)) ||
+                NDRXPY_UBFRAW_VERSION!=hdr.version)
+            {
+                throw std::invalid_argument("Invalid UBF image header");
+            }
+
+            if (NDRXPY_UBFRAW_ENDIAN!=hdr.endian || sizeof(long)!=hdr.longsz)
+            {
+                throw std::invalid_argument("UBF image from incompatible platform");
+            }
+
+            if (static_cast<size_t>(info.size * info.itemsize) != hdr.used || hdr.used > hdr.bufsz)
+            {
+                throw std::invalid_argument("Invalid UBF image size");
+            }
+
+            /* allocate full size, as the size is kept in the image too */
+            char *ret_buf = tpalloc(const_cast<char *>("UBF"), NULL, hdr.bufsz);
+
+            if (nullptr==ret_buf)
+            {
+                throw atmi_exception(tperrno);
+            }
+
+            memcpy(ret_buf, info.ptr, hdr.used);
+
+            auto ret_atmibuf = new atmibuf();
+            ret_atmibuf->p = ret_buf;
+
+            return reinterpret_cast<ndrx_longptr_t>(ret_atmibuf);
+        },
+        R"pbdoc(
+        Allocate UBF buffer from the raw image produced by :func:`UbfDict_raw`.
+
+        Parameters
+        ----------
+        hdr: bytes
+            Image header
+        data: object
+            Buffer protocol object with the image
+
+        Returns
+        -------
+        ret : int
+            Pointer to atmibuf
+
+        )pbdoc", py::arg("hdr"), py::arg("data"));
+
 }
 
 /* vim: set ts=4 sw=4 et smartindent: */
@@ -205,6 +205,16 @@ PYBIND11_MODULE(endurox, m)
     ndrxpy_register_util(m);
     ndrxpy_register_tpext(m);
     ndrxpy_register_tplog(m);
+    ndrxpy_register_svccache(m);
+    ndrxpy_register_svcstats(m);
+    ndrxpy_register_tptimer(m);
+    ndrxpy_register_unsolq(m);
+    ndrxpy_register_qconsumer(m);
+    ndrxpy_register_grpcommit(m);
+    ndrxpy_register_tplogasync(m);
+    ndrxpy_register_ubfarena(m);
+    ndrxpy_register_ubfjson(m);
+    ndrxpy_register_ubfdelta(m);
 
     m.attr("TPEV_DISCONIMM") = py::int_(TPEV_DISCONIMM);
     m.attr("TPEV_SVCERR") = py::int_(TPEV_SVCERR);
@@ -505,6 +515,11 @@ Python3 bindings for writing Enduro/X clients and servers
         tplog_error
         tplog_always
         tplog_exception
+        tplog_level
+        tplog_isenabledfor
+        tplog_async
+        tplog_flush
+        tplog_async_stats
         tplogconfig
         tplogqinfo
         tplogsetreqfile
@@ -567,9 +582,14 @@ Python3 bindings for writing Enduro/X clients and servers
         tpopen
         tpclose
         tpexport
+        tpexport_into
+        tpexport_many
         tpimport
+        tpimport_iter
         tpenqueue
         tpdequeue
+        tpenqueue_many
+        tpdequeue_many
         tpscmt
         tpencrypt
         tpdecrypt
@@ -580,6 +600,8 @@ Python3 bindings for writing Enduro/X clients and servers
         tpreturn
         tpforward
         tpadvertise
+        tpadvertise_route
+        tpadvertise_batch
         tpunadvertise
         tpsrvgetctxdata
         tpsrvsetctxdata
@@ -587,6 +609,7 @@ Python3 bindings for writing Enduro/X clients and servers
         tpexit
         tpext_addb4pollcb
         tpext_delb4pollcb
+        tpext_getb4pollcb
         tpext_delperiodcb
         tpext_addpollerfd
         tpext_delpollerfd
@@ -594,6 +617,18 @@ Python3 bindings for writing Enduro/X clients and servers
         ndrx_stdcfgstr_parse
         ndrxpy_ubfdict_enable
         ndrxpy_ubfdict_delonset
+        ndrxpy_svccache_add
+        ndrxpy_svccache_invalidate
+        ndrxpy_svccache_stats
+        ndrxpy_svcstats_enable
+        ndrxpy_svcstats_get
+        ndrxpy_svcstats_reset
+        ndrxpy_call_later
+        ndrxpy_call_every
+        ndrxpy_timer_cancel
+        ndrxpy_unsolq_enable
+        ndrxpy_unsolq_drain
+        ndrxpy_unsolq_stats
 
 How to read this documentation
 ==============================
@@ -51,6 +51,8 @@
 
 #include <functional>
 #include <map>
+#include <string>
+#include <vector>
 
 #ifdef EX_OS_AIX
 #undef __MULTILOCALE_API
@@ -59,6 +61,10 @@
 
 /*---------------------------Externs------------------------------------*/
 /*---------------------------Macros-------------------------------------*/
+#define NDRXPY_EXPORT_GROW      4       /**< Output buffer grow attempts    */
+#define NDRXPY_EXPORT_RATIO     8       /**< Output estimate per input byte */
+#define NDRXPY_EXPORT_HDRSZ     1024    /**< Output estimate, buffer header */
+#define NDRXPY_EXPORT_CHUNK     65536   /**< File write size of bulk export */
 /*---------------------------Enums--------------------------------------*/
 /*---------------------------Typedefs-----------------------------------*/
 
@@ -74,10 +80,110 @@ typedef struct
     
 } ndrx_ora_tpgetconn_t;
 
+namespace py = pybind11;
+
+/**
+ * Iterator over the export records (one per line) of the file.
+ * Import buffer is reused while it is not taken over by UbfDict.
+ */
+class ndrxpy_importiter
+{
+public:
+
+    ndrxpy_importiter(py::object file, long flags)
+        : M_readline(file.attr("readline")), M_flags(flags) {}
+
+    py::object next();
+
+private:
+
+    py::object M_readline;  /**< file.readline()                    */
+    long M_flags;           /**< tpimport() flags                   */
+    std::string M_line;     /**< EOS terminated record              */
+    atmibuf M_obuf;         /**< Import buffer                      */
+};
+
 /*---------------------------Globals------------------------------------*/
 /*---------------------------Statics------------------------------------*/
 
-namespace py = pybind11;
+/** reusable output of the single buffer exports */
+static thread_local std::vector<char> M_expbuf;
+
+/**
+ * Estimate the export output size of ATMI buffer. Input buffers borrowed
+ * from UbfDict have no length set, thus data size is taken from the buffer.
+ * @param [in] in ATMI buffer
+ * @return output bytes for the first export attempt
+ */
+exprivate size_t ndrxpy_export_need(atmibuf &in)
+{
+    char type[XATMI_TYPE_LEN+1] = {EXEOS};
+    long len = in.len;
+
+    if (nullptr!=*in.pp)
+    {
+        long size = tptypes(*in.pp, type, nullptr);
+
+        if (0==strcmp(type, "UBF"))
+        {
+            size = Bused(reinterpret_cast<UBFH *>(*in.pp));
+        }
+
+        if (size > len)
+        {
+            len = size;
+        }
+    }
+
+    return NDRXPY_EXPORT_HDRSZ + len * NDRXPY_EXPORT_RATIO;
+}
+
+/**
+ * Export ATMI buffer at the given position of the output. Output is
+ * grown if exported data does not fit in. GIL is released during the export.
+ * @param [in] in ATMI buffer
+ * @param [in] flags tpexport() flags
+ * @param [in,out] out output buffer
+ * @param [in] pos position in output where to export
+ * @return exported data length, without EOS (which is written too)
+ */
+exprivate long ndrxpy_export(atmibuf &in, long flags, std::vector<char> &out, size_t pos)
+{
+    size_t need = pos + ndrxpy_export_need(in);
+    int tries = 0;
+    long olen;
+    int rc;
+
+    if (out.size() < need)
+    {
+        out.resize(need);
+    }
+
+    while (true)
+    {
+        olen = out.size() - pos;
+
+        {
+            py::gil_scoped_release release;
+            rc = tpexport(*in.pp, in.len, &out[pos], &olen, flags);
+        }
+
+        if (EXSUCCEED==rc)
+        {
+            break;
+        }
+
+        /* output too short is reported as invalid argument */
+        if (TPEINVAL!=tperrno || ++tries > NDRXPY_EXPORT_GROW)
+        {
+            throw atmi_exception(tperrno);
+        }
+
+        out.resize(pos + (out.size() - pos) * 2);
+    }
+
+    return olen-1;
+}
 
 /**
  * @brief export ATMI buffer
@@ -88,21 +194,116 @@ namespace py = pybind11;
 expublic py::object ndrxpy_pytpexport(py::object idata, long flags)
 {
     auto in = ndrx_from_py(idata, false);
-    std::vector<char> ostr;
-    ostr.resize(512 + in.len * 2);
+    long olen = ndrxpy_export(in, flags, M_expbuf, 0);
 
-    long olen = ostr.capacity();
-    int rc = tpexport(*in.pp, in.len, &ostr[0], &olen, flags);
-    if (rc == -1)
+    if (flags == 0)
     {
-        throw atmi_exception(tperrno);
+        return py::bytes(&M_expbuf[0], olen);
     }
+    return py::str(&M_expbuf[0], olen);
+}
 
-    if (flags == 0)
+/**
+ * @brief export ATMI buffer into caller's bytearray
+ * @param [in] idata ATMI buffer to export
+ * @param [in] out output, resized to the exported data length
+ * @param [in] flags flags
+ * @return exported data length
+ */
+expublic long ndrxpy_pytpexport_into(py::object idata, py::bytearray out, long flags)
+{
+    auto in = ndrx_from_py(idata, false);
+    Py_ssize_t size = ndrxpy_export_need(in);
+    int tries = 0;
+    long olen;
+    int rc;
+
+    if (size < PyByteArray_GET_SIZE(out.ptr()))
     {
-        return py::bytes(&ostr[0], olen-1);
+        size = PyByteArray_GET_SIZE(out.ptr());
     }
-    return py::str(&ostr[0]);
+
+    while (true)
+    {
+        Py_buffer view;
+
+        if (EXSUCCEED!=PyByteArray_Resize(out.ptr(), size) ||
+            EXSUCCEED!=PyObject_GetBuffer(out.ptr(), &view, PyBUF_WRITABLE))
+        {
+            throw py::error_already_set();
+        }
+
+        olen = size;
+
+        {
+            /* exported buffer view blocks resize by other threads */
+            py::gil_scoped_release release;
+            rc = tpexport(*in.pp, in.len, static_cast<char *>(view.buf), &olen, flags);
+        }
+
+        PyBuffer_Release(&view);
+
+        if (EXSUCCEED==rc)
+        {
+            break;
+        }
+
+        /* output too short is reported as invalid argument */
+        if (TPEINVAL!=tperrno || ++tries > NDRXPY_EXPORT_GROW)
+        {
+            throw atmi_exception(tperrno);
+        }
+
+        size*=2;
+    }
+
+    /* drop EOS */
+    olen--;
+
+    if (EXSUCCEED!=PyByteArray_Resize(out.ptr(), olen))
+    {
+        throw py::error_already_set();
+    }
+
+    return olen;
+}
+
+/**
+ * @brief export ATMI buffers to file, one record per line
+ * @param [in] bufs iterable of ATMI buffers
+ * @param [in] file binary file, only write() is used
+ * @param [in] flags flags
+ * @return number of buffers exported
+ */
+expublic long ndrxpy_pytpexport_many(py::iterable bufs, py::object file, long flags)
+{
+    py::object write = file.attr("write");
+    std::vector<char> out;
+    size_t pos = 0;
+    long cnt = 0;
+
+    for (auto buf : bufs)
+    {
+        auto in = ndrx_from_py(py::reinterpret_borrow<py::object>(buf), false);
+
+        pos += ndrxpy_export(in, flags, out, pos);
+        /* replace EOS */
+        out[pos++] = '\n';
+        cnt++;
+
+        if (pos >= NDRXPY_EXPORT_CHUNK)
+        {
+            write(py::bytes(&out[0], pos));
+            pos = 0;
+        }
+    }
+
+    if (pos > 0)
+    {
+        write(py::bytes(&out[0], pos));
+    }
+
+    return cnt;
 }
 
 /**
@@ -126,6 +327,87 @@ expublic py::object ndrxpy_pytpimport(const std::string istr, long flags)
     return ndrx_to_py(obuf, false);
 }
 
+/**
+ * @brief import next record from the file, empty lines are skipped
+ * @return ATMI buffer
+ */
+py::object ndrxpy_importiter::next()
+{
+    const char *p;
+    Py_ssize_t len;
+    long olen = 0;
+    int rc;
+
+    do
+    {
+        py::object line = M_readline();
+
+        if (PyBytes_Check(line.ptr()))
+        {
+            p = PyBytes_AS_STRING(line.ptr());
+            len = PyBytes_GET_SIZE(line.ptr());
+        }
+        else if (PyUnicode_Check(line.ptr()))
+        {
+            if (nullptr==(p = PyUnicode_AsUTF8AndSize(line.ptr(), &len)))
+            {
+                throw py::error_already_set();
+            }
+        }
+        else
+        {
+            throw std::invalid_argument("readline() shall return bytes or str");
+        }
+
+        if (0==len)
+        {
+            throw py::stop_iteration();
+        }
+
+        while (len > 0 && ('\n'==p[len-1] || '\r'==p[len-1]))
+        {
+            len--;
+        }
+
+        M_line.assign(p, len);
+
+    } while (0==len);
+
+    /* previous buffer may be taken over by UbfDict (p is reset) */
+    M_obuf.pp = &M_obuf.p;
+
+    if (nullptr!=M_obuf.p)
+    {
+        char type[XATMI_TYPE_LEN+1] = {EXEOS};
+
+        if (EXFAIL==tptypes(M_obuf.p, type, nullptr) || 0!=strcmp(type, "UBF"))
+        {
+            tpfree(M_obuf.p);
+            M_obuf.p = nullptr;
+        }
+    }
+
+    /* allocates, or clears fields of the previous record */
+    M_obuf.reinit("UBF", nullptr, len);
+
+    {
+        py::gil_scoped_release release;
+        rc = tpimport(&M_line[0], len, M_obuf.pp, &olen, M_flags);
+    }
+
+    if (EXFAIL==rc)
+    {
+        throw atmi_exception(tperrno);
+    }
+
+    if (olen > 0)
+    {
+        M_obuf.len = olen;
+    }
+
+    return ndrx_to_py(M_obuf, false);
+}
+
 /**
  * @brief post event 
  * @param [in] eventname name of the event
@@ -252,6 +534,257 @@ expublic std::pair<NDRXPY_TPQCTL, py::object> ndrx_pytpdequeue(const char *qspac
     return std::make_pair(*ctl, ndrx_to_py(out, false));
 }
 
+/**
+ * @brief Raise error of the batch queue operation. Exception gets
+ *  the "index" attribute (failing item) and "results" attribute (results
+ *  of the items processed, which are not rolled back).
+ * 
+ * @param [in] err tperrno
+ * @param [in] diag diagnostic code, if TPEDIAGNOSTIC
+ * @param [in] diagmsg diagnostic message
+ * @param [in] index index of the failing item
+ * @param [in] results results of the processed items
+ */
+exprivate void ndrxpy_pyqueue_many_throw(int err, long diag, char *diagmsg,
+    size_t index, py::list results)
+{
+    py::module mod = py::module::import("endurox");
+    py::object cls;
+    py::object ex;
+
+    if (err == TPEDIAGNOSTIC)
+    {
+        cls = mod.attr("QmException");
+        ex = cls(diagmsg, diag);
+    }
+    else
+    {
+        cls = mod.attr("AtmiException");
+        ex = cls(tpstrerror(err), err);
+    }
+
+    ex.attr("index") = index;
+    ex.attr("results") = results;
+
+    PyErr_SetObject(cls.ptr(), ex.ptr());
+    throw py::error_already_set();
+}
+
+/**
+ * @brief enqueue list of messages to persistent Q. Buffers are converted
+ *  first, then messages are enqueued with GIL released.
+ * 
+ * @param [in] qspace queue space name
+ * @param [in] qname queue name
+ * @param [in] ctl control struct used for all messages (may be NULL)
+ * @param [in] data list of ATMI objects
+ * @param [in] flags enqueue flags
+ * @param [in] tran if > 0, own transaction timeout
+ * @return list of queue control structs of enqueued messages
+ */
+expublic py::list ndrxpy_pytpenqueue_many(const char *qspace, const char *qname,
+    NDRXPY_TPQCTL *ctl, py::list data, long flags, unsigned long tran)
+{
+    std::vector<atmibuf> in;
+    std::vector<TPQCTL> ctls;
+    TPQCTL base;
+    int err = 0;
+    long diag = 0;
+    char diagmsg[sizeof(base.diagmsg)] = {EXEOS};
+    size_t index = 0;
+    py::list ret;
+
+    memset(&base, 0, sizeof(base));
+
+    if (nullptr!=ctl)
+    {
+        ctl->convert_to_base();
+        base = *dynamic_cast<TPQCTL*>(ctl);
+    }
+
+    in.reserve(data.size());
+    ctls.reserve(data.size());
+
+    for (auto item : data)
+    {
+        in.push_back(ndrx_from_py(py::reinterpret_borrow<py::object>(item), false));
+    }
+
+    {
+        py::gil_scoped_release release;
+
+        if (tran > 0 && EXSUCCEED!=tpbegin(tran, 0))
+        {
+            err = tperrno;
+        }
+        else
+        {
+            for (auto &b : in)
+            {
+                ctls.push_back(base);
+
+                if (EXSUCCEED!=tpenqueue(const_cast<char *>(qspace), const_cast<char *>(qname),
+                           &ctls.back(), *b.pp, b.len, flags))
+                {
+                    err = tperrno;
+                    diag = ctls.back().diagnostic;
+                    NDRX_STRCPY_SAFE(diagmsg, ctls.back().diagmsg);
+                    ctls.pop_back();
+                    break;
+                }
+            }
+
+            index = ctls.size();
+
+            if (tran > 0)
+            {
+                if (0!=err)
+                {
+                    tpabort(0);
+                }
+                else if (EXSUCCEED!=tpcommit(0))
+                {
+                    err = tperrno;
+                }
+
+                //Nothing is enqueued
+                if (0!=err)
+                {
+                    ctls.clear();
+                }
+            }
+        }
+    }
+
+    for (auto &c : ctls)
+    {
+        NDRXPY_TPQCTL r;
+        *dynamic_cast<TPQCTL*>(&r) = c;
+        r.convert_from_base();
+        ret.append(py::cast(r));
+    }
+
+    if (0!=err)
+    {
+        ndrxpy_pyqueue_many_throw(err, diag, diagmsg, index, ret);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief dequeue up to max messages from persistent Q, with GIL released.
+ *  Stops when queue is empty. Buffers are converted to Python after
+ *  the loop (and commit), with single GIL acquire.
+ * 
+ * @param [in] qspace queue space name
+ * @param [in] qname queue name
+ * @param [in] ctl control struct used for all dequeues (may be NULL)
+ * @param [in] max max messages to dequeue
+ * @param [in] flags dequeue flags
+ * @param [in] tran if > 0, own transaction timeout
+ * @return list of (queue control struct, atmi object)
+ */
+expublic py::list ndrxpy_pytpdequeue_many(const char *qspace, const char *qname,
+    NDRXPY_TPQCTL *ctl, long max, long flags, unsigned long tran)
+{
+    std::vector<atmibuf> out;
+    std::vector<TPQCTL> ctls;
+    TPQCTL base;
+    int err = 0;
+    long diag = 0;
+    char diagmsg[sizeof(base.diagmsg)] = {EXEOS};
+    size_t index = 0;
+    py::list ret;
+
+    if (max < 1)
+    {
+        throw std::invalid_argument("max must be greater than 0");
+    }
+
+    memset(&base, 0, sizeof(base));
+
+    if (nullptr!=ctl)
+    {
+        ctl->convert_to_base();
+        base = *dynamic_cast<TPQCTL*>(ctl);
+    }
+
+    {
+        py::gil_scoped_release release;
+        //Work buffer, handed over to results on success only
+        atmibuf b;
+
+        if (tran > 0 && EXSUCCEED!=tpbegin(tran, 0))
+        {
+            err = tperrno;
+        }
+        else
+        {
+            for (long i=0; i<max; i++)
+            {
+                if (nullptr==b.p)
+                {
+                    b.reinit("UBF", nullptr, 1024);
+                }
+
+                ctls.push_back(base);
+
+                if (EXSUCCEED!=tpdequeue(const_cast<char *>(qspace), const_cast<char *>(qname),
+                           &ctls.back(), b.pp, &b.len, flags))
+                {
+                    if (TPEDIAGNOSTIC!=tperrno || QMENOMSG!=ctls.back().diagnostic)
+                    {
+                        err = tperrno;
+                        diag = ctls.back().diagnostic;
+                        NDRX_STRCPY_SAFE(diagmsg, ctls.back().diagmsg);
+                    }
+                    ctls.pop_back();
+                    break;
+                }
+
+                out.push_back(std::move(b));
+            }
+
+            index = ctls.size();
+
+            if (tran > 0)
+            {
+                if (0!=err)
+                {
+                    tpabort(0);
+                }
+                else if (EXSUCCEED!=tpcommit(0))
+                {
+                    err = tperrno;
+                }
+
+                //Messages are returned to the queue
+                if (0!=err)
+                {
+                    ctls.clear();
+                    out.clear();
+                }
+            }
+        }
+    }
+
+    for (size_t i=0; i<ctls.size(); i++)
+    {
+        NDRXPY_TPQCTL r;
+        *dynamic_cast<TPQCTL*>(&r) = ctls[i];
+        r.convert_from_base();
+        ret.append(py::make_tuple(r, ndrx_to_py(out[i], false)));
+    }
+
+    if (0!=err)
+    {
+        ndrxpy_pyqueue_many_throw(err, diag, diagmsg, index, ret);
+    }
+
+    return ret;
+}
+
 /**
  * @brief async service call
  * @param [in] svc service name
@@ -790,6 +1323,115 @@ expublic void ndrxpy_register_atmi(py::module &m)
           py::arg("qspace"), py::arg("qname"), py::arg("ctl"),
           py::arg("flags") = 0);
 
+    m.def("tpenqueue_many", &ndrxpy_pytpenqueue_many, 
+        R"pbdoc(
+        Enqueue list of messages to persistent message queue. All buffers are
+        converted first, then messages are enqueued with GIL released. Optionally
+        all messages are enqueued in own global transaction.
+
+        .. code-block:: python
+            :caption: tpenqueue_many example
+            :name: tpenqueue_many-example
+
+                qctls = e.tpenqueue_many("SAMPLESPACE", "TESTQ", e.TPQCTL(),
+                    [{"data":"SOME DATA %d" % i} for i in range(1000)], tran=60)
+
+        If enqueue fails, processing stops and exception is raised. Exception
+        has *index* attribute set to the index of the failing message in *data*
+        (or to number of messages, if commit failed) and *results* attribute
+        set to the list of :class:`.TPQCTL` of the messages which remain
+        enqueued. If *tran* is used, transaction is aborted and *results*
+        is empty, otherwise messages before *index* are enqueued.
+
+        See :func:`.tpenqueue` for details.
+
+        :raise AtmiException: 
+            | See :func:`.tpenqueue`, additionally:
+            | :data:`.TPEABORT` - Own transaction was aborted at commit.
+            | :data:`.TPEPROTO` - *tran* used when already in transaction.
+
+        :raise QmException: 
+            | See :func:`.tpenqueue`.
+
+        Parameters
+        ----------
+        qspace : str
+            Queue space name.
+        qname : str
+            Queue name.
+        ctl : TPQCTL
+            Control structure used for every message, may be **None**.
+        data : list
+            List of ATMI data buffers.
+        flags : int
+            Or'd bit flags, see :func:`.tpenqueue`. Default flag is **0**.
+        tran : int
+            If greater than **0**, messages are enqueued in own transaction with given
+            timeout in seconds. Default is **0** - no transaction started.
+
+        Returns
+        -------
+        list
+            List of :class:`.TPQCTL` of enqueued messages.
+
+     )pbdoc", py::arg("qspace"), py::arg("qname"), py::arg("ctl"), py::arg("data"),
+          py::arg("flags") = 0, py::arg("tran") = 0);
+
+    m.def("tpdequeue_many", &ndrxpy_pytpdequeue_many, 
+        R"pbdoc(
+        Dequeue up to *max* messages from persistent queue, with GIL released.
+        Dequeue stops when queue becomes empty (:data:`.QMENOMSG` is not reported).
+        Optionally messages are dequeued in own global transaction.
+
+        .. code-block:: python
+            :caption: tpdequeue_many example
+            :name: tpdequeue_many-example
+
+                for qctl, retbuf in e.tpdequeue_many("SAMPLESPACE", "TESTQ", e.TPQCTL(), 100, tran=60):
+                    print(retbuf["data"])
+
+        Messages are converted to Python objects after all dequeues (and the
+        commit) are done, so the GIL is acquired once.
+
+        Errors are handled in the same way as by :func:`.tpenqueue_many`, *index*
+        is set to number of messages dequeued before the failure and *results*
+        contains the dequeued messages (empty if *tran* is used, as messages
+        are returned to the queue). See :func:`.tpdequeue` for details.
+
+        :raise AtmiException: 
+            | See :func:`.tpdequeue`, additionally:
+            | :data:`.TPEABORT` - Own transaction was aborted at commit.
+            | :data:`.TPEPROTO` - *tran* used when already in transaction.
+
+        :raise QmException: 
+            | See :func:`.tpdequeue`.
+
+        Parameters
+        ----------
+        qspace : str
+            Queue space name.
+        qname : str
+            Queue name.
+        ctl : TPQCTL
+            Control structure used for every dequeue, may be **None**.
+        max : int
+            Max number of messages to dequeue.
+        flags : int
+            Or'd bit flags, see :func:`.tpdequeue`. Default flag is **0**.
+        tran : int
+            If greater than **0**, messages are dequeued in own transaction with given
+            timeout in seconds. Default is **0** - no transaction started.
+
+        Returns
+        -------
+        list
+            List of (:class:`.TPQCTL`, dict) tuples, control structure
+            and ATMI data buffer of dequeued messages.
+
+     )pbdoc",
+          py::arg("qspace"), py::arg("qname"), py::arg("ctl"), py::arg("max"),
+          py::arg("flags") = 0, py::arg("tran") = 0);
+
     m.def("tpcall", &ndrxpy_pytpcall,
           R"pbdoc(
         Synchronous service call. In case if service returns :data:`.TPFAIL` or :data:`.TPEXIT`,
@@ -1385,6 +2027,132 @@ expublic void ndrxpy_register_atmi(py::module &m)
             )pbdoc"
           , py::arg("istr"), py::arg("flags") = 0);
 
+    m.def("tpexport_into", &ndrxpy_pytpexport_into,
+                 R"pbdoc(
+        Export ATMI buffer directly into caller provided *bytearray* memory,
+        with GIL released. Before export the array is enlarged to the estimated
+        export size (kept as is if already larger); if the space is not sufficient,
+        the array is grown and export is retried. Afterwards the array is resized
+        to the exported data length, thus when reused, its memory is reused too.
+
+        .. code-block:: python
+            :caption: tpexport_into example
+            :name: tpexport_into-example
+
+            import endurox as e
+            out = bytearray()
+            for buf in bufs:
+                n = e.tpexport_into(buf, out)
+                sock.sendall(out)
+
+        For more details see **tpexport(3)** C API call.
+
+        :raise AtmiException: 
+            | Following error codes may be present:
+            | :data:`.TPEINVAL` - Invalid buffer passed.
+            | :data:`.TPEOTYPE` -  Invalid input type.
+            | :data:`.TPESYSTEM` - System error occurred.
+            | :data:`.TPEOS` - Operating system error occurred.
+
+        Parameters
+        ----------
+        ibuf : dict
+            ATMI buffer.
+        out : bytearray
+            Output array.
+        flags : int
+            Bitwise flags, may contain **TPEX_STRING**. Default is **0**.
+
+        Returns
+        -------
+        len : int
+            Exported data length.
+
+            )pbdoc"
+          , py::arg("ibuf"), py::arg("out"), py::arg("flags") = 0);
+
+    m.def("tpexport_many", &ndrxpy_pytpexport_many,
+                 R"pbdoc(
+        Export ATMI buffers to the binary file, one record per line
+        (newline delimited JSON, or Base64 lines if :data:`.TPEX_STRING` is set).
+        Records are collected in single reused buffer and are written to the
+        file in chunks. Exports are done with GIL released.
+
+        .. code-block:: python
+            :caption: tpexport_many example
+            :name: tpexport_many-example
+
+            import endurox as e
+            with open("archive.ndjson", "ab") as f:
+                cnt = e.tpexport_many(bufs, f)
+            with open("archive.ndjson", "rb") as f:
+                for buf in e.tpimport_iter(f):
+                    print(buf)
+
+        For more details see **tpexport(3)** C API call.
+
+        :raise AtmiException: 
+            | Following error codes may be present:
+            | :data:`.TPEINVAL` - Invalid buffer passed.
+            | :data:`.TPEOTYPE` -  Invalid input type.
+            | :data:`.TPESYSTEM` - System error occurred.
+            | :data:`.TPEOS` - Operating system error occurred.
+
+        Parameters
+        ----------
+        bufs : iterable
+            ATMI buffers.
+        file : object
+            Binary file like object, only *write()* method is used.
+        flags : int
+            Bitwise flags, may contain **TPEX_STRING**. Default is **0**.
+
+        Returns
+        -------
+        cnt : int
+            Number of buffers exported.
+
+            )pbdoc"
+          , py::arg("bufs"), py::arg("file"), py::arg("flags") = 0);
+
+    py::class_<ndrxpy_importiter>(m, "ImportIterator", "Iterator returned by :func:`.tpimport_iter`")
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__", &ndrxpy_importiter::next);
+
+    m.def("tpimport_iter", [](py::object file, long flags)
+        {
+            return ndrxpy_importiter(file, flags);
+        },
+                 R"pbdoc(
+        Iterate over the ATMI buffers exported to the file by :func:`.tpexport_many`
+        (or any other file with one export record per line). Lines are read with
+        *readline()*, file may be opened in binary or text mode. Empty lines are
+        skipped. Import buffer is reused between records and imports are done
+        with GIL released.
+
+        For more details see **tpimport(3)** C API call.
+
+        :raise AtmiException: 
+            | Following error codes may be present:
+            | :data:`.TPEINVAL` - Invalid parameters.
+            | :data:`.TPEOTYPE` -  Invalid input type.
+            | :data:`.TPESYSTEM` - System error occurred.
+            | :data:`.TPEOS` - Operating system error occurred.
+
+        Parameters
+        ----------
+        file : object
+            File like object, only *readline()* method is used.
+        flags : int
+            Bitwise flags, may contain :data:`.TPEX_STRING`, :data:`.TPEX_NOCHANGE`. Default is **0**.
+
+        Returns
+        -------
+        it : ImportIterator
+            Iterator returning restored ATMI buffers.
+            )pbdoc"
+          , py::arg("file"), py::arg("flags") = 0);
+
     m.def("tppost", &ndrxpy_pytppost,
                  R"pbdoc(
         Post event to the event broker.
@@ -48,34 +48,278 @@
 
 #include <functional>
 #include <map>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef EX_OS_LINUX
+#include <sys/timerfd.h>
+#endif
 
 namespace py = pybind11;
 
+//Spare bytes for value map field conversion to string (numeric types)
+#define NDRXPY_ROUTE_CONVSPARE  64
+
+/**
+ * Native routing rule, evaluated by the dispatcher with out entering
+ * the Python. Either compiled boolean expression with single target
+ * or field value to target service mapping.
+ */
+struct ndrxpy_route_t
+{
+    char *tree;             /**< Compiled Bboolco() tree, if expr rule   */
+    BFLDID fldid;           /**< Field to read, if value map rule        */
+    std::string target;     /**< Target service for expression           */
+    std::map<std::string, std::string> valmap; /**< Value -> service     */
+};
+
+/**
+ * Parked request of the batched service
+ */
+struct ndrxpy_batchreq_t
+{
+    TPSVCINFO svcinfo;      /**< Copy of call info, data owned by us     */
+    char *ctxdata;          /**< tpsrvgetctxdata2() result               */
+    ndrxpy_svccache_t *cache; /**< Reply cache of the request, if any    */
+    std::string cachekey;   /**< Reply cache key                         */
+};
+
+/**
+ * Batched service, requests are accumulated and passed to the handler
+ * in single call.
+ */
+struct ndrxpy_batch_t
+{
+    py::function func;      /**< Python handler, receives list            */
+    size_t maxbatch;        /**< Max requests in batch                    */
+    long maxwait;           /**< Max wait of the first request, usec      */
+    std::chrono::steady_clock::time_point deadline; /**< flush time       */
+    std::vector<ndrxpy_batchreq_t> reqs; /**< Parked requests             */
+};
 
 static py::object server = py::none();
 
 //Mapping of advertised functions
 std::map<std::string, py::function> M_dispmap {};
+
+//Native routing rules by service name, populated at tpsvrinit()
+std::map<std::string, std::vector<ndrxpy_route_t>> M_routes {};
+
+//Routes lock, dispatcher reads them with out GIL
+static std::mutex M_routes_mtx;
+
+//Batched services by service name, populated at tpsvrinit()
+std::map<std::string, ndrxpy_batch_t> M_batches {};
+
+//Batch flush timer, registered to the server poller
+static int M_batch_timerfd = EXFAIL;
+
+//Dispatch threads are used (tpsvrthrinit() called), set under GIL
+static bool M_threaded = false;
+
+exprivate void ndrxpy_batch_clear(void);
+
+/**
+ * @brief Free the compiled route trees of the service
+ * @param rules rules to free
+ */
+exprivate void ndrxpy_route_free(std::vector<ndrxpy_route_t> &rules)
+{
+    for (auto &r: rules)
+    {
+        if (nullptr!=r.tree)
+        {
+            Btreefree(r.tree);
+            r.tree=nullptr;
+        }
+    }
+    rules.clear();
+}
+
+/**
+ * @brief Remove all routes (server shutdown)
+ */
+exprivate void ndrxpy_route_clear(void)
+{
+    std::lock_guard<std::mutex> lock(M_routes_mtx);
+
+    for (auto &it: M_routes)
+    {
+        ndrxpy_route_free(it.second);
+    }
+    M_routes.clear();
+}
+
+/**
+ * @brief Match the request against the service routes.
+ *  Runs with out GIL, only UBF buffers are routed.
+ * @param svcinfo service call
+ * @param target [out] target service, if matched
+ * @return true if route matched
+ */
+exprivate bool ndrxpy_route_match(TPSVCINFO *svcinfo, std::string &target)
+{
+    char btype[16]="";
+
+    if (nullptr==svcinfo->data)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(M_routes_mtx);
+    auto it = M_routes.find(svcinfo->name);
+
+    if (M_routes.end()==it)
+    {
+        return false;
+    }
+
+    if (EXFAIL==tptypes(svcinfo->data, btype, nullptr) || 0!=strcmp(btype, "UBF"))
+    {
+        return false;
+    }
+
+    UBFH *p_ub = reinterpret_cast<UBFH *>(svcinfo->data);
+
+    for (auto &r: it->second)
+    {
+        if (nullptr!=r.tree)
+        {
+            int res = Bboolev(p_ub, r.tree);
+
+            if (EXFAIL==res)
+            {
+                NDRX_LOG(log_error, "Route of [%s] eval failed: %s", 
+                    svcinfo->name, Bstrerror(Berror));
+            }
+            else if (EXTRUE==res)
+            {
+                target = r.target;
+                return true;
+            }
+        }
+        else
+        {
+            char stackbuf[256];
+            std::vector<char> heapbuf;
+            char *val = stackbuf;
+            BFLDLEN len = Blen(p_ub, r.fldid, 0);
+
+            if (EXFAIL==len)
+            {
+                /* field not present, rule does not match */
+                continue;
+            }
+
+            /* string/carray convert to len+EOS, numbers fit in the spare */
+            len+=NDRXPY_ROUTE_CONVSPARE;
+
+            if (static_cast<size_t>(len) > sizeof(stackbuf))
+            {
+                heapbuf.resize(len);
+                val = heapbuf.data();
+            }
+            else
+            {
+                len = sizeof(stackbuf);
+            }
+
+            if (EXSUCCEED!=CBget(p_ub, r.fldid, 0, val, &len, BFLD_STRING))
+            {
+                NDRX_LOG(log_error, "Route of [%s] field read failed: %s", 
+                    svcinfo->name, Bstrerror(Berror));
+                continue;
+            }
+
+            auto vit = r.valmap.find(val);
+
+            if (r.valmap.end()!=vit)
+            {
+                target = vit->second;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
     
 expublic void ndrxpy_pytpreturn(int rval, long rcode, py::object data, long flags)
 {
+    unsigned long long t0=0, t1=0;
+    int measure = ndrxpy_svcstats_on();
+
+    if (measure)
+    {
+        t0 = ndrxpy_svcstats_now();
+    }
+
     //In case if having UbfDict buffer, reset their ptr...
     auto &&odata = ndrx_from_py(data, true);
+    ndrxpy_svccache_store(rval, rcode, *odata.pp, odata.len);
+
+    if (measure)
+    {
+        t1 = ndrxpy_svcstats_now();
+    }
+
+    //Request log shall be complete before the reply
+    if (ndrxpy_tplog_pending())
+    {
+        py::gil_scoped_release release;
+        ndrxpy_tplog_flush();
+    }
+
     tpreturn(rval, rcode, *odata.pp, odata.len, 0);
     //Normal destructors apply... as running in nojump mode
     //well.. tpreturn will free up the buffer
     //no need to destruct it one more time?
     odata.release();
 
+    if (measure)
+    {
+        ndrxpy_svcstats_reply(t1-t0, ndrxpy_svcstats_now()-t1);
+    }
+
 }
 
 expublic void ndrxpy_pytpforward(const std::string &svc, py::object data, long flags)
 {
+    unsigned long long t0=0, t1=0;
+    int measure = ndrxpy_svcstats_on();
+
+    if (measure)
+    {
+        t0 = ndrxpy_svcstats_now();
+    }
+
     //In case if having UbfDict buffer, reset their ptr...
     auto &&odata = ndrx_from_py(data, true);
+    ndrxpy_svccache_reset();
+
+    if (measure)
+    {
+        t1 = ndrxpy_svcstats_now();
+    }
+
+    //Request log shall be complete before the reply
+    if (ndrxpy_tplog_pending())
+    {
+        py::gil_scoped_release release;
+        ndrxpy_tplog_flush();
+    }
+
     tpforward(const_cast<char*>(svc.c_str()), *odata.pp, odata.len, 0);
     //Normal destructors apply... as running in nojump mode.
     odata.release();
+
+    if (measure)
+    {
+        ndrxpy_svcstats_reply(t1-t0, ndrxpy_svcstats_now()-t1);
+    }
 }
 
 extern "C" long G_libatmisrv_flags;
@@ -102,12 +346,20 @@ int tpsvrinit(int argc, char *argv[])
 void tpsvrdone()
 {
     py::gil_scoped_acquire acquire;
+
+    //Reply parked requests, before user resources are gone
+    ndrxpy_batch_clear();
+
     if (hasattr(server, __func__))
     {
         server.attr(__func__)();
     }
 
     M_dispmap.clear();
+    M_batches.clear();
+    ndrxpy_route_clear();
+    ndrxpy_svccache_clear();
+    ndrxpy_timer_clear();
     ndrxpy_fdmap_clear();
 }
 
@@ -123,6 +375,18 @@ int tpsvrthrinit(int argc, char *argv[])
     PyThreadState_New(internals.istate);
 
     py::gil_scoped_acquire acquire;
+
+    //Batches are parked and flushed by the main thread poller only
+    M_threaded = true;
+    if (!M_batches.empty())
+    {
+        NDRX_LOG(log_error, "Batched services require single threaded server "
+            "(mindispatchthreads not used)");
+        userlog(const_cast<char *>("Batched services require single threaded server "
+            "(mindispatchthreads not used)"));
+        return EXFAIL;
+    }
+
     if (hasattr(server, __func__))
     {
         std::vector<std::string> args;
@@ -142,6 +406,281 @@ void tpsvrthrdone()
         server.attr(__func__)();
     }
 }
+/**
+ * @brief Call the batch handler and reply to all parked requests.
+ *  Runs in the main thread from the poller, outside of service call.
+ * @param b batch to flush
+ */
+exprivate void ndrxpy_batch_flush(ndrxpy_batch_t &b)
+{
+    std::vector<ndrxpy_batchreq_t> reqs;
+    size_t i;
+
+    reqs.swap(b.reqs);
+
+    try
+    {
+        py::gil_scoped_acquire acquire;
+        py::list infos;
+
+        for (auto &r: reqs)
+        {
+            py::object info = py::cast(pytpsvcinfo(&r.svcinfo));
+            //Destruct the auto-buf when goes out of the scope
+            auto ibuf=atmibuf(&r.svcinfo);
+            //Buffer is owned by ibuf from now on
+            r.svcinfo.data = nullptr;
+            auto idata = ndrx_to_py(ibuf, NDRXPY_SUBBUF_NORM);
+            info.cast<pytpsvcinfo &>().data = idata;
+            //No reset if using UbfDict() XATMI ptr
+            if (ndrxpy_is_atmibuf_UbfDict(idata))
+            {
+                ibuf.p=nullptr;
+            }
+            infos.append(info);
+        }
+
+        py::list replies = b.func(server, infos);
+
+        for (i=0; i<reqs.size(); i++)
+        {
+            if (EXSUCCEED!=tpsrvsetctxdata(reqs[i].ctxdata, TPNOAUTBUF))
+            {
+                NDRX_LOG(log_error, "Failed to restore batch request context: %s",
+                    tpstrerror(tperrno));
+                tpsrvfreectxdata(reqs[i].ctxdata);
+                reqs[i].ctxdata = nullptr;
+                continue;
+            }
+
+            if (i < replies.size())
+            {
+                py::tuple rpl = replies[i].cast<py::tuple>();
+                //Reply is cached under the key of this request
+                ndrxpy_svccache_attach(reqs[i].cache, reqs[i].cachekey);
+                ndrxpy_pytpreturn(rpl[0].cast<int>(), rpl[1].cast<long>(), rpl[2], 0);
+            }
+            else
+            {
+                NDRX_LOG(log_error, "No reply for batch request %d", (int)i);
+                tpreturn(TPFAIL, TPESVCERR, nullptr, 0, TPSOFTERR);
+            }
+
+            tpsrvfreectxdata(reqs[i].ctxdata);
+            reqs[i].ctxdata = nullptr;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        ndrxpy_svccache_reset();
+        NDRX_LOG(log_error, "Got exception at batch handler: %s", e.what());
+        userlog(const_cast<char *>("%s"), e.what());
+
+        /* fail all not replied requests */
+        for (auto &r: reqs)
+        {
+            if (nullptr==r.ctxdata)
+            {
+                continue;
+            }
+
+            if (nullptr!=r.svcinfo.data)
+            {
+                tpfree(r.svcinfo.data);
+            }
+
+            if (EXSUCCEED==tpsrvsetctxdata(r.ctxdata, TPNOAUTBUF))
+            {
+                tpreturn(TPFAIL, TPESVCERR, nullptr, 0, TPSOFTERR);
+            }
+            tpsrvfreectxdata(r.ctxdata);
+        }
+    }
+}
+
+/**
+ * @brief Arm the flush timer for the earliest batch deadline
+ * @param immediate fire at next poll
+ */
+exprivate void ndrxpy_batch_arm(bool immediate)
+{
+#ifdef EX_OS_LINUX
+    struct itimerspec its = {};
+    long usec = 1;
+
+    if (!immediate)
+    {
+        auto now = std::chrono::steady_clock::now();
+        bool found = false;
+
+        for (auto &it: M_batches)
+        {
+            if (it.second.reqs.empty())
+            {
+                continue;
+            }
+
+            long left = std::chrono::duration_cast<std::chrono::microseconds>
+                (it.second.deadline - now).count();
+
+            if (!found || left < usec)
+            {
+                usec = left;
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            usec = 0;
+        }
+        else if (usec < 1)
+        {
+            usec = 1;
+        }
+    }
+
+    its.it_value.tv_sec = usec / 1000000;
+    its.it_value.tv_nsec = (usec % 1000000) * 1000;
+
+    if (EXSUCCEED!=timerfd_settime(M_batch_timerfd, 0, &its, NULL))
+    {
+        NDRX_LOG(log_error, "timerfd_settime failed: %s", strerror(errno));
+    }
+#endif
+}
+
+/**
+ * @brief Batch timer callback, flush ready batches
+ * @param fd timer fd
+ * @param events poll events
+ * @param ptr1 not used
+ * @return EXSUCCEED
+ */
+exprivate int ndrxpy_batch_timer_cb(int fd, uint32_t events, void *ptr1)
+{
+    uint64_t expirations;
+    auto now = std::chrono::steady_clock::now();
+
+    if (sizeof(expirations)!=read(fd, &expirations, sizeof(expirations)))
+    {
+        NDRX_LOG(log_debug, "timer read: %s", strerror(errno));
+    }
+
+    for (auto &it: M_batches)
+    {
+        ndrxpy_batch_t &b = it.second;
+
+        if (!b.reqs.empty() && (b.reqs.size() >= b.maxbatch || now >= b.deadline))
+        {
+            ndrxpy_batch_flush(b);
+        }
+    }
+
+    ndrxpy_batch_arm(false);
+
+    return EXSUCCEED;
+}
+
+/**
+ * @brief Flush all parked requests and remove the timer (server shutdown)
+ */
+exprivate void ndrxpy_batch_clear(void)
+{
+    for (auto &it: M_batches)
+    {
+        if (!it.second.reqs.empty())
+        {
+            ndrxpy_batch_flush(it.second);
+        }
+    }
+
+    if (EXFAIL!=M_batch_timerfd)
+    {
+        tpext_delpollerfd(M_batch_timerfd);
+        close(M_batch_timerfd);
+        M_batch_timerfd = EXFAIL;
+    }
+}
+
+/**
+ * @brief Park request of the batched service. Runs with out GIL.
+ * @param svcinfo service call
+ * @return EXTRUE if parked (tpcontinue() done), EXFALSE if not batched
+ */
+exprivate int ndrxpy_batch_park(TPSVCINFO *svcinfo)
+{
+    ndrxpy_batchreq_t r;
+    long len;
+
+    if (M_batches.empty())
+    {
+        return EXFALSE;
+    }
+
+    auto it = M_batches.find(svcinfo->name);
+
+    if (M_batches.end()==it)
+    {
+        return EXFALSE;
+    }
+
+    ndrxpy_batch_t &b = it->second;
+
+#ifdef EX_OS_LINUX
+    if (EXFAIL==M_batch_timerfd)
+    {
+        if (EXFAIL==(M_batch_timerfd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)))
+        {
+            NDRX_LOG(log_error, "timerfd_create failed: %s", strerror(errno));
+            userlog(const_cast<char *>("timerfd_create failed: %s"), strerror(errno));
+            return EXFALSE;
+        }
+
+        if (EXSUCCEED!=tpext_addpollerfd(M_batch_timerfd, POLLIN, NULL, ndrxpy_batch_timer_cb))
+        {
+            NDRX_LOG(log_error, "Failed to add batch timer to poller: %s",
+                tpstrerror(tperrno));
+            close(M_batch_timerfd);
+            M_batch_timerfd = EXFAIL;
+            return EXFALSE;
+        }
+    }
+#endif
+
+    if (nullptr==(r.ctxdata=tpsrvgetctxdata2(NULL, &len)))
+    {
+        NDRX_LOG(log_error, "Failed to get batch request context: %s",
+            tpstrerror(tperrno));
+        return EXFALSE;
+    }
+
+    r.svcinfo = *svcinfo;
+    //Cache miss is replied at flush, by other requests in between
+    r.cache = ndrxpy_svccache_detach(r.cachekey);
+
+    if (b.reqs.empty())
+    {
+        b.deadline = std::chrono::steady_clock::now() + 
+            std::chrono::microseconds(b.maxwait);
+    }
+
+    b.reqs.push_back(r);
+
+    if (b.reqs.size() >= b.maxbatch)
+    {
+        ndrxpy_batch_arm(true);
+    }
+    else if (1==b.reqs.size())
+    {
+        ndrxpy_batch_arm(false);
+    }
+
+    tpcontinue();
+
+    return EXTRUE;
+}
+
 /**
  * @brief Server dispatch function
  * 
@@ -149,9 +688,56 @@ void tpsvrthrdone()
  */
 void PY(TPSVCINFO *svcinfo)
 {
+    //Native routes are served with out the GIL
+    std::string target;
+
+    if (ndrxpy_route_match(svcinfo, target))
+    {
+        NDRX_LOG(log_debug, "Routing [%s] -> [%s]", svcinfo->name, target.c_str());
+        tpforward(const_cast<char *>(target.c_str()), svcinfo->data, svcinfo->len, 0);
+        return;
+    }
+
+    //Cached replies are served with out the GIL too
+    if (ndrxpy_svccache_lookup(svcinfo))
+    {
+        return;
+    }
+
+    //Batched services are parked until the flush
+    if (ndrxpy_batch_park(svcinfo))
+    {
+        return;
+    }
+
+    //Dispatch timings, if instrumentation enabled
+    unsigned long long t0=0, t1=0, t2=0;
+    int measure = ndrxpy_svcstats_on();
+
+    if (measure)
+    {
+        t0 = ndrxpy_svcstats_now();
+    }
+
     try
     {
         py::gil_scoped_acquire acquire;
+
+        if (measure)
+        {
+            t1 = ndrxpy_svcstats_now();
+        }
+
+        auto it = M_dispmap.find(svcinfo->fname);
+
+        if (M_dispmap.end()==it)
+        {
+            //Route only service, nothing matched
+            NDRX_LOG(log_error, "No route matched for [%s]", svcinfo->name);
+            tpreturn(TPFAIL, 0, svcinfo->data, svcinfo->len, 0);
+            return;
+        }
+
         pytpsvcinfo info(svcinfo);
 
         //Destruct the auto-buf when goes out of the scope
@@ -167,12 +753,24 @@ void PY(TPSVCINFO *svcinfo)
             }
         }
 
-        auto && func = M_dispmap[svcinfo->fname];
-        func(server, &info);
+        if (measure)
+        {
+            t2 = ndrxpy_svcstats_now();
+            ndrxpy_svcstats_reply(0, 0);
+        }
+
+        it->second(server, &info);
+        ndrxpy_svccache_reset();
+
+        if (measure)
+        {
+            ndrxpy_svcstats_add(svcinfo->name, t0, t1, t2, ndrxpy_svcstats_now());
+        }
 
     }
     catch (const std::exception &e)
     {
+        ndrxpy_svccache_reset();
         NDRX_LOG(log_error, "Got exception at tpreturn: %s", e.what());
         userlog(const_cast<char *>("%s"), e.what());
         /* return service error, soft-err*/
@@ -237,6 +835,131 @@ expublic void ndrxpy_pytpunadvertise(const char *svcname)
         M_dispmap.erase(it);
     }
 
+    std::lock_guard<std::mutex> lock(M_routes_mtx);
+    auto rit = M_routes.find(svcname);
+    if (rit != M_routes.end()) {
+        ndrxpy_route_free(rit->second);
+        M_routes.erase(rit);
+    }
+
+}
+
+/**
+ * @brief Advertise batched service
+ * @param [in] svcname service name
+ * @param [in] func Python handler receiving list of requests
+ * @param [in] maxbatch max requests in batch
+ * @param [in] maxwait max wait time of the first request in batch, usec
+ */
+expublic void ndrxpy_pytpadvertise_batch(const std::string &svcname, 
+    const py::function &func, size_t maxbatch, long maxwait)
+{
+#ifndef EX_OS_LINUX
+    throw std::invalid_argument("Batched services require timerfd (Linux only)");
+#endif
+    if (0==maxbatch || maxwait < 0)
+    {
+        throw std::invalid_argument("maxbatch must be >0 and maxwait >=0");
+    }
+
+    if (M_threaded)
+    {
+        throw std::invalid_argument("Batched services require single threaded server");
+    }
+
+    if (M_batches.end()!=M_batches.find(svcname))
+    {
+        throw std::invalid_argument("Service ["+svcname+"] already advertised");
+    }
+
+    if (tpadvertise_full(const_cast<char *>(svcname.c_str()), PY, 
+        const_cast<char *>(svcname.c_str())) == -1)
+    {
+        throw atmi_exception(tperrno);
+    }
+
+    ndrxpy_batch_t &b = M_batches[svcname];
+    b.func = func;
+    b.maxbatch = maxbatch;
+    b.maxwait = maxwait;
+}
+
+/**
+ * @brief Add native routing rule for the service. First rule advertises
+ *  the service.
+ * @param [in] svcname service name
+ * @param [in] expr UBF boolean expression or field name (if targets is dict)
+ * @param [in] targets target service name or dict of field value -> service
+ * @param [in] func optional Python function for requests not matched
+ */
+expublic void ndrxpy_pytpadvertise_route(const std::string &svcname, 
+    const std::string &expr, py::object targets, py::object func)
+{
+    ndrxpy_route_t r;
+    r.tree = nullptr;
+    r.fldid = BBADFLDID;
+
+    if (py::isinstance<py::dict>(targets))
+    {
+        if (BBADFLDID==(r.fldid = Bfldid(const_cast<char *>(expr.c_str()))))
+        {
+            throw ubf_exception(Berror);
+        }
+
+        for (auto &&kv: targets.cast<py::dict>())
+        {
+            r.valmap[py::str(kv.first).cast<std::string>()] = 
+                kv.second.cast<std::string>();
+        }
+    }
+    else if (py::isinstance<py::str>(targets))
+    {
+        r.target = targets.cast<std::string>();
+
+        if (nullptr==(r.tree = Bboolco(const_cast<char *>(expr.c_str()))))
+        {
+            throw ubf_exception(Berror);
+        }
+    }
+    else
+    {
+        throw std::invalid_argument("targets must be str or dict");
+    }
+
+    bool first;
+
+    {
+        std::lock_guard<std::mutex> lock(M_routes_mtx);
+        first = M_routes.end()==M_routes.find(svcname);
+    }
+
+    try
+    {
+        if (!first && !func.is_none())
+        {
+            throw std::invalid_argument("Service ["+svcname+"] already advertised");
+        }
+        else if (first && !func.is_none())
+        {
+            pytpadvertise(svcname, svcname, func.cast<py::function>());
+        }
+        else if (first && tpadvertise_full(const_cast<char *>(svcname.c_str()), PY, 
+            const_cast<char *>(svcname.c_str())) == -1)
+        {
+            throw atmi_exception(tperrno);
+        }
+    }
+    catch (...)
+    {
+        if (nullptr!=r.tree)
+        {
+            Btreefree(r.tree);
+        }
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(M_routes_mtx);
+    M_routes[svcname].push_back(r);
 }
 
 /**
@@ -473,6 +1196,118 @@ expublic void ndrxpy_register_srv(py::module &m)
         )pbdoc"
         , py::arg("svcname"));
 
+    m.def("tpadvertise_route", &ndrxpy_pytpadvertise_route,
+        R"pbdoc(
+        Advertise service with native content based routing. Rules are
+        evaluated by the service dispatcher in the order added, with out
+        acquiring the GIL and with out converting the buffer to Python objects.
+        The first matching rule forwards the request to the target service
+        with **tpforward(3)**. Only **UBF** buffers are routed.
+
+        If *targets* is string, then *expr* is UBF boolean expression which
+        routes the request to *targets* service when evaluated to true.
+        If *targets* is dict, then *expr* is field name, which's first
+        occurrence value (converted to string) is looked up in the dict
+        to get the target service.
+
+        Requests which match no rule are passed to *func*. If *func* was not
+        given, then the caller receives :data:`.TPESVCFAIL`.
+
+        First rule of the service advertises it, thus service shall not
+        be advertised by :func:`.tpadvertise`. Rules shall be added
+        from the :py:meth:`Server.tpsvrinit()`.
+
+        .. code-block:: python
+            :caption: Routing example
+            :name: tpadvertise_route-example
+
+                def tpsvrinit(self, args):
+                    e.tpadvertise_route('ROUTER', 'T_LONG_FLD > 100', 'BIGSVC', Server.ROUTER)
+                    e.tpadvertise_route('ROUTER', 'T_STRING_FLD', {'A':'SVCA', 'B':'SVCB'})
+                    return 0
+
+        This function applies to ATMI servers only.
+
+        :raise AtmiException:
+            | Following error codes may be present:
+            | :data:`.TPEINVAL` - Service name empty or too long (longer than **MAXTIDENT**)
+            | :data:`.TPELIMIT` - More than 48 services attempted to advertise by the script.
+            | :data:`.TPEMATCH` - Service already advertised.
+            | :data:`.TPEOS` - System error.
+
+        :raise UbfException:
+            | Following error codes may be present:
+            | :data:`.BSYNTAX` - Boolean expression syntax error.
+            | :data:`.BBADNAME` - Field not found.
+
+        Parameters
+        ----------
+        svcname : str
+            Service name to advertise
+        expr : str
+            UBF boolean expression or field name.
+        targets : str | dict
+            Target service or field value to target service mapping.
+        func : object
+            Optional callback function for requests not routed, see :func:`.tpadvertise`.
+            May be given for the first rule of the service only.
+        )pbdoc"
+        , py::arg("svcname"), py::arg("expr"), py::arg("targets"), py::arg("func")=py::none());
+
+    m.def("tpadvertise_batch", &ndrxpy_pytpadvertise_batch,
+        R"pbdoc(
+        Advertise micro-batched service. The service dispatcher parks incoming
+        requests (with **tpsrvgetctxdata(3)** and **tpcontinue(3)**) until
+        *maxbatch* requests are accumulated or the first parked request has waited
+        *maxwait* microseconds. Then *func* is called once, with the list of
+        requests. Replies are sent to the callers in the list order by
+        restoring each request context with **tpsrvsetctxdata(3)** and
+        performing **tpreturn(3)**.
+
+        *func* receives the server object and list of :class:`.TPSVCINFO`
+        and shall return list of tuples *(rval, rcode, data)* in the same order,
+        with the meaning of :func:`.tpreturn` arguments. Requests without
+        reply or if *func* raised exception are failed with :data:`.TPESVCERR`.
+        :func:`.tpreturn` and :func:`.tpforward` shall not be used by *func*.
+
+        Batches are flushed by the timer registered in the server poller, thus
+        the function applies to single threaded ATMI servers only (i.e.
+        **mindispatchthreads** not used), dispatch thread init fails if batched
+        services are advertised. Timer requires Linux **timerfd**.
+        Shall be called from the :py:meth:`Server.tpsvrinit()`.
+
+        .. code-block:: python
+            :caption: tpadvertise_batch example
+            :name: tpadvertise_batch-example
+
+                def tpsvrinit(self, args):
+                    e.tpadvertise_batch('SCORE', Server.SCORE, 32, 2000)
+                    return 0
+
+                def SCORE(self, reqs):
+                    scores = model.predict([r.data["data"]["T_DOUBLE_FLD"][0] for r in reqs])
+                    return [(e.TPSUCCESS, 0, {"data":{"T_DOUBLE_2_FLD":s}}) for s in scores]
+
+        :raise AtmiException:
+            | Following error codes may be present:
+            | :data:`.TPEINVAL` - Service name empty or too long (longer than **MAXTIDENT**)
+            | :data:`.TPELIMIT` - More than 48 services attempted to advertise by the script.
+            | :data:`.TPEMATCH` - Service already advertised.
+            | :data:`.TPEOS` - System error.
+
+        Parameters
+        ----------
+        svcname : str
+            Service name to advertise
+        func : object
+            Batch handler function.
+        maxbatch : int
+            Max number of requests in the batch.
+        maxwait : int
+            Max time in microseconds the first request of the batch may be parked.
+        )pbdoc"
+        , py::arg("svcname"), py::arg("func"), py::arg("maxbatch")=16, py::arg("maxwait")=1000);
+
     m.def("tpsubscribe", &ndrxpy_pytpsubscribe,
         R"pbdoc(
         Subscribe to event. Once event is published by the **tppost(3)**, it is
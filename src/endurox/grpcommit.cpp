@@ -0,0 +1,676 @@
+/**
+ * @brief Enduro/X Python module - transactional group commit writer
+ *
+ * @file grpcommit.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <string.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+/*---------------------------Enums--------------------------------------*/
+
+/**
+ * Group commit operations
+ */
+enum
+{
+    NDRXPY_GC_ENQUEUE = 0,  /**< tpenqueue()                            */
+    NDRXPY_GC_POST          /**< tppost()                               */
+};
+
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Message waiting for group commit
+ */
+struct ndrxpy_gcmsg_t
+{
+    int op;                     /**< NDRXPY_GC_*                        */
+    std::string name1;          /**< qspace or event name               */
+    std::string name2;          /**< qname                              */
+    TPQCTL ctl;                 /**< enqueue control / result           */
+    char *data;                 /**< Owned XATMI buffer                 */
+    long len;                   /**< Data len                           */
+    long flags;                 /**< Call flags                         */
+    long posted;                /**< tppost() result                    */
+    PyObject *fut;              /**< Future, own reference              */
+    std::chrono::steady_clock::time_point t_sub; /**< Submit time       */
+};
+
+/**
+ * Group commit writer. Messages submitted by any number of Python threads
+ * are written by the writer thread in shared transactions.
+ */
+class ndrxpy_grpcommit
+{
+public:
+
+    ndrxpy_grpcommit(long max_batch, double max_delay, unsigned long tran);
+    ~ndrxpy_grpcommit();
+
+    py::object enqueue(const std::string &qspace, const std::string &qname,
+        NDRXPY_TPQCTL *ctl, py::object data);
+    py::object post(const std::string &eventname, py::object data, long flags);
+    py::dict stats(void);
+    void close(void);
+
+private:
+
+    py::object submit(ndrxpy_gcmsg_t &m, py::object data);
+    void stop(void);
+    void run(void);
+    void complete(std::vector<ndrxpy_gcmsg_t> &batch, int err, long diag,
+        const std::string &diagmsg);
+
+    long M_max_batch;           /**< Max messages per transaction       */
+    std::chrono::microseconds M_max_delay; /**< Max wait for batch fill */
+    unsigned long M_tran;       /**< Transaction timeout                */
+
+    std::thread M_thread;
+    std::mutex M_join_mtx;      /**< Serializes close() callers         */
+    std::mutex M_mtx;
+    std::condition_variable M_cv;
+    std::deque<ndrxpy_gcmsg_t> M_pending;
+    bool M_stop = false;
+
+    /* metrics */
+    long M_batches = 0;
+    long M_failed = 0;
+    long M_messages = 0;
+    long M_batch_max = 0;
+    unsigned long long M_commit_sum = 0;    /**< usec                   */
+    unsigned long long M_commit_max = 0;
+    unsigned long long M_lat_sum = 0;       /**< submit to complete     */
+    unsigned long long M_lat_max = 0;
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+/** concurrent.futures.Future class, cached by first writer, never released */
+exprivate PyObject *M_future_cls = nullptr;
+
+/** Live writers, closed at exit while threads still may take GIL (GIL protected) */
+exprivate std::set<ndrxpy_grpcommit *> M_writers;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Start writer thread
+ */
+ndrxpy_grpcommit::ndrxpy_grpcommit(long max_batch, double max_delay, unsigned long tran)
+    : M_max_batch(max_batch),
+      M_max_delay(static_cast<long long>(max_delay*1000000)), M_tran(tran)
+{
+    if (max_batch < 1 || tran < 1)
+    {
+        throw std::invalid_argument("max_batch and tran must be greater than 0");
+    }
+
+    if (nullptr==M_future_cls)
+    {
+        py::object cls = py::module::import("concurrent.futures").attr("Future");
+        M_future_cls = cls.release().ptr();
+    }
+
+    M_thread = std::thread(&ndrxpy_grpcommit::run, this);
+    M_writers.insert(this);
+}
+
+/**
+ * @brief Flush pending messages and stop
+ */
+ndrxpy_grpcommit::~ndrxpy_grpcommit()
+{
+    M_writers.erase(this);
+
+    try
+    {
+        //Writer needs GIL to complete the futures
+        py::gil_scoped_release release;
+        stop();
+    }
+    catch (const std::exception &e)
+    {
+        NDRX_LOG(log_error, "Failed to close group commit writer: %s", e.what());
+    }
+}
+
+/**
+ * @brief Convert data and queue the message for the writer
+ * @param m message prepared by caller
+ * @param data Python buffer
+ * @return concurrent.futures.Future
+ */
+py::object ndrxpy_grpcommit::submit(ndrxpy_gcmsg_t &m, py::object data)
+{
+    atmibuf in = ndrx_from_py(data, false);
+    py::object fut = py::reinterpret_borrow<py::object>(M_future_cls)();
+
+    //UbfDict buffer is only referenced, writer needs own copy
+    if (nullptr==in.p && nullptr!=*in.pp)
+    {
+        UBFH *src = *in.fbfr();
+        atmibuf cpy("UBF", Bused(src));
+
+        if (EXSUCCEED!=Bcpy(*cpy.fbfr(), src))
+        {
+            throw ubf_exception(Berror);
+        }
+
+        in.pp = &in.p;
+        in = std::move(cpy);
+    }
+
+    m.len = in.len;
+    m.posted = 0;
+    m.t_sub = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(M_mtx);
+
+    if (M_stop)
+    {
+        throw atmi_exception(TPEPROTO);
+    }
+
+    m.data = in.release();
+    m.fut = fut.inc_ref().ptr();
+    M_pending.push_back(m);
+
+    if (static_cast<long>(M_pending.size()) >= M_max_batch || 1==M_pending.size())
+    {
+        M_cv.notify_one();
+    }
+
+    return fut;
+}
+
+/**
+ * @brief Submit tpenqueue()
+ */
+py::object ndrxpy_grpcommit::enqueue(const std::string &qspace, const std::string &qname,
+        NDRXPY_TPQCTL *ctl, py::object data)
+{
+    ndrxpy_gcmsg_t m;
+
+    m.op = NDRXPY_GC_ENQUEUE;
+    m.name1 = qspace;
+    m.name2 = qname;
+    m.flags = 0;
+    memset(&m.ctl, 0, sizeof(m.ctl));
+
+    if (nullptr!=ctl)
+    {
+        ctl->convert_to_base();
+        m.ctl = *dynamic_cast<TPQCTL*>(ctl);
+    }
+
+    return submit(m, data);
+}
+
+/**
+ * @brief Submit tppost()
+ */
+py::object ndrxpy_grpcommit::post(const std::string &eventname, py::object data, long flags)
+{
+    ndrxpy_gcmsg_t m;
+
+    m.op = NDRXPY_GC_POST;
+    m.name1 = eventname;
+    m.flags = flags;
+    memset(&m.ctl, 0, sizeof(m.ctl));
+
+    return submit(m, data);
+}
+
+/**
+ * @brief Complete the futures of the batch with shared outcome, free buffers.
+ *  Called by writer thread, acquires GIL once.
+ * @param batch messages written
+ * @param err 0 on commit, else ATMI error
+ * @param diag queue diagnostic, if err is TPEDIAGNOSTIC
+ * @param diagmsg queue diagnostic message
+ */
+void ndrxpy_grpcommit::complete(std::vector<ndrxpy_gcmsg_t> &batch, int err,
+        long diag, const std::string &diagmsg)
+{
+    for (auto &m: batch)
+    {
+        tpfree(m.data);
+        m.data = nullptr;
+    }
+
+    auto t_done = std::chrono::steady_clock::now();
+
+    {
+        py::gil_scoped_acquire acquire;
+
+        try
+        {
+            py::object ex = py::none();
+
+            if (0!=err)
+            {
+                py::module mod = py::module::import("endurox");
+
+                if (TPEDIAGNOSTIC==err)
+                {
+                    ex = mod.attr("QmException")(diagmsg, diag);
+                }
+                else
+                {
+                    ex = mod.attr("AtmiException")(tpstrerror(err), err);
+                }
+            }
+
+            for (auto &m: batch)
+            {
+                py::object fut = py::reinterpret_steal<py::object>(m.fut);
+                m.fut = nullptr;
+
+                //Cancelled futures cannot be completed
+                if (fut.attr("done")().cast<bool>())
+                {
+                    continue;
+                }
+
+                if (0!=err)
+                {
+                    fut.attr("set_exception")(ex);
+                }
+                else if (NDRXPY_GC_ENQUEUE==m.op)
+                {
+                    NDRXPY_TPQCTL r;
+                    *dynamic_cast<TPQCTL*>(&r) = m.ctl;
+                    r.convert_from_base();
+                    fut.attr("set_result")(py::cast(r));
+                }
+                else
+                {
+                    fut.attr("set_result")(m.posted);
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            NDRX_LOG(log_error, "Failed to complete group commit futures: %s", e.what());
+            userlog(const_cast<char *>("Failed to complete group commit futures: %s"), e.what());
+
+            for (auto &m: batch)
+            {
+                Py_XDECREF(m.fut);
+                m.fut = nullptr;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(M_mtx);
+
+    for (auto &m: batch)
+    {
+        unsigned long long lat = std::chrono::duration_cast<std::chrono::microseconds>(
+            t_done - m.t_sub).count();
+
+        M_lat_sum+=lat;
+
+        if (lat > M_lat_max)
+        {
+            M_lat_max = lat;
+        }
+    }
+}
+
+/**
+ * @brief Writer thread. Uses own ATMI context.
+ */
+void ndrxpy_grpcommit::run(void)
+{
+    int open_err = 0;
+
+    if (EXSUCCEED!=tpopen())
+    {
+        open_err = tperrno;
+        NDRX_LOG(log_error, "Group commit writer tpopen() failed: %s",
+            tpstrerror(open_err));
+    }
+
+    std::unique_lock<std::mutex> lock(M_mtx);
+
+    while (true)
+    {
+        M_cv.wait(lock, [this]{ return M_stop || !M_pending.empty(); });
+
+        if (M_pending.empty())
+        {
+            break;
+        }
+
+        //Let the batch fill up, bounded by size and time from the first message
+        auto deadline = M_pending.front().t_sub + M_max_delay;
+
+        M_cv.wait_until(lock, deadline, [this]{ return M_stop || 
+            static_cast<long>(M_pending.size()) >= M_max_batch; });
+
+        std::vector<ndrxpy_gcmsg_t> batch;
+        long n = std::min(static_cast<long>(M_pending.size()), M_max_batch);
+
+        batch.reserve(n);
+
+        for (long i=0; i<n; i++)
+        {
+            batch.push_back(M_pending.front());
+            M_pending.pop_front();
+        }
+
+        lock.unlock();
+
+        auto t0 = std::chrono::steady_clock::now();
+        int err = open_err;
+        long diag = 0;
+        std::string diagmsg;
+
+        if (0==err && EXSUCCEED!=tpbegin(M_tran, 0))
+        {
+            err = tperrno;
+        }
+        else if (0==err)
+        {
+            for (auto &m: batch)
+            {
+                if (NDRXPY_GC_ENQUEUE==m.op)
+                {
+                    if (EXSUCCEED!=tpenqueue(const_cast<char *>(m.name1.c_str()),
+                        const_cast<char *>(m.name2.c_str()), &m.ctl, m.data, m.len, 0))
+                    {
+                        err = tperrno;
+                        diag = m.ctl.diagnostic;
+                        diagmsg = m.ctl.diagmsg;
+                        break;
+                    }
+                }
+                else if (EXFAIL==(m.posted = tppost(const_cast<char *>(m.name1.c_str()),
+                        m.data, m.len, m.flags)))
+                {
+                    err = tperrno;
+                    break;
+                }
+            }
+
+            if (0!=err)
+            {
+                tpabort(0);
+            }
+            else if (EXSUCCEED!=tpcommit(0))
+            {
+                err = tperrno;
+            }
+        }
+
+        unsigned long long commit_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+
+        if (0!=err)
+        {
+            NDRX_LOG(log_error, "Group commit of %ld messages failed: %s",
+                n, tpstrerror(err));
+        }
+
+        complete(batch, err, diag, diagmsg);
+
+        lock.lock();
+
+        M_batches++;
+        M_messages+=n;
+        M_commit_sum+=commit_us;
+
+        if (0!=err)
+        {
+            M_failed++;
+        }
+
+        if (n > M_batch_max)
+        {
+            M_batch_max = n;
+        }
+
+        if (commit_us > M_commit_max)
+        {
+            M_commit_max = commit_us;
+        }
+    }
+
+    lock.unlock();
+
+    if (0==open_err)
+    {
+        tpclose();
+    }
+
+    tpterm();
+}
+
+/**
+ * @brief Return writer metrics
+ * @return dict
+ */
+py::dict ndrxpy_grpcommit::stats(void)
+{
+    py::dict ret;
+    std::lock_guard<std::mutex> lock(M_mtx);
+
+    ret["batches"] = M_batches;
+    ret["failed"] = M_failed;
+    ret["messages"] = M_messages;
+    ret["pending"] = M_pending.size();
+    ret["batch_avg"] = M_batches > 0 ? static_cast<double>(M_messages) / M_batches : 0.0;
+    ret["batch_max"] = M_batch_max;
+    ret["commit_avg_us"] = M_batches > 0 ? M_commit_sum / M_batches : 0;
+    ret["commit_max_us"] = M_commit_max;
+    ret["latency_avg_us"] = M_messages > 0 ? M_lat_sum / M_messages : 0;
+    ret["latency_max_us"] = M_lat_max;
+
+    return ret;
+}
+
+/**
+ * @brief Write pending messages and stop the writer thread.
+ *  Shall be called with GIL released.
+ */
+void ndrxpy_grpcommit::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(M_mtx);
+        M_stop = true;
+        M_cv.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(M_join_mtx);
+
+    if (M_thread.joinable())
+    {
+        M_thread.join();
+    }
+}
+
+/**
+ * @brief Write pending messages and stop the writer thread
+ */
+void ndrxpy_grpcommit::close(void)
+{
+    py::gil_scoped_release release;
+    stop();
+}
+
+/**
+ * @brief Register group commit writer class
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_grpcommit(py::module &m)
+{
+    py::class_<ndrxpy_grpcommit>(m, "GroupCommitWriter", R"pbdoc(
+        Transactional group commit writer. Messages submitted by any number of
+        Python threads are collected and written by the writer thread (with its
+        own ATMI context) in shared transactions: **tpbegin(3)**, up to
+        *max_batch* **tpenqueue(3)** / **tppost(3)** calls, **tpcommit(3)**.
+        Batch is started when *max_batch* messages are pending, or *max_delay*
+        seconds after its first message was submitted. Thus the cost of the
+        transaction commit (two phase commit log write) is shared by the batch.
+
+        Every submit returns :class:`concurrent.futures.Future`, which is
+        completed after the commit with the call result, or with the exception
+        of the batch, if any call or the commit failed (all messages of the
+        batch are rolled back). Cancelled futures do not withdraw the message.
+
+        Writer calls **tpopen(3)**, thus XA resource manager shall be configured
+        for the process (e.g. **NDRX_CCTAG**).
+
+        .. code-block:: python
+            :caption: GroupCommitWriter example
+            :name: GroupCommitWriter-example
+
+                gc = e.GroupCommitWriter(max_batch=200, max_delay=0.005)
+                fut = gc.enqueue("SAMPLESPACE", "TESTQ", None, {"data":"SOME DATA"})
+                qctl = fut.result()
+                gc.close()
+
+        Parameters
+        ----------
+        max_batch : int
+            Max messages per transaction.
+        max_delay : float
+            Max seconds to wait for the batch to fill up.
+        tran : int
+            Transaction timeout in seconds.
+        )pbdoc")
+        .def(py::init([](long max_batch, double max_delay, unsigned long tran)
+            {
+                return std::unique_ptr<ndrxpy_grpcommit>(
+                    new ndrxpy_grpcommit(max_batch, max_delay, tran));
+            }),
+            py::arg("max_batch")=100, py::arg("max_delay")=0.005, py::arg("tran")=60)
+        .def("enqueue", &ndrxpy_grpcommit::enqueue, R"pbdoc(
+            Submit message for :func:`.tpenqueue`.
+
+            :raise AtmiException: 
+                | :data:`.TPEPROTO` - Writer is closed.
+
+            Parameters
+            ----------
+            qspace : str
+                Queue space name.
+            qname : str
+                Queue name.
+            ctl : TPQCTL
+                Control structure, may be **None**.
+            data : dict
+                Input XATMI buffer.
+
+            Returns
+            -------
+            concurrent.futures.Future
+                Completed with :class:`.TPQCTL` of the enqueue.
+            )pbdoc", py::arg("qspace"), py::arg("qname"), py::arg("ctl"), py::arg("data"))
+        .def("post", &ndrxpy_grpcommit::post, R"pbdoc(
+            Submit event for :func:`.tppost`.
+
+            :raise AtmiException: 
+                | :data:`.TPEPROTO` - Writer is closed.
+
+            Parameters
+            ----------
+            eventname : str
+                Event name.
+            data : dict
+                Input XATMI buffer.
+            flags : int
+                :func:`.tppost` flags.
+
+            Returns
+            -------
+            concurrent.futures.Future
+                Completed with :func:`.tppost` result.
+            )pbdoc", py::arg("eventname"), py::arg("data"), py::arg("flags")=0)
+        .def("stats", &ndrxpy_grpcommit::stats, R"pbdoc(
+            Return writer metrics.
+
+            Returns
+            -------
+            dict
+                **batches**, **failed** - transactions written / failed,
+                **messages** - messages written, **pending** - messages waiting,
+                **batch_avg**, **batch_max** - messages per transaction,
+                **commit_avg_us**, **commit_max_us** - transaction time,
+                **latency_avg_us**, **latency_max_us** - time from submit to
+                future completion, microseconds.
+            )pbdoc")
+        .def("close", &ndrxpy_grpcommit::close, R"pbdoc(
+            Write pending messages and stop the writer thread. Writers
+            not closed are closed at interpreter exit.
+            )pbdoc");
+
+    //Stop writers before interpreter finalization, as they need GIL
+    py::module::import("atexit").attr("register")(py::cpp_function([](void)
+    {
+        std::set<ndrxpy_grpcommit *> writers = M_writers;
+
+        for (auto w: writers)
+        {
+            w->close();
+        }
+    }));
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
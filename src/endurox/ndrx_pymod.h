@@ -61,6 +61,7 @@ extern __thread bool ndrxpy_G_ubfdict_delonset; /**< Use UbfDict() by default */
 #define NDRXPY_SUBBUF_NORM      0           /**< Normal XATMI buffer        */
 #define NDRXPY_SUBBUF_UBF       1           /**< Embedded UBF               */
 #define NDRXPY_SUBBUF_PTR       2           /**< This is PTR buffer         */
+#define NDRXPY_SUBBUF_ARENA     3           /**< UBF in shared memory arena */
 
 /*---------------------------Enums--------------------------------------*/
 /*---------------------------Typedefs-----------------------------------*/
@@ -404,6 +405,9 @@ extern void ndrxpy_reset_ptr_UbfDict(py::object data);
 extern py::object ndrxpy_alloc_UbfDict(char *data, int is_sub_buffer, BFLDLEN buflen);
 extern py::object ndrxpy_to_py_ubf(UBFH *fbfr, BFLDLEN buflen);
 extern void ndrxpy_from_py_ubf(py::dict obj, atmibuf &b);
+extern void ndrxpy_ubfarena_unref(char *data);
+extern BFLDID ndrxpy_fldid(const char *name);
+extern char *ndrxpy_fldname(BFLDID fldid);
 
 extern void pytpadvertise(std::string svcname, std::string funcname, const py::function &func);
 extern void ndrxpy_pyrun(py::object svr, std::vector<std::string> args);
@@ -418,6 +422,10 @@ extern NDRXPY_TPQCTL ndrxpy_pytpenqueue(const char *qspace, const char *qname, N
 extern std::pair<NDRXPY_TPQCTL, py::object> ndrx_pytpdequeue(const char *qspace,
                                                  const char *qname, NDRXPY_TPQCTL *ctl,
                                                  long flags);
+extern py::list ndrxpy_pytpenqueue_many(const char *qspace, const char *qname,
+    NDRXPY_TPQCTL *ctl, py::list data, long flags, unsigned long tran);
+extern py::list ndrxpy_pytpdequeue_many(const char *qspace, const char *qname,
+    NDRXPY_TPQCTL *ctl, long max, long flags, unsigned long tran);
 extern pytpreply ndrxpy_pytpcall(const char *svc, py::object idata, long flags);
 extern int ndrxpy_pytpacall(const char *svc, py::object idata, long flags);
 
@@ -429,6 +437,31 @@ extern int ndrxpy_pytppost(const std::string eventname, py::object data, long fl
 extern long ndrxpy_pytpsubscribe(char *eventexpr, char *filter, TPEVCTL *ctl, long flags);
 
 extern void ndrxpy_fdmap_clear(void);
+extern int ndrxpy_pollerfd_add(int fd, uint32_t events, void *ptr1,
+    int (*cb)(int fd, uint32_t events, void *ptr1));
+extern int ndrxpy_pollerfd_del(int fd);
+extern void ndrxpy_timer_clear(void);
+
+struct ndrxpy_svccache_t;
+extern int ndrxpy_svccache_lookup(TPSVCINFO *svcinfo);
+extern void ndrxpy_svccache_store(int rval, long rcode, char *buf, long len);
+extern void ndrxpy_svccache_reset(void);
+extern ndrxpy_svccache_t *ndrxpy_svccache_detach(std::string &key);
+extern void ndrxpy_svccache_attach(ndrxpy_svccache_t *c, const std::string &key);
+extern void ndrxpy_svccache_clear(void);
+
+extern int ndrxpy_svcstats_on(void);
+extern unsigned long long ndrxpy_svcstats_now(void);
+extern void ndrxpy_svcstats_reply(unsigned long long out_us, unsigned long long reply_us);
+extern void ndrxpy_svcstats_add(const char *svc, unsigned long long t0,
+    unsigned long long t1, unsigned long long t2, unsigned long long t3);
+
+extern int ndrxpy_tplog_level(void);
+extern void ndrxpy_tplog_invalidate(void);
+extern bool ndrxpy_tplog_route(std::string &reqfile);
+extern void ndrxpy_tplog_write(int lev, const std::string &msg);
+extern bool ndrxpy_tplog_pending(void);
+extern void ndrxpy_tplog_flush(void);
 
 extern void ndrxpy_register_atmi(py::module &m);
 extern void ndrxpy_register_ubf(py::module &m);
@@ -436,6 +469,16 @@ extern void ndrxpy_register_srv(py::module &m);
 extern void ndrxpy_register_util(py::module &m);
 extern void ndrxpy_register_tpext(py::module &m);
 extern void ndrxpy_register_tplog(py::module &m);
+extern void ndrxpy_register_svccache(py::module &m);
+extern void ndrxpy_register_svcstats(py::module &m);
+extern void ndrxpy_register_tptimer(py::module &m);
+extern void ndrxpy_register_unsolq(py::module &m);
+extern void ndrxpy_register_qconsumer(py::module &m);
+extern void ndrxpy_register_grpcommit(py::module &m);
+extern void ndrxpy_register_tplogasync(py::module &m);
+extern void ndrxpy_register_ubfarena(py::module &m);
+extern void ndrxpy_register_ubfjson(py::module &m);
+extern void ndrxpy_register_ubfdelta(py::module &m);
 #endif /* NDRX_PYMOD.H */
 
 /* vim: set ts=4 sw=4 et smartindent: */
@@ -0,0 +1,945 @@
+/**
+ * @brief Enduro/X Python module - native queue consumer
+ *
+ * @file qconsumer.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <time.h>
+#include <string.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Prefetched message
+ */
+struct ndrxpy_qmsg_t
+{
+    TPQCTL ctl;                 /**< Dequeue result                     */
+    char *data;                 /**< Owned XATMI buffer                 */
+    long len;                   /**< Data len                           */
+    long bytes;                 /**< Accounted size                     */
+    unsigned long long t_deq;   /**< Dequeue time, usec                 */
+};
+
+/**
+ * Queue consumer. In transactional mode native thread dequeues ahead into
+ * bounded buffer in batches, Python takes the messages, batch is committed
+ * when all its messages are acknowledged. Non transactional consumer
+ * dequeues on demand (dequeue is destructive, nothing is read ahead).
+ */
+class ndrxpy_qconsumer
+{
+public:
+
+    ndrxpy_qconsumer(const std::string &qspace, const std::string &qname,
+        NDRXPY_TPQCTL *ctl, long prefetch, long prefetch_bytes, unsigned long tran,
+        long flags, double idle);
+    ~ndrxpy_qconsumer();
+
+    py::object get(double timeout);
+    py::object next(void);
+    void ack(void);
+    void nack(void);
+    long consume(py::function func, long max);
+    py::dict stats(void);
+    void close(void);
+
+private:
+
+    void run(void);
+    py::object get_buffered(double timeout, bool stop_on_empty);
+    py::object get_direct(double timeout);
+    void finish_batch(std::unique_lock<std::mutex> &lock);
+    void fail(int err, long diag, const char *diagmsg);
+    void drop_buffered(void);
+    unsigned long long now(void);
+
+    std::string M_qspace;
+    std::string M_qname;
+    TPQCTL M_base;              /**< Template control struct            */
+    long M_prefetch;            /**< Max buffered / batch messages      */
+    long M_prefetch_bytes;      /**< Max buffered bytes                 */
+    unsigned long M_tran;       /**< Transaction timeout, 0 - no tran   */
+    long M_flags;               /**< Dequeue flags                      */
+    long M_idle_ms;             /**< Sleep on empty queue               */
+
+    std::thread M_thread;
+    std::mutex M_mtx;
+    std::condition_variable M_cv_data;  /**< Signalled to Python        */
+    std::condition_variable M_cv_space; /**< Signalled to thread        */
+
+    std::deque<ndrxpy_qmsg_t> M_buf;
+    long M_buf_bytes = 0;
+    bool M_stop = false;
+    bool M_finished = false;
+    bool M_autoack = false;     /**< Iterator acks previous message     */
+    long M_empty_seq = 0;       /**< Queue found empty, by thread       */
+
+    /* current transaction batch */
+    long M_batch_cnt = 0;       /**< Dequeued in batch                  */
+    long M_batch_handed = 0;    /**< Taken by Python                    */
+    long M_batch_acked = 0;     /**< Acknowledged by Python             */
+    bool M_batch_nack = false;  /**< Python requested rollback          */
+
+    /* error reported by thread */
+    int M_err = 0;
+    long M_diag = 0;
+    std::string M_diagmsg;
+
+    /* metrics */
+    unsigned long long M_t_start;
+    long M_dequeued = 0;
+    long M_delivered = 0;
+    long M_acked = 0;
+    long M_commits = 0;
+    long M_aborts = 0;
+    unsigned long long M_lag_sum = 0;
+    unsigned long long M_lag_max = 0;
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Start consumer thread
+ */
+ndrxpy_qconsumer::ndrxpy_qconsumer(const std::string &qspace, const std::string &qname,
+        NDRXPY_TPQCTL *ctl, long prefetch, long prefetch_bytes, unsigned long tran,
+        long flags, double idle)
+    : M_qspace(qspace), M_qname(qname), M_prefetch(prefetch),
+      M_prefetch_bytes(prefetch_bytes), M_tran(tran), M_flags(flags)
+{
+    if (prefetch < 1 || prefetch_bytes < 1)
+    {
+        throw std::invalid_argument("prefetch and prefetch_bytes must be greater than 0");
+    }
+
+    memset(&M_base, 0, sizeof(M_base));
+
+    if (nullptr!=ctl)
+    {
+        ctl->convert_to_base();
+        M_base = *dynamic_cast<TPQCTL*>(ctl);
+    }
+
+    M_idle_ms = static_cast<long>(idle*1000);
+
+    if (M_idle_ms < 1)
+    {
+        M_idle_ms = 1;
+    }
+
+    M_t_start = now();
+
+    if (M_tran > 0)
+    {
+        M_thread = std::thread(&ndrxpy_qconsumer::run, this);
+    }
+}
+
+/**
+ * @brief Stop the thread, return buffered messages
+ */
+ndrxpy_qconsumer::~ndrxpy_qconsumer()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &e)
+    {
+        NDRX_LOG(log_error, "Failed to close queue consumer: %s", e.what());
+    }
+}
+
+/**
+ * @brief Monotonic time
+ * @return usec
+ */
+unsigned long long ndrxpy_qconsumer::now(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Record thread error, stop the consumer. Lock must be held.
+ */
+void ndrxpy_qconsumer::fail(int err, long diag, const char *diagmsg)
+{
+    NDRX_LOG(log_error, "Queue consumer %s/%s failed: %s",
+        M_qspace.c_str(), M_qname.c_str(), tpstrerror(err));
+    M_err = err;
+    M_diag = diag;
+    M_diagmsg = diagmsg;
+    M_stop = true;
+}
+
+/**
+ * @brief Free buffered messages. Lock must be held.
+ */
+void ndrxpy_qconsumer::drop_buffered(void)
+{
+    for (auto &m: M_buf)
+    {
+        tpfree(m.data);
+    }
+
+    M_buf.clear();
+    M_buf_bytes = 0;
+}
+
+/**
+ * @brief Wait for the transactional batch to be acknowledged, then commit
+ *  (or roll back on nack / stop). Lock must be held.
+ * @param lock consumer lock
+ */
+void ndrxpy_qconsumer::finish_batch(std::unique_lock<std::mutex> &lock)
+{
+    M_cv_space.wait(lock, [this]{ return M_stop || M_batch_nack || 
+        M_batch_acked >= M_batch_cnt; });
+
+    bool commit = !M_batch_nack && M_batch_acked >= M_batch_cnt;
+
+    if (!commit)
+    {
+        //Rolled back messages will be delivered again
+        drop_buffered();
+    }
+
+    lock.unlock();
+
+    int ret = commit ? tpcommit(0) : tpabort(0);
+    int err = tperrno;
+
+    lock.lock();
+
+    if (commit && EXSUCCEED==ret)
+    {
+        M_commits++;
+    }
+    else
+    {
+        M_aborts++;
+        NDRX_LOG(log_warn, "Queue consumer %s/%s batch of %ld rolled back: %s",
+            M_qspace.c_str(), M_qname.c_str(), M_batch_cnt, 
+            commit?tpstrerror(err):"nack");
+    }
+
+    M_batch_cnt = 0;
+    M_batch_handed = 0;
+    M_batch_acked = 0;
+    M_batch_nack = false;
+}
+
+/**
+ * @brief Consumer thread. Uses own ATMI context.
+ */
+void ndrxpy_qconsumer::run(void)
+{
+    bool intran = false;
+    std::unique_lock<std::mutex> lock(M_mtx);
+
+    if (M_tran > 0)
+    {
+        lock.unlock();
+        int ret = tpopen();
+        int err = tperrno;
+        lock.lock();
+
+        if (EXSUCCEED!=ret)
+        {
+            fail(err, 0, "");
+        }
+    }
+
+    while (!M_stop)
+    {
+        bool end_batch = false;
+
+        M_cv_space.wait(lock, [this]{ return M_stop || 
+            (static_cast<long>(M_buf.size()) < M_prefetch && M_buf_bytes < M_prefetch_bytes &&
+                (0==M_tran || M_batch_cnt < M_prefetch)) || M_batch_nack; });
+
+        if (M_stop)
+        {
+            break;
+        }
+
+        if (M_batch_nack)
+        {
+            //Roll back early, or ignore if nothing is dequeued
+            if (intran)
+            {
+                finish_batch(lock);
+                intran = false;
+            }
+
+            M_batch_nack = false;
+            continue;
+        }
+
+        lock.unlock();
+
+        int err = 0;
+        ndrxpy_qmsg_t m;
+        m.ctl = M_base;
+        m.len = 0;
+
+        if (M_tran > 0 && !intran)
+        {
+            if (EXSUCCEED!=tpbegin(M_tran, 0))
+            {
+                err = tperrno;
+                lock.lock();
+                fail(err, 0, "");
+                break;
+            }
+            intran = true;
+        }
+
+        if (nullptr==(m.data = tpalloc(const_cast<char *>("UBF"), nullptr, 1024)))
+        {
+            err = tperrno;
+        }
+        else if (EXSUCCEED!=tpdequeue(const_cast<char *>(M_qspace.c_str()),
+                const_cast<char *>(M_qname.c_str()), &m.ctl, &m.data, &m.len, M_flags))
+        {
+            err = tperrno;
+            tpfree(m.data);
+            m.data = nullptr;
+        }
+
+        lock.lock();
+
+        if (0!=err)
+        {
+            if (TPEDIAGNOSTIC==err && QMENOMSG==m.ctl.diagnostic)
+            {
+                if (intran && M_batch_cnt > 0)
+                {
+                    end_batch = true;
+                }
+                else
+                {
+                    if (intran)
+                    {
+                        lock.unlock();
+                        tpabort(0);
+                        lock.lock();
+                        intran = false;
+                    }
+
+                    //Let the iterator stop
+                    M_empty_seq++;
+                    M_cv_data.notify_all();
+
+                    M_cv_space.wait_for(lock, std::chrono::milliseconds(M_idle_ms),
+                        [this]{ return M_stop; });
+                    continue;
+                }
+            }
+            else
+            {
+                fail(err, m.ctl.diagnostic, m.ctl.diagmsg);
+                break;
+            }
+        }
+        else if (M_batch_nack)
+        {
+            //Batch is being rolled back
+            tpfree(m.data);
+            continue;
+        }
+        else
+        {
+            char type[8] = {EXEOS};
+
+            m.bytes = m.len;
+
+            if (EXFAIL!=tptypes(m.data, type, nullptr) && 0==strcmp(type, "UBF"))
+            {
+                m.bytes = Bused(reinterpret_cast<UBFH *>(m.data));
+            }
+
+            m.t_deq = now();
+            M_buf.push_back(m);
+            M_buf_bytes+=m.bytes;
+            M_dequeued++;
+            M_cv_data.notify_all();
+
+            if (M_tran > 0)
+            {
+                M_batch_cnt++;
+
+                if (M_batch_cnt >= M_prefetch)
+                {
+                    end_batch = true;
+                }
+            }
+        }
+
+        if (end_batch)
+        {
+            finish_batch(lock);
+            intran = false;
+        }
+    }
+
+    if (intran)
+    {
+        drop_buffered();
+        lock.unlock();
+        tpabort(0);
+        lock.lock();
+        M_aborts++;
+    }
+
+    lock.unlock();
+
+    if (M_tran > 0)
+    {
+        tpclose();
+    }
+
+    tpterm();
+
+    lock.lock();
+    M_finished = true;
+    M_cv_data.notify_all();
+}
+
+/**
+ * @brief Take next message
+ * @param timeout seconds to wait, < 0 forever
+ * @return (TPQCTL, data) or None on timeout / consumer stopped
+ */
+py::object ndrxpy_qconsumer::get(double timeout)
+{
+    if (0==M_tran)
+    {
+        return get_direct(timeout);
+    }
+
+    return get_buffered(timeout, false);
+}
+
+/**
+ * @brief Dequeue in the caller thread (non transactional mode)
+ * @param timeout seconds to wait, < 0 forever, 0 - single attempt
+ * @return (TPQCTL, data) or None on timeout / empty queue / consumer stopped
+ */
+py::object ndrxpy_qconsumer::get_direct(double timeout)
+{
+    ndrxpy_qmsg_t m;
+    bool found = false;
+    auto deadline = std::chrono::steady_clock::now() + 
+        std::chrono::microseconds(static_cast<long long>(timeout*1000000));
+
+    {
+        py::gil_scoped_release release;
+
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(M_mtx);
+
+                if (M_stop)
+                {
+                    break;
+                }
+            }
+
+            m.ctl = M_base;
+            m.len = 0;
+
+            if (nullptr==(m.data = tpalloc(const_cast<char *>("UBF"), nullptr, 1024)))
+            {
+                throw atmi_exception(tperrno);
+            }
+
+            if (EXSUCCEED==tpdequeue(const_cast<char *>(M_qspace.c_str()),
+                const_cast<char *>(M_qname.c_str()), &m.ctl, &m.data, &m.len, M_flags))
+            {
+                found = true;
+                break;
+            }
+
+            int err = tperrno;
+            tpfree(m.data);
+
+            if (TPEDIAGNOSTIC==err && QMENOMSG!=m.ctl.diagnostic)
+            {
+                throw qm_exception(m.ctl.diagnostic, m.ctl.diagmsg);
+            }
+            else if (TPEDIAGNOSTIC!=err)
+            {
+                throw atmi_exception(err);
+            }
+
+            //Queue is empty
+            auto wait = std::chrono::microseconds(M_idle_ms*1000);
+
+            if (0==timeout)
+            {
+                break;
+            }
+            else if (timeout > 0)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+                    deadline - std::chrono::steady_clock::now());
+
+                if (left.count() <= 0)
+                {
+                    break;
+                }
+                else if (left < wait)
+                {
+                    wait = left;
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(M_mtx);
+            M_cv_space.wait_for(lock, wait, [this]{ return M_stop; });
+        }
+
+        if (found)
+        {
+            std::lock_guard<std::mutex> lock(M_mtx);
+            M_dequeued++;
+            M_delivered++;
+            M_acked++;
+        }
+    }
+
+    if (!found)
+    {
+        return py::none();
+    }
+
+    NDRXPY_TPQCTL ctl;
+    *dynamic_cast<TPQCTL*>(&ctl) = m.ctl;
+    ctl.convert_from_base();
+
+    atmibuf b;
+    b.p = m.data;
+    b.len = m.len;
+
+    return py::make_tuple(ctl, ndrx_to_py(b, false));
+}
+
+/**
+ * @brief Take next message from the read-ahead buffer (transactional mode)
+ * @param timeout seconds to wait, < 0 forever
+ * @param stop_on_empty return when consumer thread finds the queue empty
+ * @return (TPQCTL, data) or None on timeout / empty queue / consumer stopped
+ */
+py::object ndrxpy_qconsumer::get_buffered(double timeout, bool stop_on_empty)
+{
+    ndrxpy_qmsg_t m;
+
+    {
+        py::gil_scoped_release release;
+        std::unique_lock<std::mutex> lock(M_mtx);
+        long empty_seq = M_empty_seq;
+        auto pred = [this, stop_on_empty, empty_seq]{ return !M_buf.empty() || M_finished ||
+            (stop_on_empty && empty_seq!=M_empty_seq); };
+
+        if (timeout < 0)
+        {
+            M_cv_data.wait(lock, pred);
+        }
+        else
+        {
+            M_cv_data.wait_for(lock, std::chrono::microseconds(
+                static_cast<long long>(timeout*1000000)), pred);
+        }
+
+        if (M_buf.empty())
+        {
+            if (0!=M_err)
+            {
+                int err = M_err;
+                M_err = 0;
+
+                if (TPEDIAGNOSTIC==err)
+                {
+                    throw qm_exception(M_diag, const_cast<char *>(M_diagmsg.c_str()));
+                }
+                throw atmi_exception(err);
+            }
+
+            return py::none();
+        }
+
+        m = M_buf.front();
+        M_buf.pop_front();
+        M_buf_bytes-=m.bytes;
+        M_delivered++;
+
+        unsigned long long lag = now() - m.t_deq;
+        M_lag_sum+=lag;
+
+        if (lag > M_lag_max)
+        {
+            M_lag_max = lag;
+        }
+
+        if (M_tran > 0)
+        {
+            M_batch_handed++;
+        }
+        else
+        {
+            M_acked++;
+        }
+
+        M_cv_space.notify_all();
+    }
+
+    NDRXPY_TPQCTL ctl;
+    *dynamic_cast<TPQCTL*>(&ctl) = m.ctl;
+    ctl.convert_from_base();
+
+    atmibuf b;
+    b.p = m.data;
+    b.len = m.len;
+
+    return py::make_tuple(ctl, ndrx_to_py(b, false));
+}
+
+/**
+ * @brief Iterator step, acks previous message. Iteration stops when
+ *  queue is empty.
+ * @return (TPQCTL, data)
+ */
+py::object ndrxpy_qconsumer::next(void)
+{
+    if (M_autoack)
+    {
+        ack();
+    }
+
+    py::object ret = 0==M_tran ? get_direct(0) : get_buffered(-1, true);
+
+    if (ret.is_none())
+    {
+        throw py::stop_iteration();
+    }
+
+    M_autoack = true;
+
+    return ret;
+}
+
+/**
+ * @brief Acknowledge all messages taken so far
+ */
+void ndrxpy_qconsumer::ack(void)
+{
+    std::lock_guard<std::mutex> lock(M_mtx);
+
+    M_autoack = false;
+
+    if (M_tran > 0)
+    {
+        M_acked+=M_batch_handed - M_batch_acked;
+        M_batch_acked = M_batch_handed;
+        M_cv_space.notify_all();
+    }
+}
+
+/**
+ * @brief Roll back current batch
+ */
+void ndrxpy_qconsumer::nack(void)
+{
+    std::lock_guard<std::mutex> lock(M_mtx);
+
+    M_autoack = false;
+
+    if (M_tran > 0)
+    {
+        //Do not deliver messages of the batch being rolled back
+        drop_buffered();
+        M_batch_nack = true;
+        M_cv_space.notify_all();
+    }
+}
+
+/**
+ * @brief Pass messages to callback until consumer is closed
+ * @param func callback (qctl, data)
+ * @param max max messages, 0 - unlimited
+ * @return number of messages processed
+ */
+long ndrxpy_qconsumer::consume(py::function func, long max)
+{
+    long n = 0;
+
+    while (0==max || n < max)
+    {
+        py::object msg = get(-1);
+
+        if (msg.is_none())
+        {
+            break;
+        }
+
+        py::tuple t = msg.cast<py::tuple>();
+
+        try
+        {
+            func(t[0], t[1]);
+        }
+        catch (...)
+        {
+            nack();
+            throw;
+        }
+
+        ack();
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Return consumer metrics
+ * @return dict
+ */
+py::dict ndrxpy_qconsumer::stats(void)
+{
+    py::dict ret;
+    std::lock_guard<std::mutex> lock(M_mtx);
+    double secs = (now() - M_t_start) / 1000000.0;
+
+    ret["dequeued"] = M_dequeued;
+    ret["delivered"] = M_delivered;
+    ret["acked"] = M_acked;
+    ret["commits"] = M_commits;
+    ret["aborts"] = M_aborts;
+    ret["buffered"] = M_buf.size();
+    ret["buffered_bytes"] = M_buf_bytes;
+    ret["rate"] = secs > 0 ? M_delivered / secs : 0.0;
+    ret["lag_avg_us"] = M_delivered > 0 ? M_lag_sum / M_delivered : 0;
+    ret["lag_max_us"] = M_lag_max;
+
+    return ret;
+}
+
+/**
+ * @brief Stop consumer thread. Unacknowledged transactional messages
+ *  are rolled back.
+ */
+void ndrxpy_qconsumer::close(void)
+{
+    py::gil_scoped_release release;
+
+    {
+        std::lock_guard<std::mutex> lock(M_mtx);
+        M_stop = true;
+        M_cv_space.notify_all();
+    }
+
+    if (M_thread.joinable())
+    {
+        M_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(M_mtx);
+    drop_buffered();
+}
+
+/**
+ * @brief Register queue consumer class
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_qconsumer(py::module &m)
+{
+    py::class_<ndrxpy_qconsumer>(m, "QueueConsumer", R"pbdoc(
+        Native persistent queue consumer.
+
+        In transactional mode (*tran* > 0) consumer thread (with its own ATMI
+        context) dequeues messages ahead into bounded buffer, so that dequeue
+        latency overlaps with processing in Python. When buffer is full
+        (*prefetch* messages or *prefetch_bytes*), dequeue pauses.
+        Messages are dequeued in batches of up to *prefetch* messages under
+        single **tpbegin(3)**. Batch is committed when all its messages are
+        acknowledged by :meth:`ack`, or rolled back by :meth:`nack` (messages
+        will be delivered again). Batch is also ended when queue becomes empty.
+        Acknowledgement shall happen within the transaction timeout.
+
+        Non transactional dequeue removes the message from the queue, thus
+        such consumer does not read ahead (*prefetch* settings do not apply),
+        messages are dequeued by the calling thread on demand, so that closed
+        consumer does not lose any messages.
+
+        Iteration stops when the queue is empty.
+
+        .. code-block:: python
+            :caption: QueueConsumer example
+            :name: QueueConsumer-example
+
+                qc = e.QueueConsumer("SAMPLESPACE", "TESTQ", prefetch=100, tran=60)
+
+                # callback mode, acks after each message
+                qc.consume(lambda qctl, data: print(data["data"]), max=1000)
+
+                # iterator mode, previous message is acked by next()
+                for qctl, data in qc:
+                    print(data["data"])
+
+                qc.close()
+
+        Parameters
+        ----------
+        qspace : str
+            Queue space name.
+        qname : str
+            Queue name.
+        ctl : TPQCTL
+            Control structure used for every dequeue, may be **None**.
+        prefetch : int
+            Max messages buffered and batch size (transactional mode).
+        prefetch_bytes : int
+            Max bytes buffered (transactional mode).
+        tran : int
+            Transaction timeout in seconds. **0** - not transactional, messages
+            are removed from queue at dequeue.
+        flags : int
+            :func:`.tpdequeue` flags.
+        idle : float
+            Seconds to wait before next dequeue, if queue is empty.
+        )pbdoc")
+        .def(py::init([](const std::string &qspace, const std::string &qname,
+                NDRXPY_TPQCTL *ctl, long prefetch, long prefetch_bytes,
+                unsigned long tran, long flags, double idle)
+            {
+                return std::unique_ptr<ndrxpy_qconsumer>(new ndrxpy_qconsumer(qspace,
+                    qname, ctl, prefetch, prefetch_bytes, tran, flags, idle));
+            }),
+            py::arg("qspace"), py::arg("qname"), py::arg("ctl")=nullptr,
+            py::arg("prefetch")=100, py::arg("prefetch_bytes")=1048576,
+            py::arg("tran")=0, py::arg("flags")=0, py::arg("idle")=0.1)
+        .def("get", &ndrxpy_qconsumer::get, R"pbdoc(
+            Take next message.
+
+            :raise AtmiException: 
+                | Dequeue error of consumer thread, see :func:`.tpdequeue`.
+                | Consumer is stopped after the error.
+
+            :raise QmException: 
+                | Dequeue error of consumer thread, see :func:`.tpdequeue`.
+
+            Parameters
+            ----------
+            timeout : float
+                Seconds to wait for message, negative value - wait until
+                message arrives or consumer is closed.
+
+            Returns
+            -------
+            tuple
+                (:class:`.TPQCTL`, dict) or **None** on timeout or if consumer is closed.
+            )pbdoc", py::arg("timeout")=-1.0)
+        .def("ack", &ndrxpy_qconsumer::ack, R"pbdoc(
+            Acknowledge all messages taken so far. No-op in non transactional mode.
+            )pbdoc")
+        .def("nack", &ndrxpy_qconsumer::nack, R"pbdoc(
+            Roll back current batch. Buffered messages of the batch are discarded
+            and will be delivered again. No-op in non transactional mode.
+            )pbdoc")
+        .def("consume", &ndrxpy_qconsumer::consume, R"pbdoc(
+            Pass messages to *func* until consumer is closed or *max* messages
+            are processed. Message is acknowledged after *func* returns. If *func*
+            raises exception, current batch is rolled back and exception is re-raised.
+
+            Parameters
+            ----------
+            func : callable
+                Callback with signature "(qctl, data)".
+            max : int
+                Max messages to process, **0** - unlimited.
+
+            Returns
+            -------
+            int
+                Number of messages processed.
+            )pbdoc", py::arg("func"), py::arg("max")=0)
+        .def("stats", &ndrxpy_qconsumer::stats, R"pbdoc(
+            Return consumer metrics.
+
+            Returns
+            -------
+            dict
+                **dequeued**, **delivered**, **acked** - message counters,
+                **commits**, **aborts** - transactional batches,
+                **buffered**, **buffered_bytes** - current buffer usage,
+                **rate** - delivered messages per second since start,
+                **lag_avg_us**, **lag_max_us** - time from dequeue to delivery
+                to Python, microseconds.
+            )pbdoc")
+        .def("close", &ndrxpy_qconsumer::close, R"pbdoc(
+            Stop consumer thread. Unacknowledged messages of transactional batch
+            are rolled back.
+            )pbdoc")
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__", &ndrxpy_qconsumer::next);
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
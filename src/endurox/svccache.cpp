@@ -0,0 +1,592 @@
+/**
+ * @brief Enduro/X Python module - server side service response cache
+ *
+ * @file svccache.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Cached service reply
+ */
+struct ndrxpy_svccache_ent_t
+{
+    long rcode;                 /**< User return code                       */
+    std::string type;           /**< Reply buffer type, empty for NULL buf  */
+    std::string subtype;        /**< Reply buffer sub-type                  */
+    std::vector<char> data;     /**< Reply buffer bytes                     */
+    std::chrono::steady_clock::time_point expires; /**< Expiry time         */
+    std::list<std::string>::iterator lru; /**< Position in LRU list         */
+};
+
+/**
+ * Per service cache
+ */
+struct ndrxpy_svccache_t
+{
+    std::mutex mtx;             /**< Cache lock, dispatcher runs w/o GIL    */
+    size_t maxsize;             /**< Max number of entries                  */
+    long ttl;                   /**< Time to live, msec, <=0 forever        */
+    std::vector<BFLDID> fields; /**< Key fields, empty -> whole buffer      */
+    std::unordered_map<std::string, ndrxpy_svccache_ent_t> entries;
+    std::list<std::string> lru; /**< Most recently used at front            */
+
+    long hits = 0;              /**< Number of cache hits                   */
+    long misses = 0;            /**< Number of cache misses                 */
+    long evictions = 0;         /**< Entries removed by size limit          */
+    long expired = 0;           /**< Entries removed by TTL                 */
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+/** Caches by service name, configured at tpsvrinit() */
+static std::map<std::string, std::unique_ptr<ndrxpy_svccache_t>> M_svccache;
+
+/** Cache of the request in progress, reply to be stored by tpreturn */
+static __thread ndrxpy_svccache_t *M_pending = nullptr;
+
+/** Key of the request in progress */
+static thread_local std::string M_pending_key;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Build cache key from the buffer
+ * @param c service cache
+ * @param buf XATMI buffer (may be NULL)
+ * @param len buffer length
+ * @param key output key
+ * @return EXTRUE if key built, EXFALSE if buffer not cacheable
+ */
+exprivate int ndrxpy_svccache_key(ndrxpy_svccache_t *c, char *buf, long len, std::string &key)
+{
+    char type[XATMI_TYPE_LEN+1]="";
+    char subtype[XATMI_SUBTYPE_LEN+1]="";
+
+    key.clear();
+
+    if (nullptr==buf)
+    {
+        key="NULL";
+        return EXTRUE;
+    }
+
+    if (EXFAIL==tptypes(buf, type, subtype))
+    {
+        return EXFALSE;
+    }
+
+    key.append(type);
+    key.push_back(0);
+    key.append(subtype);
+    key.push_back(0);
+
+    if (0==strcmp(type, "UBF"))
+    {
+        UBFH *p_ub = reinterpret_cast<UBFH *>(buf);
+        BFLDID fldid;
+        BFLDOCC occ;
+        BFLDLEN flen;
+        char *d_ptr;
+
+        if (c->fields.empty())
+        {
+            Bnext_state_t state;
+            fldid = BFIRSTFLDID;
+
+            while (1==Bnext2(&state, p_ub, &fldid, &occ, NULL, &flen, &d_ptr))
+            {
+                key.append(reinterpret_cast<char *>(&fldid), sizeof(fldid));
+                key.append(reinterpret_cast<char *>(&flen), sizeof(flen));
+                key.append(d_ptr, flen);
+            }
+        }
+        else
+        {
+            for (auto fld: c->fields)
+            {
+                for (occ=0; nullptr!=(d_ptr=Bfind(p_ub, fld, occ, &flen)); occ++)
+                {
+                    key.append(reinterpret_cast<char *>(&fld), sizeof(fld));
+                    key.append(reinterpret_cast<char *>(&flen), sizeof(flen));
+                    key.append(d_ptr, flen);
+                }
+            }
+        }
+    }
+    else if (0==strcmp(type, "STRING") || 0==strcmp(type, "JSON"))
+    {
+        key.append(buf);
+    }
+    else
+    {
+        key.append(buf, len);
+    }
+
+    return EXTRUE;
+}
+
+/**
+ * @brief Reply from the cache, if service is cached. Runs with out GIL.
+ *  On miss request key is saved for the ndrxpy_svccache_store().
+ * @param svcinfo service call
+ * @return EXTRUE if tpreturn() was performed, EXFALSE if shall be processed
+ */
+expublic int ndrxpy_svccache_lookup(TPSVCINFO *svcinfo)
+{
+    char *obuf = nullptr;
+    long olen = 0;
+    long rcode;
+
+    M_pending = nullptr;
+
+    auto it = M_svccache.find(svcinfo->name);
+
+    if (M_svccache.end()==it)
+    {
+        return EXFALSE;
+    }
+
+    ndrxpy_svccache_t *c = it->second.get();
+
+    if (!ndrxpy_svccache_key(c, svcinfo->data, svcinfo->len, M_pending_key))
+    {
+        return EXFALSE;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(c->mtx);
+        auto eit = c->entries.find(M_pending_key);
+
+        if (c->entries.end()!=eit && c->ttl > 0 &&
+            std::chrono::steady_clock::now() >= eit->second.expires)
+        {
+            c->lru.erase(eit->second.lru);
+            c->entries.erase(eit);
+            c->expired++;
+            eit = c->entries.end();
+        }
+
+        if (c->entries.end()==eit)
+        {
+            c->misses++;
+            M_pending = c;
+            return EXFALSE;
+        }
+
+        ndrxpy_svccache_ent_t &ent = eit->second;
+        c->hits++;
+        c->lru.splice(c->lru.begin(), c->lru, ent.lru);
+        rcode = ent.rcode;
+
+        if (!ent.type.empty())
+        {
+            olen = ent.data.size();
+
+            if (nullptr==(obuf = tpalloc(const_cast<char *>(ent.type.c_str()),
+                ent.subtype.empty()?nullptr:const_cast<char *>(ent.subtype.c_str()), olen)))
+            {
+                NDRX_LOG(log_error, "Failed to alloc cached reply: %s",
+                    tpstrerror(tperrno));
+                M_pending = c;
+                return EXFALSE;
+            }
+
+            if (ent.type=="UBF")
+            {
+                if (EXSUCCEED!=Bcpy(reinterpret_cast<UBFH *>(obuf),
+                    reinterpret_cast<UBFH *>(ent.data.data())))
+                {
+                    NDRX_LOG(log_error, "Failed to copy cached reply: %s",
+                        Bstrerror(Berror));
+                    tpfree(obuf);
+                    M_pending = c;
+                    return EXFALSE;
+                }
+            }
+            else
+            {
+                memcpy(obuf, ent.data.data(), olen);
+            }
+        }
+    }
+
+    NDRX_LOG(log_debug, "Service [%s] served from cache", svcinfo->name);
+    tpreturn(TPSUCCESS, rcode, obuf, olen, 0);
+
+    return EXTRUE;
+}
+
+/**
+ * @brief Store the reply of pending request to the cache.
+ *  Only successful replies are cached.
+ * @param rval tpreturn() rval
+ * @param rcode user return code
+ * @param buf reply buffer
+ * @param len reply buffer len
+ */
+expublic void ndrxpy_svccache_store(int rval, long rcode, char *buf, long len)
+{
+    char type[XATMI_TYPE_LEN+1]="";
+    char subtype[XATMI_SUBTYPE_LEN+1]="";
+    ndrxpy_svccache_t *c = M_pending;
+    ndrxpy_svccache_ent_t ent;
+    long size;
+
+    M_pending = nullptr;
+
+    if (nullptr==c || TPSUCCESS!=rval)
+    {
+        return;
+    }
+
+    ent.rcode = rcode;
+
+    if (nullptr!=buf)
+    {
+        if (EXFAIL==(size=tptypes(buf, type, subtype)))
+        {
+            return;
+        }
+
+        if (0==strcmp(type, "UBF"))
+        {
+            size = Bused(reinterpret_cast<UBFH *>(buf));
+        }
+        else if (0==strcmp(type, "STRING") || 0==strcmp(type, "JSON"))
+        {
+            size = strlen(buf)+1;
+        }
+        else if (len > 0 && len < size)
+        {
+            size = len;
+        }
+
+        ent.type = type;
+        ent.subtype = subtype;
+        ent.data.assign(buf, buf+size);
+    }
+
+    std::lock_guard<std::mutex> lock(c->mtx);
+
+    auto eit = c->entries.find(M_pending_key);
+
+    if (c->entries.end()!=eit)
+    {
+        c->lru.erase(eit->second.lru);
+        c->entries.erase(eit);
+    }
+
+    while (c->entries.size() >= c->maxsize && !c->lru.empty())
+    {
+        c->entries.erase(c->lru.back());
+        c->lru.pop_back();
+        c->evictions++;
+    }
+
+    c->lru.push_front(M_pending_key);
+    ent.lru = c->lru.begin();
+    ent.expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(c->ttl);
+    c->entries[M_pending_key] = std::move(ent);
+}
+
+/**
+ * @brief Forget the pending request (reply not stored)
+ */
+expublic void ndrxpy_svccache_reset(void)
+{
+    M_pending = nullptr;
+}
+
+/**
+ * @brief Take over the pending request, for replying later (batched
+ *  services). Pending request is reset.
+ * @param key output key of the pending request
+ * @return cache of the pending request or NULL if reply not to be stored
+ */
+expublic ndrxpy_svccache_t *ndrxpy_svccache_detach(std::string &key)
+{
+    ndrxpy_svccache_t *c = M_pending;
+
+    M_pending = nullptr;
+
+    if (nullptr!=c)
+    {
+        key = M_pending_key;
+    }
+
+    return c;
+}
+
+/**
+ * @brief Restore pending request detached by ndrxpy_svccache_detach(),
+ *  so that the following tpreturn stores the reply under its key.
+ * @param c cache of the request (may be NULL)
+ * @param key request key
+ */
+expublic void ndrxpy_svccache_attach(ndrxpy_svccache_t *c, const std::string &key)
+{
+    M_pending = c;
+
+    if (nullptr!=c)
+    {
+        M_pending_key = key;
+    }
+}
+
+/**
+ * @brief Remove all caches (server shutdown)
+ */
+expublic void ndrxpy_svccache_clear(void)
+{
+    M_svccache.clear();
+}
+
+/**
+ * @brief Enable cache for the service
+ * @param svcname service name
+ * @param maxsize max number of entries
+ * @param ttl time to live in seconds
+ * @param fields key fields
+ */
+exprivate void ndrxpy_svccache_add(const std::string &svcname, size_t maxsize,
+    double ttl, std::vector<std::string> fields)
+{
+    if (0==maxsize)
+    {
+        throw std::invalid_argument("maxsize must be greater than 0");
+    }
+
+    std::unique_ptr<ndrxpy_svccache_t> c(new ndrxpy_svccache_t());
+    c->maxsize = maxsize;
+    c->ttl = static_cast<long>(ttl*1000);
+
+    for (auto &f: fields)
+    {
+        BFLDID fldid = Bfldid(const_cast<char *>(f.c_str()));
+
+        if (BBADFLDID==fldid)
+        {
+            throw ubf_exception(Berror);
+        }
+        c->fields.push_back(fldid);
+    }
+
+    M_svccache[svcname] = std::move(c);
+}
+
+/**
+ * @brief Drop cache entries
+ * @param svcname service name, None for all services
+ * @param data request buffer of which entry to drop, None for all entries
+ */
+exprivate void ndrxpy_svccache_invalidate(py::object svcname, py::object data)
+{
+    for (auto &it: M_svccache)
+    {
+        if (!svcname.is_none() && it.first!=svcname.cast<std::string>())
+        {
+            continue;
+        }
+
+        ndrxpy_svccache_t *c = it.second.get();
+
+        if (data.is_none())
+        {
+            std::lock_guard<std::mutex> lock(c->mtx);
+            c->entries.clear();
+            c->lru.clear();
+        }
+        else
+        {
+            std::string key;
+            auto &&buf = ndrx_from_py(data, false);
+
+            if (ndrxpy_svccache_key(c, *buf.pp, buf.len, key))
+            {
+                std::lock_guard<std::mutex> lock(c->mtx);
+                auto eit = c->entries.find(key);
+
+                if (c->entries.end()!=eit)
+                {
+                    c->lru.erase(eit->second.lru);
+                    c->entries.erase(eit);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Return cache statistics
+ * @param svcname service name
+ * @return dict with statistics
+ */
+exprivate py::dict ndrxpy_svccache_stats(const std::string &svcname)
+{
+    py::dict ret;
+    auto it = M_svccache.find(svcname);
+
+    if (M_svccache.end()==it)
+    {
+        throw std::invalid_argument("Service ["+svcname+"] is not cached");
+    }
+
+    ndrxpy_svccache_t *c = it->second.get();
+    std::lock_guard<std::mutex> lock(c->mtx);
+
+    ret["hits"] = c->hits;
+    ret["misses"] = c->misses;
+    ret["evictions"] = c->evictions;
+    ret["expired"] = c->expired;
+    ret["size"] = c->entries.size();
+    ret["maxsize"] = c->maxsize;
+
+    return ret;
+}
+
+/**
+ * @brief Register service cache functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_svccache(py::module &m)
+{
+    m.def("ndrxpy_svccache_add", &ndrxpy_svccache_add,
+        R"pbdoc(
+        Enable response cache for the advertised service. Cache is checked
+        by the service dispatcher before acquiring the GIL, thus cache hits
+        are replied with out entering the Python. Successful replies
+        (:data:`.TPSUCCESS`) returned by :func:`.tpreturn` are stored in the
+        cache.
+
+        Cache key is built from the request buffer type and either from the
+        all *fields* occurrences (for **UBF** buffers) or from the whole request
+        buffer data.
+
+        Function is not thread safe, shall be called from the
+        :py:meth:`Server.tpsvrinit()`.
+
+        This function applies to ATMI servers only.
+
+        .. code-block:: python
+            :caption: ndrxpy_svccache_add example
+            :name: ndrxpy_svccache_add-example
+
+                def tpsvrinit(self, args):
+                    e.tpadvertise('GETRATE', 'GETRATE', Server.GETRATE)
+                    e.ndrxpy_svccache_add('GETRATE', 10000, 30, ['T_STRING_FLD'])
+                    return 0
+
+        :raise UbfException:
+            | Following error codes may be present:
+            | :data:`.BBADNAME` - Key field not found.
+
+        Parameters
+        ----------
+        svcname : str
+            Service name.
+        maxsize : int
+            Max number of cached replies. Least recently used replies
+            are evicted first.
+        ttl : float
+            Time to live of the cached reply in seconds. Value **0**
+            means replies do not expire.
+        fields : list
+            List of **UBF** field names used for key. If empty,
+            whole buffer is used.
+        )pbdoc",
+        py::arg("svcname"), py::arg("maxsize")=1024, py::arg("ttl")=60.0,
+        py::arg("fields")=std::vector<std::string>());
+
+    m.def("ndrxpy_svccache_invalidate", &ndrxpy_svccache_invalidate,
+        R"pbdoc(
+        Remove entries from the service response cache.
+
+        This function applies to ATMI servers only.
+
+        Parameters
+        ----------
+        svcname : str
+            Service name. If **None**, all service caches are processed.
+        data : dict
+            Request buffer for which cached reply shall be removed.
+            If **None**, all entries are removed.
+        )pbdoc",
+        py::arg("svcname")=py::none(), py::arg("data")=py::none());
+
+    m.def("ndrxpy_svccache_stats", &ndrxpy_svccache_stats,
+        R"pbdoc(
+        Return service response cache statistics.
+
+        This function applies to ATMI servers only.
+
+        Parameters
+        ----------
+        svcname : str
+            Service name.
+
+        Returns
+        -------
+        dict
+            Dictionary with keys: **hits**, **misses**, **evictions**, **expired**,
+            **size** (current number of entries) and **maxsize**.
+        )pbdoc",
+        py::arg("svcname"));
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
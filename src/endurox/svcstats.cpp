@@ -0,0 +1,369 @@
+/**
+ * @brief Enduro/X Python module - server dispatch instrumentation
+ *
+ * @file svcstats.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <time.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+
+#define NDRXPY_SVCSTATS_BUCKETS     32  /**< Log2 buckets, usec         */
+
+/*---------------------------Enums--------------------------------------*/
+
+/**
+ * Measured dispatch phases
+ */
+enum
+{
+    NDRXPY_PHASE_GIL = 0,   /**< Wait for GIL                           */
+    NDRXPY_PHASE_IN,        /**< Request conversion to Python           */
+    NDRXPY_PHASE_HANDLER,   /**< Python service handler                 */
+    NDRXPY_PHASE_OUT,       /**< Reply conversion from Python           */
+    NDRXPY_PHASE_REPLY,     /**< tpreturn() / tpforward()               */
+    NDRXPY_PHASE_MAX
+};
+
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Histogram of single phase
+ */
+struct ndrxpy_svchist_t
+{
+    long count = 0;                 /**< Number of samples              */
+    unsigned long long sum = 0;     /**< Total usec                     */
+    unsigned long long max = 0;     /**< Max usec                       */
+    long hist[NDRXPY_SVCSTATS_BUCKETS] = {0}; /**< bucket i: < 2^i usec */
+};
+
+/**
+ * Service statistics
+ */
+struct ndrxpy_svcstats_t
+{
+    ndrxpy_svchist_t phase[NDRXPY_PHASE_MAX];
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+static const char *M_phase_names[NDRXPY_PHASE_MAX] =
+    {"gil", "in", "handler", "out", "reply"};
+
+/** Is instrumentation enabled */
+static volatile int M_enabled = EXFALSE;
+
+/** Periodic dump to tplog, seconds, 0 - off */
+static int M_dumpsec = 0;
+
+/** Last dump time, usec */
+static unsigned long long M_lastdump = 0;
+
+/** Statistics by service name */
+static std::map<std::string, ndrxpy_svcstats_t> M_svcstats;
+
+/** Lock for stats */
+static std::mutex M_svcstats_mtx;
+
+/** Reply conversion time of current service call, usec */
+static __thread unsigned long long M_out_us = 0;
+
+/** Reply time of current service call, usec */
+static __thread unsigned long long M_reply_us = 0;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Is instrumentation enabled
+ * @return EXTRUE/EXFALSE
+ */
+expublic int ndrxpy_svcstats_on(void)
+{
+    return M_enabled;
+}
+
+/**
+ * @brief Monotonic time stamp
+ * @return usec
+ */
+expublic unsigned long long ndrxpy_svcstats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<unsigned long long>(ts.tv_sec)*1000000 + ts.tv_nsec/1000;
+}
+
+/**
+ * @brief Record reply timings, called by tpreturn() / tpforward()
+ * @param out_us reply conversion time
+ * @param reply_us reply call time
+ */
+expublic void ndrxpy_svcstats_reply(unsigned long long out_us, unsigned long long reply_us)
+{
+    M_out_us = out_us;
+    M_reply_us = reply_us;
+}
+
+/**
+ * @brief Add sample to histogram
+ * @param h histogram
+ * @param us value in usec
+ */
+exprivate void ndrxpy_svchist_add(ndrxpy_svchist_t &h, unsigned long long us)
+{
+    int b = 0;
+    unsigned long long v = us;
+
+    while (v > 0 && b < NDRXPY_SVCSTATS_BUCKETS-1)
+    {
+        v>>=1;
+        b++;
+    }
+
+    h.count++;
+    h.sum+=us;
+    h.hist[b]++;
+
+    if (us > h.max)
+    {
+        h.max = us;
+    }
+}
+
+/**
+ * @brief Approximate percentile from the histogram
+ * @param h histogram
+ * @param pct percentile 0..100
+ * @return bucket upper bound, usec
+ */
+exprivate unsigned long long ndrxpy_svchist_pct(ndrxpy_svchist_t &h, int pct)
+{
+    long need = (h.count * pct + 99) / 100;
+    long seen = 0;
+    int b;
+
+    for (b=0; b<NDRXPY_SVCSTATS_BUCKETS; b++)
+    {
+        seen+=h.hist[b];
+
+        if (seen >= need)
+        {
+            break;
+        }
+    }
+
+    return 1ULL << b;
+}
+
+/**
+ * @brief Dump statistics to tplog. Lock must be held.
+ */
+exprivate void ndrxpy_svcstats_dump(void)
+{
+    for (auto &it: M_svcstats)
+    {
+        for (int i=0; i<NDRXPY_PHASE_MAX; i++)
+        {
+            ndrxpy_svchist_t &h = it.second.phase[i];
+
+            if (h.count > 0)
+            {
+                TP_LOG(log_info, "svcstats [%s] %-7s cnt=%ld avg=%lluus "
+                    "p50<%lluus p99<%lluus max=%lluus",
+                    it.first.c_str(), M_phase_names[i], h.count, h.sum/h.count,
+                    ndrxpy_svchist_pct(h, 50), ndrxpy_svchist_pct(h, 99), h.max);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Aggregate service call timings. Handler time excludes
+ *  the reply conversion and reply time.
+ * @param svc service name
+ * @param t0 dispatch start
+ * @param t1 GIL acquired
+ * @param t2 request converted
+ * @param t3 handler returned
+ */
+expublic void ndrxpy_svcstats_add(const char *svc, unsigned long long t0,
+    unsigned long long t1, unsigned long long t2, unsigned long long t3)
+{
+    unsigned long long handler = t3-t2;
+    unsigned long long rpl = M_out_us + M_reply_us;
+
+    handler = handler > rpl ? handler - rpl : 0;
+
+    std::lock_guard<std::mutex> lock(M_svcstats_mtx);
+    ndrxpy_svcstats_t &st = M_svcstats[svc];
+
+    ndrxpy_svchist_add(st.phase[NDRXPY_PHASE_GIL], t1-t0);
+    ndrxpy_svchist_add(st.phase[NDRXPY_PHASE_IN], t2-t1);
+    ndrxpy_svchist_add(st.phase[NDRXPY_PHASE_HANDLER], handler);
+    ndrxpy_svchist_add(st.phase[NDRXPY_PHASE_OUT], M_out_us);
+    ndrxpy_svchist_add(st.phase[NDRXPY_PHASE_REPLY], M_reply_us);
+
+    M_out_us = 0;
+    M_reply_us = 0;
+
+    if (M_dumpsec > 0 && t3 - M_lastdump >= static_cast<unsigned long long>(M_dumpsec)*1000000)
+    {
+        M_lastdump = t3;
+        ndrxpy_svcstats_dump();
+    }
+}
+
+/**
+ * @brief Register dispatch instrumentation functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_svcstats(py::module &m)
+{
+    m.def(
+        "ndrxpy_svcstats_enable", [](bool enable, int dumpsec)
+        {
+            std::lock_guard<std::mutex> lock(M_svcstats_mtx);
+            M_dumpsec = dumpsec;
+            M_lastdump = ndrxpy_svcstats_now();
+            M_enabled = enable;
+        },
+        R"pbdoc(
+        Enable or disable service dispatch instrumentation. When enabled, for
+        every Python service call following phases are measured and aggregated
+        to per service histograms (in microseconds):
+
+        - **gil** - time waited to acquire the GIL.
+        - **in** - request buffer conversion to Python objects.
+        - **handler** - Python service function execution (excluding **out** and **reply**).
+        - **out** - reply buffer conversion from Python objects by :func:`.tpreturn`
+          or :func:`.tpforward`.
+        - **reply** - **tpreturn(3)** or **tpforward(3)** call.
+
+        Requests served by native routes or by the service cache are not measured.
+
+        This function applies to ATMI servers only.
+
+        Parameters
+        ----------
+        enable : bool
+            Enable (**True**) or disable (**False**) measurements.
+        dumpsec : int
+            If greater than **0**, statistics are periodically written to the
+            **tp** logger at info level, in given interval of seconds. Dump is
+            performed by service dispatch, thus idle server does not dump.
+        )pbdoc",
+        py::arg("enable")=true, py::arg("dumpsec")=0);
+
+    m.def(
+        "ndrxpy_svcstats_get", [](void)
+        {
+            py::dict ret;
+            std::lock_guard<std::mutex> lock(M_svcstats_mtx);
+
+            for (auto &it: M_svcstats)
+            {
+                py::dict svc;
+
+                for (int i=0; i<NDRXPY_PHASE_MAX; i++)
+                {
+                    ndrxpy_svchist_t &h = it.second.phase[i];
+                    py::dict ph;
+                    py::list hist;
+
+                    for (int b=0; b<NDRXPY_SVCSTATS_BUCKETS; b++)
+                    {
+                        hist.append(h.hist[b]);
+                    }
+
+                    ph["count"] = h.count;
+                    ph["sum"] = h.sum;
+                    ph["max"] = h.max;
+                    ph["hist"] = hist;
+                    svc[M_phase_names[i]] = ph;
+                }
+
+                ret[it.first.c_str()] = svc;
+            }
+
+            return ret;
+        },
+        R"pbdoc(
+        Return service dispatch statistics collected since enable or last reset.
+
+        This function applies to ATMI servers only.
+
+        Returns
+        -------
+        dict
+            Key is service name, value is dict where keys are phase names
+            (**gil**, **in**, **handler**, **out**, **reply**) and values are
+            dicts with keys: **count** - number of samples, **sum** - total
+            microseconds, **max** - max microseconds, **hist** - list of 32
+            buckets where bucket *i* counts samples less than 2^i microseconds
+            (and not less than 2^(i-1)).
+        )pbdoc");
+
+    m.def(
+        "ndrxpy_svcstats_reset", [](void)
+        {
+            std::lock_guard<std::mutex> lock(M_svcstats_mtx);
+            M_svcstats.clear();
+        },
+        R"pbdoc(
+        Reset service dispatch statistics.
+
+        This function applies to ATMI servers only.
+        )pbdoc");
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
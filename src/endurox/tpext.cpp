@@ -51,6 +51,7 @@
 #include <functional>
 #include <map>
 #include <mutex>
+#include <vector>
 
 #ifdef EX_OS_AIX
 #undef __MULTILOCALE_API
@@ -61,21 +62,61 @@
 /*---------------------------Macros-------------------------------------*/
 /*---------------------------Enums--------------------------------------*/
 /*---------------------------Typedefs-----------------------------------*/
+
+/**
+ * Native poller fd, waiting for the server init to complete
+ */
+struct ndrxpy_pollerfd_t
+{
+    int fd;                 /**< file descriptor                        */
+    uint32_t events;        /**< poll events                            */
+    void *ptr1;             /**< callback argument                      */
+    int (*cb)(int fd, uint32_t events, void *ptr1); /**< callback       */
+};
+
+/**
+ * Python poller fd callback
+ */
+struct ndrxpy_fdcb_t
+{
+    py::object func;        /**< callback                               */
+    py::object ptr1;        /**< object to pass back                    */
+    bool batch;             /**< receives list of events                */
+};
+
+/**
+ * Event received in current poll iteration
+ */
+struct ndrxpy_fdevent_t
+{
+    int fd;                 /**< file descriptor                        */
+    uint32_t events;        /**< poll events                            */
+};
+
 /*---------------------------Globals------------------------------------*/
 /*---------------------------Statics------------------------------------*/
 
+namespace py = pybind11;
+
 /** current handle for b4poll callback */
 static ndrxpy_object_t * M_b4pollcb_handler = nullptr;
 
 /** periodic server callback handler */
 static ndrxpy_object_t * M_addperiodcb_handler = nullptr;
 
-/** filedescriptor map to py callbacks */
-static std::map<int, ndrxpy_object_t*> M_fdmap;
+/** py callbacks indexed by file descriptor */
+static std::vector<ndrxpy_fdcb_t*> M_fdtab;
 
-/*---------------------------Prototypes---------------------------------*/
+/** number of fds in M_fdtab */
+static int M_fdcnt = 0;
 
-namespace py = pybind11;
+/** events of current poll iteration, delivered before next poll */
+static std::vector<ndrxpy_fdevent_t> M_fdevents;
+
+/** native pollers added at tpsvrinit(), registered before the first poll */
+static std::vector<ndrxpy_pollerfd_t> M_pollerfd_pending;
+
+/*---------------------------Prototypes---------------------------------*/
 
 /**
  * @brief Avoid C++ destructors for Python objects.
@@ -84,18 +125,133 @@ namespace py = pybind11;
  */
 expublic void ndrxpy_fdmap_clear(void)
 {
-    if (!M_fdmap.empty())
+    for (auto &cb : M_fdtab)
+    {
+        if (nullptr!=cb)
+        {
+            cb->ptr1 = py::none();
+            delete cb;
+            cb = nullptr;
+        }
+    }
+
+    M_fdtab.clear();
+    M_fdevents.clear();
+    M_fdcnt = 0;
+}
+
+/**
+ * @brief Deliver events collected in the poll iteration in single GIL
+ *  acquisition. Batch callbacks are called once with all their events.
+ * @return EXSUCCEED, or EXFAIL if any callback failed
+ */
+exprivate int ndrxpy_fdevents_deliver(void)
+{
+    int ret = EXSUCCEED;
+    std::vector<std::pair<py::object, py::list>> batches;
+
+    if (M_fdevents.empty())
+    {
+        return EXSUCCEED;
+    }
+
+    py::gil_scoped_acquire acquire;
+
+    for (auto &ev : M_fdevents)
+    {
+        //fd may be removed by previous callback
+        if (ev.fd >= static_cast<int>(M_fdtab.size()) || nullptr==M_fdtab[ev.fd])
+        {
+            continue;
+        }
+
+        ndrxpy_fdcb_t *cb = M_fdtab[ev.fd];
+
+        if (cb->batch)
+        {
+            bool found = false;
+
+            for (auto &b : batches)
+            {
+                if (b.first.is(cb->func))
+                {
+                    b.second.append(py::make_tuple(ev.fd, ev.events, cb->ptr1));
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                py::list l;
+                l.append(py::make_tuple(ev.fd, ev.events, cb->ptr1));
+                batches.push_back(std::make_pair(cb->func, l));
+            }
+
+            continue;
+        }
+
+        try
+        {
+            //keep references, callback may remove the fd
+            py::object func = cb->func;
+            py::object ptr1 = cb->ptr1;
+            py::object r = func(ev.fd, ev.events, ptr1);
+
+            if (EXSUCCEED!=r.cast<int>())
+            {
+                ret=EXFAIL;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            NDRX_LOG(log_error, "Got exception at pollevent_cb: %s", e.what());
+            userlog(const_cast<char *>("%s"), e.what());
+            ret=EXFAIL;
+        }
+    }
+
+    M_fdevents.clear();
+
+    for (auto &b : batches)
+    {
+        try
+        {
+            py::object r = b.first(b.second);
+
+            if (EXSUCCEED!=r.cast<int>())
+            {
+                ret=EXFAIL;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            NDRX_LOG(log_error, "Got exception at pollevent_cb: %s", e.what());
+            userlog(const_cast<char *>("%s"), e.what());
+            ret=EXFAIL;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Register native pollers deferred from the server init
+ */
+exprivate void ndrxpy_pollerfd_flush(void)
+{
+    for (auto &p: M_pollerfd_pending)
     {
-        for (auto const & map : M_fdmap)
+        if (EXSUCCEED!=tpext_addpollerfd(p.fd, p.events, p.ptr1, p.cb))
         {
-            //Cannot delete functions?
-            //map.second->obj = py::none();
-            map.second->obj2 = py::none();
-            //Avoid leak?
-	    delete map.second;
+            NDRX_LOG(log_error, "Failed to add fd %d to poller: %s",
+                p.fd, tpstrerror(tperrno));
+            userlog(const_cast<char *>("Failed to add fd %d to poller: %s"),
+                p.fd, tpstrerror(tperrno));
         }
     }
-    M_fdmap.clear();
+
+    M_pollerfd_pending.clear();
 }
 
 /**
@@ -105,11 +261,31 @@ exprivate int ndrxpy_b4pollcb_callback(void)
 {
     //Get the gil...
     int cret;
+
+    ndrxpy_pollerfd_flush();
+
+    if (EXSUCCEED!=ndrxpy_fdevents_deliver())
+    {
+        return EXFAIL;
+    }
+
+    if (nullptr==M_b4pollcb_handler)
+    {
+        //Installed for native pollers / fd callbacks only
+        if (0==M_fdcnt)
+        {
+            tpext_delb4pollcb();
+        }
+        return EXSUCCEED;
+    }
+
     try
     {
         py::gil_scoped_acquire acquire;
 
-        py::object ret = M_b4pollcb_handler->obj();
+        //Handler may replace or remove itself during the call
+        py::object func = M_b4pollcb_handler->obj;
+        py::object ret = func();
         cret=ret.cast<int>();
     }
     catch (const std::exception &e)
@@ -193,31 +369,70 @@ exprivate void ndrxpy_tpext_addperiodcb (int secs, const py::object &func)
 }
 
 /**
- * @brief pollevent callback
+ * @brief pollevent callback. Event is queued and delivered to Python
+ *  by the b4poll callback, after all events of the poll iteration are received.
  * 
  * @param fd monitored file descriptor
  * @param events events monitored
  * @param ptr1 not used
- * @return -1 on failure, 0 ok 
+ * @return 0 ok 
  */
 exprivate int ndrxpy_pollevent_cb(int fd, uint32_t events, void *ptr1)
 {
-    int cret;
-    try
+    M_fdevents.push_back({fd, events});
+
+    return EXSUCCEED;
+}
+
+/**
+ * @brief Add native callback to the server poller. If server is not yet
+ *  initialized (called from tpsvrinit()), fd is registered before the first poll.
+ * @param fd file descriptor
+ * @param events poll events
+ * @param ptr1 callback argument
+ * @param cb callback
+ * @return EXSUCCEED/EXFAIL (tperrno set)
+ */
+expublic int ndrxpy_pollerfd_add(int fd, uint32_t events, void *ptr1,
+    int (*cb)(int fd, uint32_t events, void *ptr1))
+{
+    if (EXSUCCEED==tpext_addpollerfd(fd, events, ptr1, cb))
     {
-        py::gil_scoped_acquire acquire;
-        py::object ret=M_fdmap[fd]->obj(fd, events, M_fdmap[fd]->obj2);
-        cret=ret.cast<int>();
+        return EXSUCCEED;
     }
-    catch (const std::exception &e)
+
+    if (TPEPROTO!=tperrno)
     {
-        NDRX_LOG(log_error, "Got exception at pollevent_cb: %s", e.what());
-        userlog(const_cast<char *>("%s"), e.what());
-        cret=EXFAIL;
+        return EXFAIL;
     }
 
+    if (EXSUCCEED!=tpext_addb4pollcb(ndrxpy_b4pollcb_callback))
+    {
+        return EXFAIL;
+    }
 
-    return cret;
+    M_pollerfd_pending.push_back({fd, events, ptr1, cb});
+
+    return EXSUCCEED;
+}
+
+/**
+ * @brief Remove native callback from the server poller
+ * @param fd file descriptor
+ * @return EXSUCCEED/EXFAIL (tperrno set)
+ */
+expublic int ndrxpy_pollerfd_del(int fd)
+{
+    for (auto it = M_pollerfd_pending.begin(); it != M_pollerfd_pending.end(); it++)
+    {
+        if (it->fd == fd)
+        {
+            M_pollerfd_pending.erase(it);
+            return EXSUCCEED;
+        }
+    }
+
+    return tpext_delpollerfd(fd);
 }
 
 /**
@@ -228,19 +443,41 @@ exprivate int ndrxpy_pollevent_cb(int fd, uint32_t events, void *ptr1)
  * @param ptr1 object to pass back
  * @param func callback func
  */
-exprivate void ndrxpy_tpext_addpollerfd (int fd, uint32_t events, const py::object ptr1, const py::object &func)
+exprivate void ndrxpy_tpext_addpollerfd (int fd, uint32_t events, const py::object ptr1,
+    const py::object &func, bool batch)
 {
-    ndrxpy_object_t * obj = new ndrxpy_object_t();
-
-    obj->obj = func;
-    obj->obj2 = ptr1;
-
     if (EXSUCCEED!=tpext_addpollerfd(fd, (uint32_t)events, NULL, ndrxpy_pollevent_cb))
     {
         throw atmi_exception(tperrno);
     }
 
-    M_fdmap[fd] = obj;
+    //Events are delivered by b4poll
+    if (EXSUCCEED!=tpext_addb4pollcb(ndrxpy_b4pollcb_callback))
+    {
+        int err = tperrno;
+        tpext_delpollerfd(fd);
+        throw atmi_exception(err);
+    }
+
+    ndrxpy_fdcb_t * cb = new ndrxpy_fdcb_t();
+
+    cb->func = func;
+    cb->ptr1 = ptr1;
+    cb->batch = batch;
+
+    if (fd >= static_cast<int>(M_fdtab.size()))
+    {
+        M_fdtab.resize(fd+1, nullptr);
+    }
+
+    if (nullptr!=M_fdtab[fd])
+    {
+        delete M_fdtab[fd];
+        M_fdcnt--;
+    }
+
+    M_fdtab[fd] = cb;
+    M_fdcnt++;
 }
 
 /**
@@ -250,10 +487,11 @@ exprivate void ndrxpy_tpext_addpollerfd (int fd, uint32_t events, const py::obje
  */
 exprivate void ndrxpy_tpext_delpollerfd(int fd)
 {
-    auto it = M_fdmap.find(fd);
-    if (it != M_fdmap.end()) {
-        delete M_fdmap[fd];
-        M_fdmap.erase(it);
+    if (fd >= 0 && fd < static_cast<int>(M_fdtab.size()) && nullptr!=M_fdtab[fd])
+    {
+        delete M_fdtab[fd];
+        M_fdtab[fd] = nullptr;
+        M_fdcnt--;
     }
 
     if (EXSUCCEED!=tpext_delpollerfd(fd))
@@ -313,7 +551,8 @@ expublic void ndrxpy_register_tpext(py::module &m)
     m.def(
         "tpext_delb4pollcb", [](void)
         {   
-            if (EXSUCCEED!=tpext_delb4pollcb())
+            //Keep native callback, if pollers still needs it
+            if (M_pollerfd_pending.empty() && 0==M_fdcnt && EXSUCCEED!=tpext_delb4pollcb())
             {
                 throw atmi_exception(tperrno);
             }
@@ -332,6 +571,30 @@ expublic void ndrxpy_register_tpext(py::module &m)
 
          )pbdoc");
 
+    m.def(
+        "tpext_getb4pollcb", [](void)
+        {
+            if (nullptr==M_b4pollcb_handler)
+            {
+                return py::object(py::none());
+            }
+
+            return M_b4pollcb_handler->obj;
+        },
+        R"pbdoc(
+        Return current before server poll callback set by
+        :func:`.tpext_addb4pollcb`. Allows chaining of the handlers,
+        as :func:`.tpext_addb4pollcb` replaces the existing callback.
+
+        This function applies to ATMI servers only.
+
+        Returns
+        -------
+        func : object
+            Callback function or **None** if callback is not set.
+
+         )pbdoc");
+
      m.def(
         "tpext_addperiodcb", [](int secs, const py::object &func)
         { ndrxpy_tpext_addperiodcb(secs, func); },
@@ -398,8 +661,8 @@ expublic void ndrxpy_register_tpext(py::module &m)
         );
 
      m.def(
-        "tpext_addpollerfd", [](int fd, uint32_t events, const py::object ptr1, const py::object &func)
-        { ndrxpy_tpext_addpollerfd(fd, events, ptr1, func); },
+        "tpext_addpollerfd", [](int fd, uint32_t events, const py::object ptr1, const py::object &func, bool batch)
+        { ndrxpy_tpext_addpollerfd(fd, events, ptr1, func, batch); },
         R"pbdoc(
         Monitor file descriptor in XATMI server main dispatcher.
         This allows the main thread of the server process to select either a service call
@@ -409,6 +672,12 @@ expublic void ndrxpy_register_tpext(py::module &m)
         tpext_addpollerfd() can be only called when XATMI server has performed the init, i.e.
         outside of the tpsvrinit().
 
+        Events received in single poll iteration are delivered to Python callbacks
+        in single GIL acquisition, before the server goes to next poll (i.e. from
+        internal before poll callback; user callback set by :func:`.tpext_addb4pollcb`
+        is called after them). If *batch* is set, *func* is called once per iteration
+        with list of events of all fds registered with the same batch *func*.
+
         Function is not thread safe. This function applies to ATMI servers only.
 
         .. code-block:: python
@@ -473,9 +742,14 @@ expublic void ndrxpy_register_tpext(py::module &m)
             Function signature must accept signature of "(fd, events, ptr1)".
             Where *fd* is file descriptor, *events* is poll() events occurred on
             *fd*, ptr1 is custom pointer passed when tpext_addpollerfd() was called.
+            Function shall return **0** on success. If **-1** is returned or
+            exception is raised, server process exits with failure.
+        batch : bool
+            If **True**, *func* signature is "(events)", where *events* is list
+            of (*fd*, *events*, *ptr1*) tuples received in the poll iteration.
 
          )pbdoc",
-        py::arg("fd"), py::arg("events"), py::arg("ptr1"), py::arg("func"));
+        py::arg("fd"), py::arg("events"), py::arg("ptr1"), py::arg("func"), py::arg("batch")=false);
 
      m.def(
         "tpext_delpollerfd", [](int fd)
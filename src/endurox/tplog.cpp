@@ -30,6 +30,7 @@
  * -----------------------------------------------------------------------------
  */
 #include <dlfcn.h>
+#include <time.h>
 
 #include <atmi.h>
 #include <tpadm.h>
@@ -46,11 +47,382 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <atomic>
 #include <functional>
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace py = pybind11;
 
+/** Logger configuration generation, bumped on config / request file change */
+static std::atomic<unsigned> M_loggen{1};
+
+/** Cached tp logger level of the thread */
+static __thread int M_lev_cache = EXFAIL;
+
+/** Generation of the cached level */
+static __thread unsigned M_lev_gen = 0;
+
+/** Thread logger is active for the thread */
+static __thread int M_lev_thread = EXFALSE;
+
+/** Cached request logging file of the thread */
+static thread_local std::string M_reqfile;
+
+/**
+ * @brief Invalidate cached log levels of all threads
+ */
+expublic void ndrxpy_tplog_invalidate(void)
+{
+    M_loggen++;
+}
+
+/**
+ * @brief Return current tp logger level of the thread (process, thread
+ *  or request logger). Cached until the logger configuration is changed
+ *  by this module.
+ * @return log level
+ */
+expublic int ndrxpy_tplog_level(void)
+{
+    unsigned gen = M_loggen.load(std::memory_order_relaxed);
+
+    if (M_lev_gen!=gen)
+    {
+        long ret = tplogqinfo(log_dump, TPLOGQI_GET_TP|TPLOGQI_EVAL_RETURN);
+
+        char reqfile[PATH_MAX+1] = "";
+
+        M_lev_cache = EXFAIL==ret ? log_dump : static_cast<int>((ret >> 24) & 0xff);
+        M_lev_thread = EXFAIL!=ret && (ret & LOG_FACILITY_TP_THREAD);
+        tploggetreqfile(reqfile, sizeof(reqfile));
+        M_reqfile = reqfile;
+        M_lev_gen = gen;
+    }
+
+    return M_lev_cache;
+}
+
+/**
+ * @brief Return logging route of the thread, for the background writer
+ * @param [out] reqfile request logging file or empty
+ * @return false if thread logger is used (route cannot be reproduced)
+ */
+expublic bool ndrxpy_tplog_route(std::string &reqfile)
+{
+    ndrxpy_tplog_level();
+
+    if (M_lev_thread && M_reqfile.empty())
+    {
+        return false;
+    }
+
+    reqfile = M_reqfile;
+
+    return true;
+}
+
+/**
+ * @brief Log message if level is enabled. Message is formatted with
+ *  Python % operator only if level is enabled.
+ * @param lev log level
+ * @param message message or format
+ * @param args format arguments
+ */
+exprivate void ndrxpy_tplog_fmt(int lev, py::str message, py::args args)
+{
+    if (lev > ndrxpy_tplog_level())
+    {
+        return;
+    }
+
+    std::string msg;
+
+    if (0==args.size())
+    {
+        msg = message.cast<std::string>();
+    }
+    else if (1==args.size() && py::isinstance<py::dict>(args[0]))
+    {
+        //Mapping key formats, as with logging module
+        msg = py::str(message.attr("__mod__")(args[0])).cast<std::string>();
+    }
+    else
+    {
+        msg = py::str(message.attr("__mod__")(args)).cast<std::string>();
+    }
+
+    py::gil_scoped_release release;
+    ndrxpy_tplog_write(lev, msg);
+}
+
+/**
+ * Parsed %-style log record template segment
+ */
+struct ndrxpy_logseg_t
+{
+    std::string text;   /**< Literal text, or record attribute name     */
+    std::string spec;   /**< % format spec, empty for literal           */
+    bool field;         /**< Is record attribute                        */
+    char conv;          /**< Conversion char                            */
+};
+
+/**
+ * Cached log record template of the handler
+ */
+struct ndrxpy_logfmt_t
+{
+    std::vector<ndrxpy_logseg_t> segs;
+    bool asctime;       /**< Template uses asctime                      */
+};
+
+/**
+ * @brief Parse %-style logging template, e.g. "%(levelname)-8s %(message)s"
+ * @param fmt template
+ * @return parsed template
+ */
+exprivate ndrxpy_logfmt_t *ndrxpy_logfmt_parse(const std::string &fmt)
+{
+    std::unique_ptr<ndrxpy_logfmt_t> ret(new ndrxpy_logfmt_t());
+    std::string lit;
+    size_t i = 0;
+
+    ret->asctime = false;
+
+    while (i < fmt.size())
+    {
+        if ('%'!=fmt[i])
+        {
+            lit+=fmt[i++];
+            continue;
+        }
+
+        if (i+1 < fmt.size() && '%'==fmt[i+1])
+        {
+            lit+='%';
+            i+=2;
+            continue;
+        }
+
+        if (i+1 >= fmt.size() || '('!=fmt[i+1])
+        {
+            throw std::invalid_argument("Invalid log format, expected %(name)<conv>: " + fmt);
+        }
+
+        size_t end = fmt.find(')', i+2);
+
+        if (std::string::npos==end)
+        {
+            throw std::invalid_argument("Invalid log format, missing ')': " + fmt);
+        }
+
+        ndrxpy_logseg_t seg;
+        seg.field = true;
+        seg.text = fmt.substr(i+2, end-i-2);
+        seg.spec = "%";
+
+        i = end+1;
+
+        while (i < fmt.size() && NULL!=strchr("#0- +.0123456789", fmt[i]))
+        {
+            seg.spec+=fmt[i++];
+        }
+
+        if (i >= fmt.size() || NULL==strchr("diouxXeEfFgGcrsa", fmt[i]))
+        {
+            throw std::invalid_argument("Invalid log format, bad conversion: " + fmt);
+        }
+
+        seg.conv = fmt[i];
+        seg.spec+=fmt[i++];
+
+        if ("asctime"==seg.text)
+        {
+            ret->asctime = true;
+        }
+
+        if (!lit.empty())
+        {
+            ret->segs.push_back({lit, "", false, EXEOS});
+            lit.clear();
+        }
+
+        ret->segs.push_back(seg);
+    }
+
+    if (!lit.empty())
+    {
+        ret->segs.push_back({lit, "", false, EXEOS});
+    }
+
+    return ret.release();
+}
+
+/**
+ * @brief Map Python logging level to Enduro/X level
+ * @param levelno logging module level
+ * @return Enduro/X log level
+ */
+exprivate int ndrxpy_logging_lev(int levelno)
+{
+    if (levelno >= 50)
+    {
+        return log_always;
+    }
+    else if (levelno >= 40)
+    {
+        return log_error;
+    }
+    else if (levelno >= 30)
+    {
+        return log_warn;
+    }
+    else if (levelno >= 20)
+    {
+        return log_info;
+    }
+    else if (levelno >= 10)
+    {
+        return log_debug;
+    }
+
+    return log_dump;
+}
+
+/**
+ * @brief Format log record with cached template, as logging.Formatter
+ *  would do by default.
+ * @param f parsed template
+ * @param record log record
+ * @return formatted message
+ */
+exprivate std::string ndrxpy_logfmt_format(ndrxpy_logfmt_t *f, py::object record)
+{
+    std::string out;
+    std::string asctime;
+    py::object message;
+
+    if (f->asctime)
+    {
+        double created = record.attr("created").cast<double>();
+        time_t t = static_cast<time_t>(created);
+        struct tm tm;
+        char buf[64];
+
+        localtime_r(&t, &tm);
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+        asctime = buf;
+        snprintf(buf, sizeof(buf), ",%03d", record.attr("msecs").cast<int>());
+        asctime+=buf;
+    }
+
+    for (auto &seg: f->segs)
+    {
+        if (!seg.field)
+        {
+            out+=seg.text;
+            continue;
+        }
+
+        py::object v;
+
+        if ("message"==seg.text)
+        {
+            if (!message)
+            {
+                message = record.attr("getMessage")();
+            }
+            v = message;
+        }
+        else if ("asctime"==seg.text)
+        {
+            v = py::str(asctime);
+        }
+        else
+        {
+            v = record.attr(seg.text.c_str());
+        }
+
+        if (2==seg.spec.size() && 's'==seg.conv)
+        {
+            out+=py::str(v).cast<std::string>();
+        }
+        else if (2==seg.spec.size() && 'd'==seg.conv && py::isinstance<py::int_>(v))
+        {
+            out+=std::to_string(v.cast<long long>());
+        }
+        else
+        {
+            out+=py::str(py::str(seg.spec).attr("__mod__")(v)).cast<std::string>();
+        }
+    }
+
+    //Traceback, as logging.Formatter.format()
+    if (py::bool_(record.attr("exc_info")))
+    {
+        if (!py::bool_(record.attr("exc_text")))
+        {
+            record.attr("exc_text") = py::module::import("logging").attr("_defaultFormatter")
+                .attr("formatException")(record.attr("exc_info"));
+        }
+    }
+
+    py::object exc_text = record.attr("exc_text");
+
+    if (py::bool_(exc_text))
+    {
+        out+="\n";
+        out+=py::str(exc_text).cast<std::string>();
+    }
+
+    py::object stack_info = py::getattr(record, "stack_info", py::none());
+
+    if (py::bool_(stack_info))
+    {
+        out+="\n";
+        out+=py::str(stack_info).cast<std::string>();
+    }
+
+    return out;
+}
+
+/**
+ * @brief Native logging.Handler.emit(). Uses handler formatter if set,
+ *  otherwise cached template. Writes with tplog(), thus request logging
+ *  file of the thread is used.
+ * @param self handler
+ * @param record log record
+ */
+exprivate void ndrxpy_tploghandler_emit(py::object self, py::object record)
+{
+    try
+    {
+        int lev = ndrxpy_logging_lev(record.attr("levelno").cast<int>());
+        py::object formatter = self.attr("formatter");
+        std::string msg;
+
+        if (!formatter.is_none())
+        {
+            msg = self.attr("format")(record).cast<std::string>();
+        }
+        else
+        {
+            ndrxpy_logfmt_t *f = self.attr("_ndrx_fmt").cast<py::capsule>();
+            msg = ndrxpy_logfmt_format(f, record);
+        }
+
+        py::gil_scoped_release release;
+        ndrxpy_tplog_write(lev, msg);
+    }
+    catch (const std::exception &e)
+    {
+        NDRX_LOG(log_error, "TplogHandler failed to emit record: %s", e.what());
+        userlog(const_cast<char *>("TplogHandler failed to emit record: %s"), e.what());
+    }
+}
+
 /**
  * @brief Register ATMI logging api
  * 
@@ -136,107 +508,122 @@ expublic void ndrxpy_register_tplog(py::module &m)
     //Logging functions:
     m.def(
         "tplog_debug",
-        [](const char *message)
+        [](py::str message, py::args args)
         {
-            py::gil_scoped_release release;
-            tplog(log_debug, const_cast<char *>(message));
+            ndrxpy_tplog_fmt(log_debug, message, args);
         },
         R"pbdoc(
         Print debug message to log file. Debug is logged as level **5**.
 
-        For more details see **tplog(3)** C API call
+        For more details see **tplog(3)** C API call. Message is formatted
+        and passed to the logger only if the level is enabled (see :func:`.tplog_level`).
 
         Parameters
         ----------
         message : str
-            Debug message to print.
+            Debug message to print. If *args* are given, message is format
+            string for Python **%** operator.
+        args : tuple
+            Format arguments. Message is formatted only if level is enabled.
         )pbdoc"
         , py::arg("message"));
 
     m.def(
         "tplog_info",
-        [](const char *message)
+        [](py::str message, py::args args)
         {
-            py::gil_scoped_release release;
-            tplog(log_info, const_cast<char *>(message));
+            ndrxpy_tplog_fmt(log_info, message, args);
         },
         R"pbdoc(
         Print info message to log file. Info is logged as level **4**.
 
-        For more details see **tplog(3)** C API call
+        For more details see **tplog(3)** C API call. Message is formatted
+        and passed to the logger only if the level is enabled (see :func:`.tplog_level`).
 
         Parameters
         ----------
         message : str
-            Info message to print.
+            Info message to print. If *args* are given, message is format
+            string for Python **%** operator.
+        args : tuple
+            Format arguments. Message is formatted only if level is enabled.
         )pbdoc"
         , py::arg("message"));
 
     m.def(
         "tplog_warn",
-        [](const char *message)
+        [](py::str message, py::args args)
         {
-            py::gil_scoped_release release;
-            tplog(log_error, const_cast<char *>(message));
+            ndrxpy_tplog_fmt(log_error, message, args);
         },
         R"pbdoc(
         Print warning message to log file. Warning is logged as level **3**.
 
-        For more details see **tplog(3)** C API call
+        For more details see **tplog(3)** C API call. Message is formatted
+        and passed to the logger only if the level is enabled (see :func:`.tplog_level`).
 
         Parameters
         ----------
         message : str
-            Warning message to print.
+            Warning message to print. If *args* are given, message is format
+            string for Python **%** operator.
+        args : tuple
+            Format arguments. Message is formatted only if level is enabled.
         )pbdoc", py::arg("message"));
 
     m.def(
         "tplog_error",
-        [](const char *message)
+        [](py::str message, py::args args)
         {
-            py::gil_scoped_release release;
-            tplog(log_error, const_cast<char *>(message));
+            ndrxpy_tplog_fmt(log_error, message, args);
         },
         R"pbdoc(
         Print error message to log file. Error is logged as level **2**.
 
-        For more details see **tplog(3)** C API call
+        For more details see **tplog(3)** C API call. Message is formatted
+        and passed to the logger only if the level is enabled (see :func:`.tplog_level`).
 
         Parameters
         ----------
         message : str
-            Error message to print.
+            Error message to print. If *args* are given, message is format
+            string for Python **%** operator.
+        args : tuple
+            Format arguments. Message is formatted only if level is enabled.
         )pbdoc", py::arg("message"));
 
     m.def(
         "tplog_always",
-        [](const char *message)
+        [](py::str message, py::args args)
         {
-            py::gil_scoped_release release;
-            tplog(log_always, const_cast<char *>(message));
+            ndrxpy_tplog_fmt(log_always, message, args);
         },
         R"pbdoc(
         Print fatal message to log file. Fatal/always is logged as level **1**.
 
-        For more details see **tplog(3)** C API call
+        For more details see **tplog(3)** C API call. Message is formatted
+        and passed to the logger only if the level is enabled (see :func:`.tplog_level`).
 
         Parameters
         ----------
         message : str
-            Fatal message to print.
+            Fatal message to print. If *args* are given, message is format
+            string for Python **%** operator.
+        args : tuple
+            Format arguments. Message is formatted only if level is enabled.
         )pbdoc", py::arg("message"));
 
     m.def(
         "tplog",
-        [](int lev, const char *message)
+        [](int lev, py::str message, py::args args)
         {
-            py::gil_scoped_release release;
-            tplog(lev, const_cast<char *>(message));
+            ndrxpy_tplog_fmt(lev, message, args);
         },
         R"pbdoc(
         Print logfile message with specified level.
 
-        For more details see **tplog(3)** C API call
+        For more details see **tplog(3)** C API call. Message is formatted
+        and passed to the logger only if the level is enabled (see :func:`.tplog_level`).
 
         Parameters
         ----------
@@ -245,16 +632,85 @@ expublic void ndrxpy_register_tplog(py::module &m)
             :data:`.log_info`, :data:`.log_warn`, :data:`.log_error`, :data:`.log_always`
             or specify the number (1..6).
         message : str
-            Message to log.
+            Message to log. If *args* are given, message is format
+            string for Python **%** operator.
+        args : tuple
+            Format arguments. Message is formatted only if level is enabled.
         )pbdoc", py::arg("lev"), py::arg("message"));
 
+    m.def(
+        "tplog_level",
+        [](bool refresh)
+        {
+            if (refresh)
+            {
+                ndrxpy_tplog_invalidate();
+            }
+
+            return ndrxpy_tplog_level();
+        },
+        R"pbdoc(
+        Return currently active **tp** logger level of the calling thread
+        (request, thread or process logger). Value is cached per thread and
+        refreshed after :func:`.tplogconfig`, :func:`.tplogsetreqfile`,
+        :func:`.tplogsetreqfile_direct`, :func:`.tplogclosereqfile` or
+        :func:`.tplogclosethread`. If logger is re-configured by other means
+        (e.g. C code), use *refresh*.
+
+        .. code-block:: python
+            :caption: tplog_level example
+            :name: tplog_level-example
+
+                import endurox as e
+                if e.tplog_level() >= e.log_debug:
+                    e.tplog_debug("Buffer: " + str(buf))
+                # or let the formatting to be skipped by the disabled level:
+                e.tplog_debug("Buffer: %s", buf)
+
+        Parameters
+        ----------
+        refresh : bool
+            Re-read the level from the logger.
+
+        Returns
+        -------
+        lev : int
+            Log level (0..6).
+        )pbdoc", py::arg("refresh")=false);
+
+    m.def(
+        "tplog_isenabledfor",
+        [](int lev)
+        {
+            return lev <= ndrxpy_tplog_level();
+        },
+        R"pbdoc(
+        Check is given level logged by **tp** logger, using the cached
+        level (see :func:`.tplog_level`). Analogue of
+        :meth:`logging.Logger.isEnabledFor`.
+
+        Parameters
+        ----------
+        lev : int
+            Log level.
+
+        Returns
+        -------
+        ret : bool
+            **True** if messages of level *lev* are logged.
+        )pbdoc", py::arg("lev"));
+
     m.def(
         "tplogconfig",
         [](int logger, int lev, const char *debug_string, const char *module, const char *new_file)
         {
             py::gil_scoped_release release;
-            if (EXSUCCEED!=tplogconfig(logger, lev, const_cast<char *>(debug_string), 
-                const_cast<char *>(module), const_cast<char *>(new_file)))
+            int ret = tplogconfig(logger, lev, const_cast<char *>(debug_string), 
+                const_cast<char *>(module), const_cast<char *>(new_file));
+
+            ndrxpy_tplog_invalidate();
+
+            if (EXSUCCEED!=ret)
             {
                 throw nstd_exception(Nerror);
             }
@@ -395,8 +851,12 @@ expublic void ndrxpy_register_tplog(py::module &m)
                     throw std::invalid_argument("Invalid buffer type");
                 }
 
-                if (EXFAIL==tplogsetreqfile( (0==strcmp(type, "UBF")?in.pp:NULL), const_cast<char *>(filename), 
-                    const_cast<char *>(filesvc)))
+                int ret = tplogsetreqfile( (0==strcmp(type, "UBF")?in.pp:NULL), const_cast<char *>(filename), 
+                    const_cast<char *>(filesvc));
+
+                ndrxpy_tplog_invalidate();
+
+                if (EXFAIL==ret)
                 {
                     // In case if buffer changed..
                     in.p=*in.pp;
@@ -472,6 +932,7 @@ expublic void ndrxpy_register_tplog(py::module &m)
         {
             py::gil_scoped_release release;
             tplogsetreqfile_direct(const_cast<char *>(filename.c_str()));
+            ndrxpy_tplog_invalidate();
         },
         R"pbdoc(
         Set logfile from given filename.
@@ -601,6 +1062,7 @@ expublic void ndrxpy_register_tplog(py::module &m)
         {
             py::gil_scoped_release release;
             tplogclosereqfile();
+            ndrxpy_tplog_invalidate();
         },
         R"pbdoc(
         Close request logging file.
@@ -615,6 +1077,7 @@ expublic void ndrxpy_register_tplog(py::module &m)
         {
             py::gil_scoped_release release;
             tplogclosethread();
+            ndrxpy_tplog_invalidate();
         },
         R"pbdoc(
         Close thread logging file.
@@ -857,6 +1320,88 @@ expublic void ndrxpy_register_tplog(py::module &m)
          )pbdoc",
         py::arg("lev"), py::arg("title"), py::arg("data"));
 
+    //logging.Handler subclass, methods are native
+    py::object handler_base = py::module::import("logging").attr("Handler");
+    py::dict ns;
+
+    ns["__module__"] = m.attr("__name__");
+    ns["__doc__"] = R"pbdoc(
+        :class:`logging.Handler` writing to Enduro/X **tp** logger with **tplog(3)**.
+        Records are written to the current logger of the thread, thus request
+        logging files (:func:`.tplogsetreqfile`) and thread logging files are
+        respected. Python levels are mapped as: **CRITICAL** - :data:`.log_always`,
+        **ERROR** - :data:`.log_error`, **WARNING** - :data:`.log_warn`,
+        **INFO** - :data:`.log_info`, **DEBUG** - :data:`.log_debug`, lower -
+        :data:`.log_dump`.
+
+        Enduro/X level (see :func:`.tplog_level`) is checked before filtering
+        and formatting of the record. If formatter is not set for the handler,
+        record is formatted natively by the *fmt* template (%-style, as
+        :class:`logging.Formatter`), which is parsed once.
+
+        .. code-block:: python
+            :caption: TplogHandler example
+            :name: TplogHandler-example
+
+                import logging
+                import endurox as e
+                log = logging.getLogger("app")
+                log.addHandler(e.TplogHandler(fmt="%(name)s: %(message)s"))
+                log.setLevel(logging.DEBUG)
+                log.info("Processing %s", "request")
+
+        Parameters
+        ----------
+        level : int
+            Handler level, see :meth:`logging.Handler.setLevel`.
+        fmt : str
+            Record template, used while formatter is not set.
+        )pbdoc";
+
+    py::object handler_cls = py::reinterpret_borrow<py::object>(
+        reinterpret_cast<PyObject *>(&PyType_Type))("TplogHandler",
+            py::make_tuple(handler_base), ns);
+
+    handler_cls.attr("__init__") = py::cpp_function(
+        [handler_base](py::object self, int level, const std::string &fmt)
+        {
+            handler_base.attr("__init__")(self, level);
+            self.attr("_ndrx_fmt") = py::capsule(ndrxpy_logfmt_parse(fmt), [](void *p)
+            {
+                delete static_cast<ndrxpy_logfmt_t *>(p);
+            });
+        },
+        py::name("__init__"), py::is_method(handler_cls),
+        py::arg("level")=0, py::arg("fmt")="%(message)s");
+
+    handler_cls.attr("emit") = py::cpp_function(ndrxpy_tploghandler_emit,
+        py::name("emit"), py::is_method(handler_cls), py::arg("record"));
+
+    handler_cls.attr("handle") = py::cpp_function(
+        [](py::object self, py::object record)
+        {
+            //Check Enduro/X level before filters and formatting
+            int lev = ndrxpy_logging_lev(record.attr("levelno").cast<int>());
+
+            if (lev > ndrxpy_tplog_level())
+            {
+                return py::object(py::bool_(false));
+            }
+
+            py::object rv = self.attr("filter")(record);
+
+            if (py::bool_(rv))
+            {
+                //tplog() is thread safe, handler lock is not needed
+                ndrxpy_tploghandler_emit(self, record);
+            }
+
+            return rv;
+        },
+        py::name("handle"), py::is_method(handler_cls), py::arg("record"));
+
+    m.attr("TplogHandler") = handler_cls;
+
     m.def(
         "userlog",
         [](const char *message)
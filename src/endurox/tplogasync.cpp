@@ -0,0 +1,628 @@
+/**
+ * @brief Enduro/X Python module - background log writer
+ *
+ * @file tplogasync.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <string.h>
+#include <pthread.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+/*---------------------------Enums--------------------------------------*/
+
+/**
+ * Full ring policy
+ */
+enum
+{
+    NDRXPY_LOGQ_BLOCK = 0,  /**< Wait for space                         */
+    NDRXPY_LOGQ_DROP,       /**< Drop message, count                    */
+    NDRXPY_LOGQ_SPILL       /**< Write by the calling thread            */
+};
+
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Queued log message
+ */
+struct ndrxpy_logmsg_t
+{
+    unsigned long long seq;     /**< Cross thread order, approximate    */
+    int lev;                    /**< Log level                          */
+    std::string reqfile;        /**< Request file of producer, or empty */
+    std::string msg;            /**< Message                            */
+};
+
+/**
+ * Single producer / single consumer ring of a thread
+ */
+struct ndrxpy_logring_t
+{
+    std::vector<ndrxpy_logmsg_t> slots;
+    size_t mask;
+    std::atomic<size_t> head{0};        /**< Next write, producer       */
+    std::atomic<size_t> tail{0};        /**< Next read, consumer        */
+    std::atomic<size_t> done{0};        /**< Written to log             */
+    std::atomic<bool> orphan{false};    /**< Producer thread exited     */
+};
+
+/**
+ * Ring of the thread, released on thread exit
+ */
+struct ndrxpy_logring_holder_t
+{
+    ndrxpy_logring_t *ring = nullptr;
+
+    ~ndrxpy_logring_holder_t()
+    {
+        if (nullptr!=ring)
+        {
+            ring->orphan.store(true, std::memory_order_release);
+        }
+    }
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+/** Is async mode on */
+static std::atomic<bool> M_async{false};
+
+/** Producers currently between mode check and enqueue */
+static std::atomic<int> M_inflight{0};
+
+/** Full ring policy */
+static std::atomic<int> M_policy{NDRXPY_LOGQ_BLOCK};
+
+/** Capacity of new rings */
+static size_t M_capacity = 4096;
+
+/** Message order */
+static std::atomic<unsigned long long> M_seq{0};
+
+/** All rings, protected by M_mtx */
+static std::vector<ndrxpy_logring_t *> M_rings;
+
+/** Registry and writer wakeup lock */
+static std::mutex M_mtx;
+
+/** Wakes up the writer */
+static std::condition_variable M_cv;
+
+/** Signals flush waiters */
+static std::condition_variable M_flush_cv;
+
+/** Writer thread, not freed in forked child (thread does not exist there) */
+static std::thread *M_writer = nullptr;
+
+/** Writer is waiting for messages */
+static std::atomic<bool> M_sleeping{false};
+
+/** Writer shall exit */
+static bool M_stop = false;
+
+/** Counters */
+static std::atomic<long> M_enqueued{0};
+static std::atomic<long> M_written{0};
+static std::atomic<long> M_dropped{0};
+static std::atomic<long> M_spilled{0};
+static std::atomic<long> M_blocked{0};
+
+/** Ring of the thread */
+static thread_local ndrxpy_logring_holder_t M_ring;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Wake up the writer, if it sleeps
+ */
+exprivate void ndrxpy_logq_wakeup(void)
+{
+    if (M_sleeping.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(M_mtx);
+        M_cv.notify_one();
+    }
+}
+
+/**
+ * @brief Writer thread. Collects messages of all rings, writes them
+ *  ordered by the enqueue sequence, switching the request file of the
+ *  writer as the producer had.
+ */
+exprivate void ndrxpy_logq_run(void)
+{
+    std::vector<ndrxpy_logmsg_t> batch;
+    std::vector<std::pair<ndrxpy_logring_t *, size_t>> ends;
+    std::string cur_reqfile;
+    bool drained = false;
+
+    while (true)
+    {
+        bool stop;
+
+        batch.clear();
+        ends.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(M_mtx);
+
+            for (auto it = M_rings.begin(); it!=M_rings.end();)
+            {
+                ndrxpy_logring_t *r = *it;
+                bool orphan = r->orphan.load(std::memory_order_acquire);
+                size_t h = r->head.load(std::memory_order_acquire);
+                size_t t = r->tail.load(std::memory_order_relaxed);
+
+                if (t==h && orphan)
+                {
+                    delete r;
+                    it = M_rings.erase(it);
+                    continue;
+                }
+
+                for (; t!=h; t++)
+                {
+                    batch.push_back(std::move(r->slots[t & r->mask]));
+                }
+
+                r->tail.store(h, std::memory_order_release);
+                ends.push_back(std::make_pair(r, h));
+                ++it;
+            }
+
+            stop = M_stop;
+
+            if (batch.empty())
+            {
+                if (stop && 0==M_inflight.load())
+                {
+                    /* producer may have published after the scan above,
+                     * exit only when scan after inflight drop is empty */
+                    if (drained)
+                    {
+                        break;
+                    }
+
+                    drained = true;
+                    continue;
+                }
+
+                M_sleeping.store(true, std::memory_order_release);
+                M_cv.wait_for(lock, std::chrono::milliseconds(100));
+                M_sleeping.store(false, std::memory_order_release);
+                continue;
+            }
+        }
+
+        std::sort(batch.begin(), batch.end(), [](const ndrxpy_logmsg_t &a,
+            const ndrxpy_logmsg_t &b){ return a.seq < b.seq; });
+
+        for (auto &m: batch)
+        {
+            if (m.reqfile!=cur_reqfile)
+            {
+                if (m.reqfile.empty())
+                {
+                    tplogclosereqfile();
+                }
+                else
+                {
+                    tplogsetreqfile_direct(const_cast<char *>(m.reqfile.c_str()));
+                }
+
+                cur_reqfile = m.reqfile;
+            }
+
+            tplog(m.lev, const_cast<char *>(m.msg.c_str()));
+        }
+
+        M_written+=batch.size();
+
+        std::lock_guard<std::mutex> lock(M_mtx);
+
+        for (auto &e: ends)
+        {
+            e.first->done.store(e.second, std::memory_order_release);
+        }
+
+        M_flush_cv.notify_all();
+    }
+
+    if (!cur_reqfile.empty())
+    {
+        tplogclosereqfile();
+    }
+}
+
+/**
+ * @brief Write Python originated log message. In async mode message is
+ *  queued to the ring of the thread. Shall be called without GIL.
+ * @param lev log level, already checked by the caller
+ * @param msg message
+ */
+expublic void ndrxpy_tplog_write(int lev, const std::string &msg)
+{
+    std::string reqfile;
+
+    M_inflight++;
+
+    //Thread logger cannot be used by the writer
+    if (!M_async.load() || !ndrxpy_tplog_route(reqfile))
+    {
+        M_inflight--;
+        tplog(lev, const_cast<char *>(msg.c_str()));
+        return;
+    }
+
+    ndrxpy_logring_t *r = M_ring.ring;
+
+    if (nullptr==r)
+    {
+        size_t cap = 1;
+
+        r = new ndrxpy_logring_t();
+
+        {
+            std::lock_guard<std::mutex> lock(M_mtx);
+
+            while (cap < M_capacity)
+            {
+                cap<<=1;
+            }
+
+            M_rings.push_back(r);
+        }
+
+        r->slots.resize(cap);
+        r->mask = cap-1;
+        M_ring.ring = r;
+    }
+
+    size_t h = r->head.load(std::memory_order_relaxed);
+    bool blocked = false;
+
+    while (h - r->tail.load(std::memory_order_acquire) > r->mask)
+    {
+        int policy = M_policy.load();
+
+        if (NDRXPY_LOGQ_DROP==policy)
+        {
+            M_dropped++;
+            M_inflight--;
+            return;
+        }
+        else if (NDRXPY_LOGQ_SPILL==policy)
+        {
+            M_spilled++;
+            M_inflight--;
+            tplog(lev, const_cast<char *>(msg.c_str()));
+            return;
+        }
+
+        if (!blocked)
+        {
+            M_blocked++;
+            blocked = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(M_mtx);
+            M_cv.notify_one();
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    ndrxpy_logmsg_t &m = r->slots[h & r->mask];
+
+    m.seq = M_seq++;
+    m.lev = lev;
+    m.reqfile = std::move(reqfile);
+    m.msg = msg;
+
+    r->head.store(h+1, std::memory_order_release);
+    M_enqueued++;
+    M_inflight--;
+
+    ndrxpy_logq_wakeup();
+}
+
+/**
+ * @brief Are there messages of the thread not yet written
+ * @return true if flush would wait
+ */
+expublic bool ndrxpy_tplog_pending(void)
+{
+    ndrxpy_logring_t *r = M_ring.ring;
+
+    return nullptr!=r && r->done.load(std::memory_order_acquire)!=
+        r->head.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Wait until messages of the calling thread are written.
+ *  Shall be called without GIL.
+ */
+expublic void ndrxpy_tplog_flush(void)
+{
+    ndrxpy_logring_t *r = M_ring.ring;
+
+    if (nullptr==r)
+    {
+        return;
+    }
+
+    size_t target = r->head.load(std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(M_mtx);
+
+    M_cv.notify_one();
+
+    while (r->done.load(std::memory_order_acquire) < target)
+    {
+        if (nullptr==M_writer)
+        {
+            break;
+        }
+
+        M_flush_cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+}
+
+/**
+ * @brief Stop async mode, write all queued messages. Shall be called
+ *  without GIL.
+ */
+exprivate void ndrxpy_logq_stop(void)
+{
+    M_async.store(false);
+
+    std::thread *writer;
+
+    {
+        std::lock_guard<std::mutex> lock(M_mtx);
+
+        if (nullptr==(writer=M_writer) || M_stop)
+        {
+            return;
+        }
+
+        M_stop = true;
+        M_cv.notify_one();
+    }
+
+    writer->join();
+
+    std::lock_guard<std::mutex> lock(M_mtx);
+    delete writer;
+    M_writer = nullptr;
+    M_flush_cv.notify_all();
+}
+
+/**
+ * @brief Keep the registry consistent over fork
+ */
+exprivate void ndrxpy_logq_atfork_prepare(void)
+{
+    M_mtx.lock();
+}
+
+/**
+ * @brief Unlock the registry in parent
+ */
+exprivate void ndrxpy_logq_atfork_parent(void)
+{
+    M_mtx.unlock();
+}
+
+/**
+ * @brief Forked child has no writer thread, reset the mode. Rings and
+ *  messages of the parent are left to the parent (not freed here, as
+ *  other producer threads of the parent may have been inside them).
+ */
+exprivate void ndrxpy_logq_atfork_child(void)
+{
+    M_async.store(false);
+    M_inflight.store(0);
+    M_sleeping.store(false);
+    M_writer = nullptr;
+    M_stop = false;
+    M_rings.clear();
+    M_ring.ring = nullptr;
+    M_mtx.unlock();
+}
+
+/**
+ * @brief Register background log writer functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_tplogasync(py::module &m)
+{
+    m.def(
+        "tplog_async", [](bool enable, long capacity, const std::string &policy)
+        {
+            int pol;
+
+            if ("block"==policy)
+            {
+                pol = NDRXPY_LOGQ_BLOCK;
+            }
+            else if ("drop"==policy)
+            {
+                pol = NDRXPY_LOGQ_DROP;
+            }
+            else if ("spill"==policy)
+            {
+                pol = NDRXPY_LOGQ_SPILL;
+            }
+            else
+            {
+                throw std::invalid_argument("Invalid policy: " + policy);
+            }
+
+            if (capacity < 1)
+            {
+                throw std::invalid_argument("capacity must be greater than 0");
+            }
+
+            M_policy.store(pol);
+
+            py::gil_scoped_release release;
+
+            if (!enable)
+            {
+                ndrxpy_logq_stop();
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(M_mtx);
+
+            M_capacity = capacity;
+
+            if (nullptr==M_writer)
+            {
+                M_stop = false;
+                M_writer = new std::thread(ndrxpy_logq_run);
+                M_async.store(true);
+            }
+        },
+        R"pbdoc(
+        Enable or disable background writing of log messages originated by
+        Python: :func:`.tplog`, :func:`.tplog_debug` .. :func:`.tplog_always`
+        and :class:`.TplogHandler`. Messages are copied to the ring of the
+        calling thread and written by the writer thread, thus the caller does
+        not wait for the file I/O and the logger locks.
+
+        Messages of each thread are written in the order they were logged.
+        Messages of different threads are ordered by their enqueue sequence
+        within each writer pass, thus messages logged concurrently by several
+        threads may appear out of their exact order. The request logging file (:func:`.tplogsetreqfile`) of the calling
+        thread is used for the message. Messages of threads using the thread
+        logger (:data:`.LOG_FACILITY_TP_THREAD`) are written synchronously.
+        Log line headers (e.g. thread id) are of the writer thread.
+
+        Messages of the service thread are written before the reply is sent
+        by :func:`.tpreturn` or :func:`.tpforward`, see also :func:`.tplog_flush`.
+        Queued messages are written when mode is disabled and at the interpreter exit.
+        In the forked child the mode is off (messages queued before the fork
+        are written by the parent), and may be enabled again.
+
+        Parameters
+        ----------
+        enable : bool
+            Enable (**True**) or disable (**False**, writes queued messages) mode.
+        capacity : int
+            Ring capacity (messages) per thread, rounded up to the power of 2.
+            Applies to rings of threads which have not yet logged.
+        policy : str
+            Action when ring of the thread is full: **block** - wait for space,
+            **drop** - drop the message (counted), **spill** - write the message
+            synchronously by the calling thread (out of order).
+        )pbdoc",
+        py::arg("enable")=true, py::arg("capacity")=4096, py::arg("policy")="block");
+
+    m.def(
+        "tplog_flush", [](void)
+        {
+            py::gil_scoped_release release;
+            ndrxpy_tplog_flush();
+        },
+        R"pbdoc(
+        Wait until the messages logged by the calling thread in async mode
+        (see :func:`.tplog_async`) are written.
+        )pbdoc");
+
+    m.def(
+        "tplog_async_stats", [](void)
+        {
+            py::dict ret;
+
+            ret["enabled"] = M_async.load();
+            ret["enqueued"] = M_enqueued.load();
+            ret["written"] = M_written.load();
+            ret["dropped"] = M_dropped.load();
+            ret["spilled"] = M_spilled.load();
+            ret["blocked"] = M_blocked.load();
+
+            return ret;
+        },
+        R"pbdoc(
+        Return background log writer counters.
+
+        Returns
+        -------
+        dict
+            **enabled** - is mode on, **enqueued** - messages queued,
+            **written** - messages written by the writer, **dropped**,
+            **spilled** - messages handled by full ring policy, **blocked** -
+            number of times producers waited for space.
+        )pbdoc");
+
+    //Writer thread is not inherited by the forked child
+    if (EXSUCCEED!=pthread_atfork(ndrxpy_logq_atfork_prepare,
+            ndrxpy_logq_atfork_parent, ndrxpy_logq_atfork_child))
+    {
+        NDRX_LOG(log_error, "pthread_atfork failed");
+    }
+
+    //Write queued messages at exit
+    py::module::import("atexit").attr("register")(py::cpp_function([](void)
+    {
+        py::gil_scoped_release release;
+        ndrxpy_logq_stop();
+    }));
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
@@ -0,0 +1,621 @@
+/**
+ * @brief Enduro/X Python module - server timer wheel
+ *
+ * @file tptimer.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <string.h>
+#include <errno.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <cmath>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#ifdef EX_OS_LINUX
+#include <sys/timerfd.h>
+#endif
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+
+#define NDRXPY_TW_BITS      8                       /**< Slot index bits        */
+#define NDRXPY_TW_SIZE      (1<<NDRXPY_TW_BITS)     /**< Slots per level        */
+#define NDRXPY_TW_MASK      (NDRXPY_TW_SIZE-1)      /**< Slot index mask        */
+#define NDRXPY_TW_LEVELS    4                       /**< Wheel levels, 2^32 ms  */
+#define NDRXPY_TW_MAXDELAY  0x7fffffffLL            /**< Max delay, ms          */
+
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Timer of the wheel
+ */
+struct ndrxpy_timer_t
+{
+    long id;                    /**< Timer id returned to Python            */
+    unsigned long long expires; /**< Expiry tick (ms)                       */
+    long interval;              /**< Period in ms, 0 - one shot             */
+    py::object func;            /**< Python callback                        */
+    int level;                  /**< Wheel level, if linked                 */
+    int slot;                   /**< Wheel slot, if linked                  */
+    std::list<ndrxpy_timer_t *>::iterator pos; /**< Position in slot        */
+    bool linked;                /**< Is timer in the wheel                  */
+    bool cancelled;             /**< Cancelled while firing                 */
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+/** Hierarchical wheel, level l slot covers 2^(8*l) ms */
+static std::list<ndrxpy_timer_t *> M_wheel[NDRXPY_TW_LEVELS][NDRXPY_TW_SIZE];
+
+/** Number of timers per level */
+static long M_level_cnt[NDRXPY_TW_LEVELS] = {0};
+
+/** Active timers by id */
+static std::unordered_map<long, ndrxpy_timer_t *> M_timers;
+
+/** Timer id sequence */
+static long M_timer_seq = 0;
+
+/** Last processed tick, ms since M_base */
+static unsigned long long M_now = 0;
+
+/** Monotonic time of tick 0, ms */
+static unsigned long long M_base = 0;
+
+/** Wheel timer, registered to the server poller */
+static int M_timerfd = EXFAIL;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Monotonic clock
+ * @return ms
+ */
+exprivate unsigned long long ndrxpy_tw_monotonic(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<unsigned long long>(ts.tv_sec)*1000 + ts.tv_nsec/1000000;
+}
+
+/**
+ * @brief Put timer in the wheel. Level is selected so that the slot
+ *  is cascaded (or fired) when M_now reaches the expiry window.
+ * @param t timer
+ */
+exprivate void ndrxpy_tw_link(ndrxpy_timer_t *t)
+{
+    int l;
+
+    if (t->expires <= M_now)
+    {
+        t->expires = M_now+1;
+    }
+
+    for (l=0; l<NDRXPY_TW_LEVELS-1; l++)
+    {
+        if ((t->expires >> (NDRXPY_TW_BITS*(l+1))) == (M_now >> (NDRXPY_TW_BITS*(l+1))))
+        {
+            break;
+        }
+    }
+
+    t->level = l;
+    t->slot = (t->expires >> (NDRXPY_TW_BITS*l)) & NDRXPY_TW_MASK;
+    t->pos = M_wheel[l][t->slot].insert(M_wheel[l][t->slot].end(), t);
+    t->linked = true;
+    M_level_cnt[l]++;
+}
+
+/**
+ * @brief Remove timer from the wheel
+ * @param t timer
+ */
+exprivate void ndrxpy_tw_unlink(ndrxpy_timer_t *t)
+{
+    if (t->linked)
+    {
+        M_wheel[t->level][t->slot].erase(t->pos);
+        M_level_cnt[t->level]--;
+        t->linked = false;
+    }
+}
+
+/**
+ * @brief Re-distribute current slot of the level to the lower levels
+ * @param l level
+ */
+exprivate void ndrxpy_tw_cascade(int l)
+{
+    std::list<ndrxpy_timer_t *> tmp;
+    int idx = (M_now >> (NDRXPY_TW_BITS*l)) & NDRXPY_TW_MASK;
+
+    tmp.splice(tmp.end(), M_wheel[l][idx]);
+    M_level_cnt[l]-=tmp.size();
+
+    for (auto t: tmp)
+    {
+        t->linked = false;
+        ndrxpy_tw_link(t);
+    }
+}
+
+/**
+ * @brief Advance the wheel up to given tick, collect expired timers.
+ *  Ticks with no timers at the lower levels are skipped.
+ * @param target tick to advance to
+ * @param expired expired timers (unlinked)
+ */
+exprivate void ndrxpy_tw_advance(unsigned long long target,
+    std::vector<ndrxpy_timer_t *> &expired)
+{
+    while (M_now < target)
+    {
+        int l, top;
+
+        for (l=0; l<NDRXPY_TW_LEVELS && 0==M_level_cnt[l]; l++);
+
+        if (l > 0)
+        {
+            unsigned long long skip = target;
+
+            if (l < NDRXPY_TW_LEVELS)
+            {
+                skip = M_now | ((1ULL << (NDRXPY_TW_BITS*l))-1);
+
+                if (skip > target)
+                {
+                    skip = target;
+                }
+            }
+
+            if (skip > M_now)
+            {
+                M_now = skip;
+                continue;
+            }
+        }
+
+        M_now++;
+
+        /* cascade from the highest level which wrapped */
+        top = 0;
+        for (l=1; l<NDRXPY_TW_LEVELS; l++)
+        {
+            if (0!=(M_now & ((1ULL << (NDRXPY_TW_BITS*l))-1)))
+            {
+                break;
+            }
+            top = l;
+        }
+
+        for (l=top; l>0; l--)
+        {
+            ndrxpy_tw_cascade(l);
+        }
+
+        std::list<ndrxpy_timer_t *> &slot = M_wheel[0][M_now & NDRXPY_TW_MASK];
+
+        for (auto t: slot)
+        {
+            t->linked = false;
+            expired.push_back(t);
+        }
+
+        M_level_cnt[0]-=slot.size();
+        slot.clear();
+    }
+}
+
+/**
+ * @brief Arm the timerfd for the next tick with work: first timer at level 0
+ *  or next cascade of the lowest non empty level.
+ */
+exprivate void ndrxpy_tw_arm(void)
+{
+#ifdef EX_OS_LINUX
+    struct itimerspec its = {};
+    unsigned long long next = 0;
+    int l;
+
+    for (l=0; l<NDRXPY_TW_LEVELS && 0==M_level_cnt[l]; l++);
+
+    if (0==l)
+    {
+        int i;
+
+        for (i=(M_now & NDRXPY_TW_MASK)+1; i<NDRXPY_TW_SIZE; i++)
+        {
+            if (!M_wheel[0][i].empty())
+            {
+                next = (M_now & ~static_cast<unsigned long long>(NDRXPY_TW_MASK)) + i;
+                break;
+            }
+        }
+
+        if (0==next)
+        {
+            next = M_now+1;
+        }
+    }
+    else if (l < NDRXPY_TW_LEVELS)
+    {
+        next = ((M_now >> (NDRXPY_TW_BITS*l)) + 1) << (NDRXPY_TW_BITS*l);
+    }
+
+    if (next > 0)
+    {
+        next+=M_base;
+        its.it_value.tv_sec = next / 1000;
+        its.it_value.tv_nsec = (next % 1000) * 1000000;
+    }
+
+    if (EXSUCCEED!=timerfd_settime(M_timerfd, TFD_TIMER_ABSTIME, &its, NULL))
+    {
+        NDRX_LOG(log_error, "timerfd_settime failed: %s", strerror(errno));
+    }
+#endif
+}
+
+/**
+ * @brief Wheel timer callback. Expired timers are fired in single GIL acquire.
+ * @param fd timer fd
+ * @param events poll events
+ * @param ptr1 not used
+ * @return EXSUCCEED
+ */
+exprivate int ndrxpy_tw_timer_cb(int fd, uint32_t events, void *ptr1)
+{
+    std::vector<ndrxpy_timer_t *> expired;
+    uint64_t expirations;
+
+    if (sizeof(expirations)!=read(fd, &expirations, sizeof(expirations)))
+    {
+        NDRX_LOG(log_debug, "timer read: %s", strerror(errno));
+    }
+
+    ndrxpy_tw_advance(ndrxpy_tw_monotonic() - M_base, expired);
+
+    if (!expired.empty())
+    {
+        py::gil_scoped_acquire acquire;
+
+        for (auto t: expired)
+        {
+            if (t->cancelled)
+            {
+                continue;
+            }
+
+            try
+            {
+                t->func();
+            }
+            catch (const std::exception &e)
+            {
+                NDRX_LOG(log_error, "Got exception at timer %ld: %s", t->id, e.what());
+                userlog(const_cast<char *>("%s"), e.what());
+            }
+        }
+
+        for (auto t: expired)
+        {
+            if (!t->cancelled && t->interval > 0)
+            {
+                t->expires+=t->interval;
+
+                /* missed periods are skipped */
+                if (t->expires <= M_now)
+                {
+                    t->expires = M_now + t->interval;
+                }
+
+                ndrxpy_tw_link(t);
+            }
+            else
+            {
+                if (!t->cancelled)
+                {
+                    M_timers.erase(t->id);
+                }
+                delete t;
+            }
+        }
+    }
+
+    ndrxpy_tw_arm();
+
+    return EXSUCCEED;
+}
+
+/**
+ * @brief Add timer
+ * @param delay first fire, seconds
+ * @param interval period, seconds. 0 - one shot
+ * @param func Python callback
+ * @return timer id
+ */
+exprivate long ndrxpy_tw_add(double delay, double interval, const py::object &func)
+{
+#ifndef EX_OS_LINUX
+    throw std::invalid_argument("Timers require timerfd (Linux only)");
+#else
+    long long delay_ms = std::llround(delay*1000);
+    long long interval_ms = std::llround(interval*1000);
+
+    if (delay_ms < 0 || delay_ms > NDRXPY_TW_MAXDELAY)
+    {
+        throw std::invalid_argument("Invalid timer delay");
+    }
+
+    if (interval_ms < 0 || interval_ms > NDRXPY_TW_MAXDELAY || (interval > 0 && 0==interval_ms))
+    {
+        throw std::invalid_argument("Invalid timer interval");
+    }
+
+    if (EXFAIL==M_timerfd)
+    {
+        if (EXFAIL==(M_timerfd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)))
+        {
+            NDRX_LOG(log_error, "timerfd_create failed: %s", strerror(errno));
+            throw atmi_exception(TPEOS);
+        }
+
+        if (EXSUCCEED!=ndrxpy_pollerfd_add(M_timerfd, POLLIN, NULL, ndrxpy_tw_timer_cb))
+        {
+            int err = tperrno;
+            close(M_timerfd);
+            M_timerfd = EXFAIL;
+            throw atmi_exception(err);
+        }
+
+        M_base = ndrxpy_tw_monotonic();
+        M_now = 0;
+    }
+
+    unsigned long long now = ndrxpy_tw_monotonic() - M_base;
+
+    /* idle wheel, no need to walk */
+    if (M_timers.empty())
+    {
+        M_now = now;
+    }
+
+    ndrxpy_timer_t *t = new ndrxpy_timer_t();
+
+    t->id = ++M_timer_seq;
+    t->expires = now + delay_ms;
+    t->interval = interval_ms;
+    t->func = func;
+    t->linked = false;
+    t->cancelled = false;
+
+    ndrxpy_tw_link(t);
+    M_timers[t->id] = t;
+
+    ndrxpy_tw_arm();
+
+    return t->id;
+#endif
+}
+
+/**
+ * @brief Cancel timer
+ * @param id timer id
+ * @return true if timer was active
+ */
+exprivate bool ndrxpy_tw_cancel(long id)
+{
+    auto it = M_timers.find(id);
+
+    if (M_timers.end()==it)
+    {
+        return false;
+    }
+
+    ndrxpy_timer_t *t = it->second;
+    M_timers.erase(it);
+
+    if (t->linked)
+    {
+        ndrxpy_tw_unlink(t);
+        delete t;
+    }
+    else
+    {
+        /* firing now, removed by timer callback */
+        t->cancelled = true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Remove all timers and the timer fd (server shutdown).
+ *  GIL must be held.
+ */
+expublic void ndrxpy_timer_clear(void)
+{
+    for (auto &it: M_timers)
+    {
+        ndrxpy_tw_unlink(it.second);
+        delete it.second;
+    }
+
+    M_timers.clear();
+
+    if (EXFAIL!=M_timerfd)
+    {
+        ndrxpy_pollerfd_del(M_timerfd);
+        close(M_timerfd);
+        M_timerfd = EXFAIL;
+    }
+}
+
+/**
+ * @brief Register timer wheel functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_tptimer(py::module &m)
+{
+    m.def(
+        "ndrxpy_call_later", [](double delay, const py::object &func)
+        { return ndrxpy_tw_add(delay, 0, func); },
+        R"pbdoc(
+        Call *func* once after *delay* seconds, from the XATMI server main
+        dispatcher. Timers have millisecond resolution and are kept in
+        hierarchical timer wheel driven by single **timerfd** registered
+        to the server poller. All timers expired at the same poll are fired
+        in single GIL acquisition. Exceptions raised by *func* are logged.
+
+        Unlike :func:`.tpext_addperiodcb`, any number of timers may be used
+        and timers may be added in :py:meth:`Server.tpsvrinit()`.
+
+        Function is not thread safe. This function applies to ATMI servers only.
+        Timer requires Linux **timerfd**.
+
+        .. code-block:: python
+            :caption: ndrxpy_call_later example
+            :name: ndrxpy_call_later-example
+
+            import sys
+            import endurox as e
+
+            def heartbeat():
+                e.tplog_info("alive")
+
+            class Server:
+
+                def tpsvrinit(self, args):
+                    self.hb = e.ndrxpy_call_every(0.5, heartbeat)
+                    e.ndrxpy_call_later(0.01, lambda: e.tplog_info("started"))
+                    return 0
+
+                def tpsvrdone(self):
+                    e.ndrxpy_timer_cancel(self.hb)
+
+            if __name__ == '__main__':
+                e.tprun(Server(), sys.argv)
+
+        :raise AtmiException: 
+            | Following error codes may be present:
+            | :data:`.TPEOS` - Failed to create timer.
+            | :data:`.TPESYSTEM` - Failed to add timer to the poller.
+
+        Parameters
+        ----------
+        delay : float
+            Seconds to wait, up to 24 days.
+        func : object
+            Callback, called with no arguments.
+
+        Returns
+        -------
+        int
+            Timer id, for :func:`.ndrxpy_timer_cancel`.
+        )pbdoc",
+        py::arg("delay"), py::arg("func"));
+
+    m.def(
+        "ndrxpy_call_every", [](double interval, const py::object &func)
+        { return ndrxpy_tw_add(interval, interval, func); },
+        R"pbdoc(
+        Call *func* every *interval* seconds, first call after *interval*.
+        If server was busy and periods were missed, they are skipped.
+        See :func:`.ndrxpy_call_later` for details.
+
+        Function is not thread safe. This function applies to ATMI servers only.
+
+        :raise AtmiException: 
+            | Following error codes may be present:
+            | :data:`.TPEOS` - Failed to create timer.
+            | :data:`.TPESYSTEM` - Failed to add timer to the poller.
+
+        Parameters
+        ----------
+        interval : float
+            Period in seconds, at least 0.001.
+        func : object
+            Callback, called with no arguments.
+
+        Returns
+        -------
+        int
+            Timer id, for :func:`.ndrxpy_timer_cancel`.
+        )pbdoc",
+        py::arg("interval"), py::arg("func"));
+
+    m.def(
+        "ndrxpy_timer_cancel", [](long timer_id)
+        { return ndrxpy_tw_cancel(timer_id); },
+        R"pbdoc(
+        Cancel timer added by :func:`.ndrxpy_call_later` or
+        :func:`.ndrxpy_call_every`. Timer may be cancelled from any
+        timer callback, including its own.
+
+        Function is not thread safe. This function applies to ATMI servers only.
+
+        Parameters
+        ----------
+        timer_id : int
+            Timer id.
+
+        Returns
+        -------
+        bool
+            **True** if timer was active, **False** if not found (already
+            fired one shot timer or cancelled).
+        )pbdoc",
+        py::arg("timer_id"));
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
@@ -0,0 +1,922 @@
+/**
+ * @brief Enduro/X Python module - shared memory UBF arena
+ *
+ * @file ubfarena.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+
+#define NDRXPY_ARENA_MAGIC      0x41464255  /**< "UBFA"                     */
+#define NDRXPY_ARENA_VERSION    2           /**< Segment layout version     */
+#define NDRXPY_ARENA_MINSHIFT   8           /**< Smallest block, 256 bytes  */
+#define NDRXPY_ARENA_CLASSES    23          /**< Size classes, up to 1GB    */
+#define NDRXPY_ARENA_HDRSZ      1024        /**< Reserved for arena header  */
+#define NDRXPY_ARENA_MAXSZ      0xFFFFFF00UL/**< Offsets are 32 bit         */
+#define NDRXPY_ARENA_ATTACH_MS  5000        /**< Wait for creator init      */
+
+/** Offset part of free list head / handle */
+#define NDRXPY_ARENA_OFF(X)     (static_cast<uint32_t>((X) & 0xFFFFFFFFULL))
+/** Tag / generation part of free list head / handle */
+#define NDRXPY_ARENA_TAG(X)     (static_cast<uint32_t>((X) >> 32))
+/** Build free list head / handle */
+#define NDRXPY_ARENA_MK(T, O)   ((static_cast<uint64_t>(T) << 32) | (O))
+
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Arena segment header, placed at offset 0 of the shared memory
+ */
+struct ndrxpy_arena_hdr_t
+{
+    uint32_t magic;                 /**< NDRXPY_ARENA_MAGIC             */
+    uint32_t version;               /**< NDRXPY_ARENA_VERSION           */
+    uint64_t size;                  /**< Segment size                   */
+    std::atomic<uint32_t> ready;    /**< Set by creator after init      */
+    std::atomic<uint64_t> top;      /**< Bump allocation offset         */
+    std::atomic<uint64_t> allocs;   /**< Blocks allocated               */
+    std::atomic<uint64_t> frees;    /**< Blocks returned                */
+    /** Free block stacks per size class, (tag << 32) | block offset */
+    std::atomic<uint64_t> free[NDRXPY_ARENA_CLASSES];
+};
+
+/**
+ * Block header, UBF buffer follows
+ */
+struct ndrxpy_arena_blk_t
+{
+    uint32_t cls;                   /**< Size class                     */
+    std::atomic<uint32_t> gen;      /**< Generation, part of handle     */
+    std::atomic<uint32_t> refcnt;   /**< Handles and views referencing  */
+    std::atomic<uint32_t> handoff;  /**< Handles not yet taken/released */
+    std::atomic<uint32_t> next;     /**< Next free block offset         */
+    uint32_t rfu;                   /**< Keeps UBF 8 byte aligned       */
+};
+
+/**
+ * Process local mapping of the arena. Shared by the arena object and
+ * UbfDict views, unmapped when both are gone.
+ */
+struct ndrxpy_arena_map_t
+{
+    char *base;                     /**< Mapped address                 */
+    size_t size;                    /**< Mapped size                    */
+    long views;                     /**< Live UbfDict views             */
+    bool closed;                    /**< Arena object closed            */
+};
+
+/**
+ * Shared memory arena of UBF buffers. Buffers are allocated with lock-free
+ * size class free lists and passed between processes by handle.
+ */
+class ndrxpy_ubfarena
+{
+public:
+
+    ndrxpy_ubfarena(const std::string &name, unsigned long size, bool create);
+    ~ndrxpy_ubfarena();
+
+    uint64_t put(py::object data, uint32_t refs);
+    py::object take(uint64_t handle, bool copy);
+    void retain(uint64_t handle, uint32_t n);
+    void release(uint64_t handle);
+    py::dict stats(void);
+    void close(void);
+    void unlink(void);
+
+private:
+
+    ndrxpy_arena_hdr_t *hdr(void);
+    ndrxpy_arena_blk_t *blk(uint64_t handle);
+
+    std::string M_name;
+    ndrxpy_arena_map_t *M_map = nullptr;
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+/** Mappings of this process, protected by M_maps_mutex */
+exprivate std::vector<ndrxpy_arena_map_t *> M_maps;
+exprivate std::mutex M_maps_mutex;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Resolve block by offset
+ * @param h arena header
+ * @param off block offset
+ * @return block header
+ */
+exprivate inline ndrxpy_arena_blk_t *ndrxpy_arena_blkat(ndrxpy_arena_hdr_t *h,
+        uint32_t off)
+{
+    return reinterpret_cast<ndrxpy_arena_blk_t *>(reinterpret_cast<char *>(h) + off);
+}
+
+/**
+ * @brief Return block to its size class free list
+ * @param h arena header
+ * @param off block offset
+ */
+exprivate void ndrxpy_arena_free(ndrxpy_arena_hdr_t *h, uint32_t off)
+{
+    ndrxpy_arena_blk_t *b = ndrxpy_arena_blkat(h, off);
+    std::atomic<uint64_t> &head = h->free[b->cls];
+    uint64_t cur = head.load(std::memory_order_relaxed);
+    uint64_t nhead;
+
+    do
+    {
+        b->next.store(NDRXPY_ARENA_OFF(cur), std::memory_order_relaxed);
+        nhead = NDRXPY_ARENA_MK(NDRXPY_ARENA_TAG(cur)+1, off);
+    } while (!head.compare_exchange_weak(cur, nhead, std::memory_order_release,
+                std::memory_order_relaxed));
+
+    h->frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Allocate block, first from free list of the size class,
+ *  then from the unallocated space.
+ * @param h arena header
+ * @param len bytes needed after block header
+ * @return block offset or 0 if arena is full
+ */
+exprivate uint32_t ndrxpy_arena_alloc(ndrxpy_arena_hdr_t *h, size_t len)
+{
+    size_t need = len + sizeof(ndrxpy_arena_blk_t);
+    uint32_t cls = 0;
+    uint32_t off = 0;
+    ndrxpy_arena_blk_t *b;
+
+    while (cls < NDRXPY_ARENA_CLASSES &&
+            (static_cast<size_t>(1) << (cls+NDRXPY_ARENA_MINSHIFT)) < need)
+    {
+        cls++;
+    }
+
+    if (cls >= NDRXPY_ARENA_CLASSES)
+    {
+        return 0;
+    }
+
+    /* tagged head avoids ABA, when block is popped and pushed back meanwhile */
+    std::atomic<uint64_t> &head = h->free[cls];
+    uint64_t cur = head.load(std::memory_order_acquire);
+
+    while (0!=NDRXPY_ARENA_OFF(cur))
+    {
+        uint32_t next = ndrxpy_arena_blkat(h, NDRXPY_ARENA_OFF(cur))->
+                next.load(std::memory_order_relaxed);
+
+        if (head.compare_exchange_weak(cur,
+                NDRXPY_ARENA_MK(NDRXPY_ARENA_TAG(cur)+1, next),
+                std::memory_order_acquire, std::memory_order_acquire))
+        {
+            off = NDRXPY_ARENA_OFF(cur);
+            break;
+        }
+    }
+
+    if (0==off)
+    {
+        uint64_t bsz = static_cast<uint64_t>(1) << (cls+NDRXPY_ARENA_MINSHIFT);
+        uint64_t top = h->top.load(std::memory_order_relaxed);
+
+        do
+        {
+            if (top + bsz > h->size)
+            {
+                return 0;
+            }
+        } while (!h->top.compare_exchange_weak(top, top+bsz,
+                    std::memory_order_relaxed, std::memory_order_relaxed));
+
+        off = static_cast<uint32_t>(top);
+        ndrxpy_arena_blkat(h, off)->cls = cls;
+    }
+
+    b = ndrxpy_arena_blkat(h, off);
+
+    /* generation 0 is never valid in handle */
+    if (0==b->gen.fetch_add(1, std::memory_order_acq_rel)+1)
+    {
+        b->gen.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    h->allocs.fetch_add(1, std::memory_order_relaxed);
+
+    return off;
+}
+
+/**
+ * @brief Claim one outstanding handle reference of the block, so that
+ *  each reference is taken or released once.
+ * @param b block
+ * @param handle buffer handle
+ */
+exprivate void ndrxpy_arena_claim(ndrxpy_arena_blk_t *b, uint64_t handle)
+{
+    uint32_t cnt = b->handoff.load(std::memory_order_acquire);
+
+    do
+    {
+        if (0==cnt || NDRXPY_ARENA_TAG(handle)!=b->gen.load(std::memory_order_acquire))
+        {
+            throw std::invalid_argument("Stale arena handle");
+        }
+    } while (!b->handoff.compare_exchange_weak(cnt, cnt-1,
+                std::memory_order_acq_rel, std::memory_order_acquire));
+}
+
+/**
+ * @brief Drop references of the block, free it when last is gone
+ * @param h arena header
+ * @param off block offset
+ * @param n references to drop
+ */
+exprivate void ndrxpy_arena_unref(ndrxpy_arena_hdr_t *h, uint32_t off, uint32_t n)
+{
+    if (n==ndrxpy_arena_blkat(h, off)->refcnt.fetch_sub(n, std::memory_order_acq_rel))
+    {
+        ndrxpy_arena_free(h, off);
+    }
+}
+
+/**
+ * @brief Unmap the arena, if not used any more. Shall be called
+ *  with M_maps_mutex locked.
+ * @param map process mapping
+ */
+exprivate void ndrxpy_arena_unmap(ndrxpy_arena_map_t *map)
+{
+    if (!map->closed || map->views > 0)
+    {
+        return;
+    }
+
+    M_maps.erase(std::remove(M_maps.begin(), M_maps.end(), map), M_maps.end());
+
+    if (EXSUCCEED!=munmap(map->base, map->size))
+    {
+        NDRX_LOG(log_error, "munmap arena %p failed: %s", map->base, strerror(errno));
+    }
+
+    delete map;
+}
+
+/**
+ * @brief Release arena UbfDict view. Called when view is freed.
+ * @param data UBF buffer in the arena
+ */
+expublic void ndrxpy_ubfarena_unref(char *data)
+{
+    std::lock_guard<std::mutex> lock(M_maps_mutex);
+
+    for (auto map : M_maps)
+    {
+        if (data > map->base && data < map->base + map->size)
+        {
+            ndrxpy_arena_hdr_t *h = reinterpret_cast<ndrxpy_arena_hdr_t *>(map->base);
+            uint32_t off = static_cast<uint32_t>(data - map->base -
+                sizeof(ndrxpy_arena_blk_t));
+
+            ndrxpy_arena_unref(h, off, 1);
+            map->views--;
+            ndrxpy_arena_unmap(map);
+            return;
+        }
+    }
+
+    NDRX_LOG(log_error, "UBF %p not in any arena - leaked", data);
+}
+
+/**
+ * @brief Create or attach to the arena
+ * @param name POSIX shared memory name, e.g. "/myarena"
+ * @param size segment size, used by creator
+ * @param create create segment if it does not exist
+ */
+ndrxpy_ubfarena::ndrxpy_ubfarena(const std::string &name, unsigned long size, bool create)
+    : M_name(name)
+{
+    int fd = EXFAIL;
+    bool creator = false;
+    struct stat st;
+    void *base;
+    ndrxpy_arena_hdr_t *h;
+
+    if (create && (size < NDRXPY_ARENA_HDRSZ*2 || size > NDRXPY_ARENA_MAXSZ))
+    {
+        throw std::invalid_argument("Arena size must be in range "+
+            std::to_string(NDRXPY_ARENA_HDRSZ*2)+".."+
+            std::to_string(NDRXPY_ARENA_MAXSZ));
+    }
+
+    if (create)
+    {
+        fd = shm_open(name.c_str(), O_RDWR|O_CREAT|O_EXCL, 0660);
+
+        if (EXFAIL!=fd)
+        {
+            creator = true;
+        }
+        else if (EEXIST!=errno)
+        {
+            NDRX_LOG(log_error, "shm_open [%s] failed: %s", name.c_str(), strerror(errno));
+            throw atmi_exception(TPEOS);
+        }
+    }
+
+    if (EXFAIL==fd)
+    {
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+
+        if (EXFAIL==fd)
+        {
+            int err = errno;
+            NDRX_LOG(log_error, "shm_open [%s] failed: %s", name.c_str(), strerror(err));
+            throw atmi_exception(ENOENT==err?TPENOENT:TPEOS);
+        }
+    }
+
+    if (creator)
+    {
+        if (EXSUCCEED!=ftruncate(fd, size))
+        {
+            NDRX_LOG(log_error, "ftruncate [%s] failed: %s", name.c_str(), strerror(errno));
+            ::close(fd);
+            shm_unlink(name.c_str());
+            throw atmi_exception(TPEOS);
+        }
+        st.st_size = size;
+    }
+    else
+    {
+        /* creator may not yet have sized the segment */
+        py::gil_scoped_release release;
+        auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(NDRXPY_ARENA_ATTACH_MS);
+
+        while (EXSUCCEED==fstat(fd, &st) &&
+                static_cast<size_t>(st.st_size) < NDRXPY_ARENA_HDRSZ*2 &&
+                std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    if (static_cast<size_t>(st.st_size) < NDRXPY_ARENA_HDRSZ*2)
+    {
+        NDRX_LOG(log_error, "Arena [%s] not initialized", name.c_str());
+        ::close(fd);
+        throw atmi_exception(TPETIME);
+    }
+
+    base = mmap(nullptr, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (MAP_FAILED==base)
+    {
+        NDRX_LOG(log_error, "mmap [%s] failed: %s", name.c_str(), strerror(errno));
+        if (creator)
+        {
+            shm_unlink(name.c_str());
+        }
+        throw atmi_exception(TPEOS);
+    }
+
+    h = reinterpret_cast<ndrxpy_arena_hdr_t *>(base);
+
+    if (!h->top.is_lock_free() || !h->ready.is_lock_free())
+    {
+        munmap(base, st.st_size);
+        throw std::runtime_error("Lock-free atomics not available for UbfArena");
+    }
+
+    if (creator)
+    {
+        h->magic = NDRXPY_ARENA_MAGIC;
+        h->version = NDRXPY_ARENA_VERSION;
+        h->size = st.st_size;
+        h->top.store(NDRXPY_ARENA_HDRSZ, std::memory_order_relaxed);
+        h->ready.store(1, std::memory_order_release);
+    }
+    else
+    {
+        py::gil_scoped_release release;
+        auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(NDRXPY_ARENA_ATTACH_MS);
+
+        while (!h->ready.load(std::memory_order_acquire) &&
+                std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    if (!h->ready.load(std::memory_order_acquire) ||
+            NDRXPY_ARENA_MAGIC!=h->magic || NDRXPY_ARENA_VERSION!=h->version ||
+            h->size!=static_cast<uint64_t>(st.st_size))
+    {
+        NDRX_LOG(log_error, "Arena [%s] not initialized or invalid "
+            "(magic %x version %u)", name.c_str(), h->magic, h->version);
+        munmap(base, st.st_size);
+        throw std::invalid_argument("Shared memory ["+name+"] is not UBF arena");
+    }
+
+    M_map = new ndrxpy_arena_map_t();
+    M_map->base = reinterpret_cast<char *>(base);
+    M_map->size = st.st_size;
+    M_map->views = 0;
+    M_map->closed = false;
+
+    std::lock_guard<std::mutex> lock(M_maps_mutex);
+    M_maps.push_back(M_map);
+}
+
+/**
+ * @brief Detach, mapping is kept while views are alive
+ */
+ndrxpy_ubfarena::~ndrxpy_ubfarena()
+{
+    close();
+}
+
+/**
+ * @brief Arena header of open arena
+ * @return header
+ */
+ndrxpy_arena_hdr_t *ndrxpy_ubfarena::hdr(void)
+{
+    if (nullptr==M_map)
+    {
+        throw atmi_exception(TPEPROTO);
+    }
+
+    return reinterpret_cast<ndrxpy_arena_hdr_t *>(M_map->base);
+}
+
+/**
+ * @brief Validate handle and resolve the block
+ * @param handle buffer handle
+ * @return block header
+ */
+ndrxpy_arena_blk_t *ndrxpy_ubfarena::blk(uint64_t handle)
+{
+    ndrxpy_arena_hdr_t *h = hdr();
+    uint32_t off = NDRXPY_ARENA_OFF(handle);
+    ndrxpy_arena_blk_t *b;
+
+    if (off < NDRXPY_ARENA_HDRSZ || off >= h->top.load(std::memory_order_acquire) ||
+            0!=(off & ((1<<NDRXPY_ARENA_MINSHIFT)-1)))
+    {
+        throw std::invalid_argument("Invalid arena handle");
+    }
+
+    b = ndrxpy_arena_blkat(h, off);
+
+    if (NDRXPY_ARENA_TAG(handle)!=b->gen.load(std::memory_order_acquire) ||
+            0==b->refcnt.load(std::memory_order_acquire))
+    {
+        throw std::invalid_argument("Stale arena handle");
+    }
+
+    return b;
+}
+
+/**
+ * @brief Copy UBF buffer to the arena
+ * @param data UbfDict or dict
+ * @param refs initial reference count
+ * @return buffer handle
+ */
+uint64_t ndrxpy_ubfarena::put(py::object data, uint32_t refs)
+{
+    ndrxpy_arena_hdr_t *h = hdr();
+    atmibuf tmp;
+    UBFH *src;
+    uint32_t off;
+    ndrxpy_arena_blk_t *b;
+    char *ubf;
+
+    if (0==refs)
+    {
+        throw std::invalid_argument("refs must be greater than 0");
+    }
+
+    if (ndrxpy_is_UbfDict(data))
+    {
+        ndrx_longptr_t ptr = data.attr("_buf").cast<py::int_>();
+        src = *reinterpret_cast<atmibuf *>(ptr)->fbfr();
+    }
+    else if (py::isinstance<py::dict>(data))
+    {
+        tmp = atmibuf("UBF", 1024);
+        ndrxpy_from_py_ubf(static_cast<py::dict>(data), tmp);
+        src = *tmp.fbfr();
+    }
+    else
+    {
+        throw std::invalid_argument("Expected UbfDict or dict");
+    }
+
+    long used = Bused(src);
+
+    if (EXFAIL==used)
+    {
+        throw ubf_exception(Berror);
+    }
+
+    off = ndrxpy_arena_alloc(h, used);
+
+    if (0==off)
+    {
+        NDRX_LOG(log_error, "Arena full, cannot allocate %ld bytes", used);
+        throw atmi_exception(TPELIMIT);
+    }
+
+    b = ndrxpy_arena_blkat(h, off);
+    ubf = reinterpret_cast<char *>(b + 1);
+
+    if (EXSUCCEED!=Binit(reinterpret_cast<UBFH *>(ubf),
+            (static_cast<BFLDLEN>(1) << (b->cls+NDRXPY_ARENA_MINSHIFT)) -
+                sizeof(ndrxpy_arena_blk_t)) ||
+        EXSUCCEED!=Bcpy(reinterpret_cast<UBFH *>(ubf), src))
+    {
+        int err = Berror;
+        ndrxpy_arena_free(h, off);
+        throw ubf_exception(err);
+    }
+
+    /* publish the buffer */
+    b->handoff.store(refs, std::memory_order_relaxed);
+    b->refcnt.store(refs, std::memory_order_release);
+
+    return NDRXPY_ARENA_MK(b->gen.load(std::memory_order_relaxed), off);
+}
+
+/**
+ * @brief Take over one reference of the handle as UbfDict
+ * @param handle buffer handle
+ * @param copy return XATMI buffer copy instead of arena view
+ * @return UbfDict
+ */
+py::object ndrxpy_ubfarena::take(uint64_t handle, bool copy)
+{
+    ndrxpy_arena_hdr_t *h = hdr();
+    ndrxpy_arena_blk_t *b = blk(handle);
+    UBFH *ubf = reinterpret_cast<UBFH *>(b + 1);
+
+    /* reference now belongs to this call */
+    ndrxpy_arena_claim(b, handle);
+
+    if (copy)
+    {
+        atmibuf buf;
+
+        try
+        {
+            buf = atmibuf("UBF", Bused(ubf));
+
+            if (EXSUCCEED!=Bcpy(*buf.fbfr(), ubf))
+            {
+                throw ubf_exception(Berror);
+            }
+        }
+        catch (...)
+        {
+            ndrxpy_arena_unref(h, NDRXPY_ARENA_OFF(handle), 1);
+            throw;
+        }
+
+        ndrxpy_arena_unref(h, NDRXPY_ARENA_OFF(handle), 1);
+
+        long len = buf.len;
+        return ndrxpy_alloc_UbfDict(buf.release(), NDRXPY_SUBBUF_NORM, len);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(M_maps_mutex);
+        M_map->views++;
+    }
+
+    return ndrxpy_alloc_UbfDict(reinterpret_cast<char *>(ubf),
+            NDRXPY_SUBBUF_ARENA, Bsizeof(ubf));
+}
+
+/**
+ * @brief Add references to the handle, e.g. before passing it to
+ *  several receivers.
+ * @param handle buffer handle
+ * @param n references to add
+ */
+void ndrxpy_ubfarena::retain(uint64_t handle, uint32_t n)
+{
+    ndrxpy_arena_hdr_t *h = hdr();
+    ndrxpy_arena_blk_t *b = blk(handle);
+    uint32_t cnt = b->refcnt.load(std::memory_order_acquire);
+
+    if (0==n)
+    {
+        return;
+    }
+
+    do
+    {
+        if (0==cnt)
+        {
+            throw std::invalid_argument("Stale arena handle");
+        }
+    } while (!b->refcnt.compare_exchange_weak(cnt, cnt+n,
+                std::memory_order_acq_rel, std::memory_order_acquire));
+
+    /* block was freed and reused between validation and increment */
+    if (NDRXPY_ARENA_TAG(handle)!=b->gen.load(std::memory_order_acquire))
+    {
+        ndrxpy_arena_unref(h, NDRXPY_ARENA_OFF(handle), n);
+        throw std::invalid_argument("Stale arena handle");
+    }
+
+    b->handoff.fetch_add(n, std::memory_order_acq_rel);
+}
+
+/**
+ * @brief Drop one reference of the handle
+ * @param handle buffer handle
+ */
+void ndrxpy_ubfarena::release(uint64_t handle)
+{
+    ndrxpy_arena_hdr_t *h = hdr();
+    ndrxpy_arena_blk_t *b = blk(handle);
+
+    ndrxpy_arena_claim(b, handle);
+    ndrxpy_arena_unref(h, NDRXPY_ARENA_OFF(handle), 1);
+}
+
+/**
+ * @brief Arena usage
+ * @return dict of counters
+ */
+py::dict ndrxpy_ubfarena::stats(void)
+{
+    ndrxpy_arena_hdr_t *h = hdr();
+    py::dict ret;
+    uint64_t allocs = h->allocs.load(std::memory_order_relaxed);
+    uint64_t frees = h->frees.load(std::memory_order_relaxed);
+
+    ret["size"] = h->size;
+    ret["used"] = h->top.load(std::memory_order_relaxed);
+    ret["allocs"] = allocs;
+    ret["frees"] = frees;
+    ret["live"] = allocs - frees;
+
+    std::lock_guard<std::mutex> lock(M_maps_mutex);
+    ret["views"] = M_map->views;
+
+    return ret;
+}
+
+/**
+ * @brief Detach from the arena. Segment is unmapped when all
+ *  views of this process are freed.
+ */
+void ndrxpy_ubfarena::close(void)
+{
+    std::lock_guard<std::mutex> lock(M_maps_mutex);
+
+    if (nullptr!=M_map)
+    {
+        M_map->closed = true;
+        ndrxpy_arena_unmap(M_map);
+        M_map = nullptr;
+    }
+}
+
+/**
+ * @brief Remove the shared memory name
+ */
+void ndrxpy_ubfarena::unlink(void)
+{
+    if (EXSUCCEED!=shm_unlink(M_name.c_str()) && ENOENT!=errno)
+    {
+        NDRX_LOG(log_error, "shm_unlink [%s] failed: %s", M_name.c_str(), strerror(errno));
+        throw atmi_exception(TPEOS);
+    }
+}
+
+/**
+ * @brief Register UBF arena class
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_ubfarena(py::module &m)
+{
+    py::class_<ndrxpy_ubfarena>(m, "UbfArena", R"pbdoc(
+        Shared memory arena for passing UBF buffers between processes of the
+        same host without copying through the IPC queues. Buffer is copied
+        to the arena once by :meth:`put`, and the returned integer handle
+        (which may be sent in any message) is resolved by the receiver with
+        :meth:`take` to read-only :class:`.UbfDict` view of the arena memory.
+
+        Arena is POSIX shared memory segment, mapped by all processes.
+        Blocks are allocated in power of two size classes, by lock-free free
+        lists, so that senders and receivers do not lock each other. Each block
+        is reference counted; the handle is valid until all references are
+        released by :meth:`take` (when view is freed), or :meth:`release`.
+        References of processes which terminated without release are lost
+        until the segment is recreated.
+
+        View may be passed to :func:`.tpcall` and other XATMI calls directly
+        (it is copied to XATMI buffer at the call), or copied to modifiable
+        buffer by *UbfDict(view)* or *take(handle, copy=True)*.
+
+        .. code-block:: python
+            :caption: UbfArena example
+            :name: UbfArena-example
+
+                # producer
+                arena = e.UbfArena("/myapp", 64*1024*1024)
+                h = arena.put(e.UbfDict({"T_STRING_FLD": "HELLO"}))
+                e.tpcall("CONSUMER", {"T_LONG_FLD": h})
+
+                # consumer service
+                arena = e.UbfArena("/myapp")
+                view = arena.take(args.data["T_LONG_FLD"][0])
+                print(view["T_STRING_FLD"][0])
+
+        :raise AtmiException: 
+            | :data:`.TPENOENT` - Segment does not exist and *create* is **False**.
+            | :data:`.TPETIME` - Creator did not initialize the segment in time.
+            | :data:`.TPEOS` - Failed to open or map the shared memory.
+
+        Parameters
+        ----------
+        name : str
+            Shared memory name, e.g. "/myapp".
+        size : int
+            Segment size in bytes, used if segment is created.
+        create : bool
+            Create the segment if it does not exist.
+        )pbdoc")
+        .def(py::init([](const std::string &name, unsigned long size, bool create)
+            {
+                return std::unique_ptr<ndrxpy_ubfarena>(new ndrxpy_ubfarena(name,
+                    size, create));
+            }),
+            py::arg("name"), py::arg("size")=16777216, py::arg("create")=true)
+        .def("put", &ndrxpy_ubfarena::put, R"pbdoc(
+            Copy buffer to the arena.
+
+            :raise AtmiException: 
+                | :data:`.TPELIMIT` - Arena is full.
+                | :data:`.TPEPROTO` - Arena is closed.
+
+            :raise UbfException: 
+                | Failed to copy the buffer.
+
+            Parameters
+            ----------
+            data : UbfDict or dict
+                UBF buffer.
+            refs : int
+                Number of references, i.e. times the handle will be taken
+                or released.
+
+            Returns
+            -------
+            int
+                Buffer handle.
+            )pbdoc", py::arg("data"), py::arg("refs")=1)
+        .def("take", &ndrxpy_ubfarena::take, R"pbdoc(
+            Resolve handle to :class:`.UbfDict`. One reference of the handle
+            is owned by the returned object and released when it is freed.
+            Each reference given by *refs* of :meth:`put` (or added by
+            :meth:`retain`) is taken or released once.
+
+            :raise AtmiException: 
+                | :data:`.TPEPROTO` - Arena is closed.
+
+            :raise ValueError: 
+                | Handle is invalid, or all its references are released.
+
+            Parameters
+            ----------
+            handle : int
+                Buffer handle.
+            copy : bool
+                **False** - read-only view of the arena memory,
+                **True** - copy to new XATMI buffer and release the reference.
+
+            Returns
+            -------
+            UbfDict
+                Buffer.
+            )pbdoc", py::arg("handle"), py::arg("copy")=false)
+        .def("retain", &ndrxpy_ubfarena::retain, R"pbdoc(
+            Add references to the handle.
+
+            :raise ValueError: 
+                | Handle is invalid, or all its references are released.
+
+            Parameters
+            ----------
+            handle : int
+                Buffer handle.
+            n : int
+                References to add.
+            )pbdoc", py::arg("handle"), py::arg("n")=1)
+        .def("release", &ndrxpy_ubfarena::release, R"pbdoc(
+            Drop one reference of the handle. Block is freed when last
+            reference is dropped.
+
+            :raise ValueError: 
+                | Handle is invalid, or all its references are released.
+
+            Parameters
+            ----------
+            handle : int
+                Buffer handle.
+            )pbdoc", py::arg("handle"))
+        .def("stats", &ndrxpy_ubfarena::stats, R"pbdoc(
+            Return arena usage.
+
+            Returns
+            -------
+            dict
+                **size** - segment size, **used** - bytes carved to blocks,
+                **allocs**, **frees** - blocks allocated and freed by all
+                processes, **live** - blocks in use, **views** - views
+                alive in this process.
+            )pbdoc")
+        .def("close", &ndrxpy_ubfarena::close, R"pbdoc(
+            Detach from the arena. Memory stays mapped while views of
+            this process are alive.
+            )pbdoc")
+        .def("unlink", &ndrxpy_ubfarena::unlink, R"pbdoc(
+            Remove shared memory name. Processes attached keep using the
+            segment; new :class:`UbfArena` with the same name creates new segment.
+            )pbdoc");
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
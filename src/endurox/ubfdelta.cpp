@@ -0,0 +1,514 @@
+/**
+ * @brief Enduro/X Python module - UBF buffer field level delta
+ *
+ * @file ubfdelta.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <string>
+#include <vector>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+
+#define NDRXPY_DELTA_MAGIC      "UBFD"      /**< Delta image magic          */
+#define NDRXPY_DELTA_VERSION    1           /**< Delta format version       */
+#define NDRXPY_DELTA_ENDIAN     0x0102      /**< Byte order check           */
+
+#define NDRXPY_DELTA_ADD        1           /**< Occurrence added           */
+#define NDRXPY_DELTA_CHG        2           /**< Occurrence changed         */
+#define NDRXPY_DELTA_DEL        3           /**< Occurrences from occ removed*/
+
+/** Record header: op, fldid, occ, data len */
+#define NDRXPY_DELTA_RECHDR     (1+sizeof(int32_t)*2+sizeof(uint32_t))
+
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Delta image header, records follow
+ */
+typedef struct
+{
+    char magic[4];          /**< NDRXPY_DELTA_MAGIC                     */
+    uint16_t endian;        /**< NDRXPY_DELTA_ENDIAN                    */
+    uint8_t version;        /**< NDRXPY_DELTA_VERSION                   */
+    uint8_t longsz;         /**< sizeof(long) of producer               */
+} ndrxpy_delta_hdr_t;
+
+/**
+ * Buffer walk position
+ */
+struct ndrxpy_delta_cur_t
+{
+    UBFH *p_ub;
+    Bnext_state_t state;
+    BFLDID fldid;
+    BFLDOCC occ;
+    BFLDLEN len;
+    char *d_ptr;
+    bool eof;
+};
+
+/**
+ * Decoded delta record
+ */
+struct ndrxpy_delta_rec_t
+{
+    int op;
+    BFLDID fldid;
+    BFLDOCC occ;
+    uint32_t len;
+    const char *data;
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Step to next field occurrence
+ * @param cur walk position
+ */
+exprivate void ndrxpy_delta_next(ndrxpy_delta_cur_t &cur)
+{
+    int ret = Bnext2(&cur.state, cur.p_ub, &cur.fldid, &cur.occ, NULL,
+            &cur.len, &cur.d_ptr);
+
+    if (EXFAIL==ret)
+    {
+        throw ubf_exception(Berror);
+    }
+
+    cur.eof = (0==ret);
+
+    if (!cur.eof && BFLD_PTR==Bfldtype(cur.fldid))
+    {
+        char *name = ndrxpy_fldname(cur.fldid);
+
+        throw std::invalid_argument(std::string("BFLD_PTR field [")+
+            (nullptr!=name ? std::string(name) : std::to_string(cur.fldid))+
+            "] cannot be used in delta");
+    }
+}
+
+/**
+ * @brief Compare occurrences of the same field
+ * @return true if equal
+ */
+exprivate bool ndrxpy_delta_same(ndrxpy_delta_cur_t &a, ndrxpy_delta_cur_t &b)
+{
+    switch (Bfldtype(a.fldid))
+    {
+        case BFLD_UBF:
+            return 0==Bcmp(reinterpret_cast<UBFH *>(a.d_ptr),
+                reinterpret_cast<UBFH *>(b.d_ptr));
+        case BFLD_VIEW:
+        {
+            BVIEWFLD *va = reinterpret_cast<BVIEWFLD *>(a.d_ptr);
+            BVIEWFLD *vb = reinterpret_cast<BVIEWFLD *>(b.d_ptr);
+
+            return a.len==b.len && 0==strcmp(va->vname, vb->vname) &&
+                0==memcmp(va->data, vb->data, a.len);
+        }
+        default:
+            return a.len==b.len && 0==memcmp(a.d_ptr, b.d_ptr, a.len);
+    }
+}
+
+/**
+ * @brief Append record to the delta
+ * @param out delta image
+ * @param op operation
+ * @param cur occurrence, data is taken for add/change
+ */
+exprivate void ndrxpy_delta_put(std::string &out, uint8_t op, BFLDID fldid,
+        BFLDOCC occ, ndrxpy_delta_cur_t *cur)
+{
+    int32_t fld32 = fldid;
+    int32_t occ32 = occ;
+    uint32_t len = 0;
+    const char *data = nullptr;
+    BVIEWFLD *vf = nullptr;
+
+    if (nullptr!=cur)
+    {
+        switch (Bfldtype(fldid))
+        {
+            case BFLD_UBF:
+                data = cur->d_ptr;
+                len = Bused(reinterpret_cast<UBFH *>(cur->d_ptr));
+                break;
+            case BFLD_VIEW:
+                /* view name, then view data */
+                vf = reinterpret_cast<BVIEWFLD *>(cur->d_ptr);
+                len = sizeof(vf->vname) + cur->len;
+                break;
+            default:
+                data = cur->d_ptr;
+                len = cur->len;
+                break;
+        }
+    }
+
+    out.append(reinterpret_cast<char *>(&op), 1);
+    out.append(reinterpret_cast<char *>(&fld32), sizeof(fld32));
+    out.append(reinterpret_cast<char *>(&occ32), sizeof(occ32));
+    out.append(reinterpret_cast<char *>(&len), sizeof(len));
+
+    if (nullptr!=vf)
+    {
+        out.append(vf->vname, sizeof(vf->vname));
+
+        if (cur->len > 0)
+        {
+            out.append(vf->data, cur->len);
+        }
+    }
+    else if (nullptr!=data)
+    {
+        out.append(data, len);
+    }
+}
+
+/**
+ * @brief Compute delta which turns buffer a into buffer b. Both buffers
+ *  are walked once, in field id order.
+ * @param a old buffer
+ * @param b new buffer
+ * @param out delta image
+ */
+exprivate void ndrxpy_delta_diff(UBFH *a, UBFH *b, std::string &out)
+{
+    ndrxpy_delta_cur_t ca, cb;
+    ndrxpy_delta_hdr_t hdr;
+
+    memcpy(hdr.magic, NDRXPY_DELTA_MAGIC, sizeof(hdr.magic));
+    hdr.endian = NDRXPY_DELTA_ENDIAN;
+    hdr.version = NDRXPY_DELTA_VERSION;
+    hdr.longsz = sizeof(long);
+    out.append(reinterpret_cast<char *>(&hdr), sizeof(hdr));
+
+    ca.p_ub = a;
+    ca.fldid = BFIRSTFLDID;
+    cb.p_ub = b;
+    cb.fldid = BFIRSTFLDID;
+
+    ndrxpy_delta_next(ca);
+    ndrxpy_delta_next(cb);
+
+    while (!ca.eof || !cb.eof)
+    {
+        if (!ca.eof && !cb.eof && ca.fldid==cb.fldid)
+        {
+            /* occurrences are walked in pairs, thus occ is the same */
+            if (!ndrxpy_delta_same(ca, cb))
+            {
+                ndrxpy_delta_put(out, NDRXPY_DELTA_CHG, cb.fldid, cb.occ, &cb);
+            }
+
+            ndrxpy_delta_next(ca);
+            ndrxpy_delta_next(cb);
+        }
+        else if (cb.eof || (!ca.eof && ca.fldid < cb.fldid))
+        {
+            /* rest of a occurrences are removed */
+            BFLDID fldid = ca.fldid;
+
+            ndrxpy_delta_put(out, NDRXPY_DELTA_DEL, fldid, ca.occ, nullptr);
+
+            do
+            {
+                ndrxpy_delta_next(ca);
+            } while (!ca.eof && ca.fldid==fldid);
+        }
+        else
+        {
+            ndrxpy_delta_put(out, NDRXPY_DELTA_ADD, cb.fldid, cb.occ, &cb);
+            ndrxpy_delta_next(cb);
+        }
+    }
+}
+
+/**
+ * @brief Validate delta image header
+ * @param data delta image
+ * @param len image len
+ */
+exprivate void ndrxpy_delta_check(const char *data, size_t len)
+{
+    ndrxpy_delta_hdr_t hdr;
+
+    if (len < sizeof(hdr))
+    {
+        throw std::invalid_argument("Invalid UBF delta size");
+    }
+
+    memcpy(&hdr, data, sizeof(hdr));
+
+    if (0!=memcmp(hdr.magic, NDRXPY_DELTA_MAGIC, sizeof(hdr.magic)) ||
+            NDRXPY_DELTA_VERSION!=hdr.version)
+    {
+        throw std::invalid_argument("Invalid UBF delta header");
+    }
+
+    if (NDRXPY_DELTA_ENDIAN!=hdr.endian || sizeof(long)!=hdr.longsz)
+    {
+        throw std::invalid_argument("UBF delta from incompatible platform");
+    }
+}
+
+/**
+ * @brief Decode next delta record
+ * @param data delta image
+ * @param len image len
+ * @param pos current offset, moved to the next record
+ * @param rec decoded record
+ * @return false if no more records
+ */
+exprivate bool ndrxpy_delta_rec(const char *data, size_t len, size_t &pos,
+        ndrxpy_delta_rec_t &rec)
+{
+    int32_t v;
+
+    if (pos==len)
+    {
+        return false;
+    }
+
+    if (len - pos < NDRXPY_DELTA_RECHDR)
+    {
+        throw std::invalid_argument("Truncated UBF delta");
+    }
+
+    rec.op = static_cast<uint8_t>(data[pos]);
+    memcpy(&v, data+pos+1, sizeof(v));
+    rec.fldid = v;
+    memcpy(&v, data+pos+1+sizeof(v), sizeof(v));
+    rec.occ = v;
+    memcpy(&rec.len, data+pos+1+sizeof(v)*2, sizeof(rec.len));
+    pos+=NDRXPY_DELTA_RECHDR;
+
+    if (len - pos < rec.len || rec.op < NDRXPY_DELTA_ADD ||
+            rec.op > NDRXPY_DELTA_DEL || rec.occ < 0)
+    {
+        throw std::invalid_argument("Invalid UBF delta record");
+    }
+
+    rec.data = data+pos;
+    pos+=rec.len;
+
+    return true;
+}
+
+/**
+ * @brief Apply delta records to the buffer
+ * @param buf UBF buffer
+ * @param data delta image
+ * @param len image len
+ */
+exprivate void ndrxpy_delta_apply(atmibuf &buf, const char *data, size_t len)
+{
+    size_t pos = sizeof(ndrxpy_delta_hdr_t);
+    ndrxpy_delta_rec_t rec;
+    /* record data is not aligned in the image */
+    std::vector<long> tmp;
+
+    while (ndrxpy_delta_rec(data, len, pos, rec))
+    {
+        if (NDRXPY_DELTA_DEL==rec.op)
+        {
+            BFLDOCC occ = Boccur(*buf.fbfr(), rec.fldid);
+
+            while (occ > rec.occ)
+            {
+                occ--;
+
+                if (EXSUCCEED!=Bdel(*buf.fbfr(), rec.fldid, occ))
+                {
+                    throw ubf_exception(Berror);
+                }
+            }
+            continue;
+        }
+
+        tmp.resize(rec.len/sizeof(long)+1);
+        memcpy(tmp.data(), rec.data, rec.len);
+
+        char *val = reinterpret_cast<char *>(tmp.data());
+        BFLDLEN vlen = rec.len;
+        BVIEWFLD vf;
+
+        if (BFLD_VIEW==Bfldtype(rec.fldid))
+        {
+            if (rec.len < sizeof(vf.vname))
+            {
+                throw std::invalid_argument("Invalid UBF delta record");
+            }
+
+            memset(&vf, 0, sizeof(vf));
+            memcpy(vf.vname, val, sizeof(vf.vname));
+            vf.vname[sizeof(vf.vname)-1] = EXEOS;
+            vf.data = val + sizeof(vf.vname);
+            val = reinterpret_cast<char *>(&vf);
+            vlen = 0;
+        }
+
+        buf.mutate([&](UBFH *fbfr)
+            {
+                return Bchg(fbfr, rec.fldid, rec.occ, val, vlen);
+            }, nullptr);
+    }
+}
+
+/**
+ * @brief Register UBF delta functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_ubfdelta(py::module &m)
+{
+    m.def(
+        "UbfDict_diff",
+        [](ndrx_longptr_t ptr1, ndrx_longptr_t ptr2)
+        {
+            atmibuf *buf1 = reinterpret_cast<atmibuf *>(ptr1);
+            atmibuf *buf2 = reinterpret_cast<atmibuf *>(ptr2);
+            std::string out;
+
+            {
+                py::gil_scoped_release release;
+                ndrxpy_delta_diff(*buf1->fbfr(), *buf2->fbfr(), out);
+            }
+
+            return py::bytes(out);
+        },
+        R"pbdoc(
+        Compute field level delta between two UBF buffers.
+
+        Parameters
+        ----------
+        ptr1: int
+            C pointer to atmibuf, old buffer
+        ptr2: int
+            C pointer to atmibuf, new buffer
+
+        Returns
+        -------
+        ret : bytes
+            Delta image
+
+        )pbdoc", py::arg("ptr1"), py::arg("ptr2"));
+
+    m.def(
+        "UbfDict_apply",
+        [](ndrx_longptr_t ptr, py::buffer delta)
+        {
+            atmibuf *buf = reinterpret_cast<atmibuf *>(ptr);
+            py::buffer_info info = delta.request();
+            const char *data = reinterpret_cast<const char *>(info.ptr);
+            size_t len = info.size * info.itemsize;
+
+            ndrxpy_delta_check(data, len);
+
+            py::gil_scoped_release release;
+            ndrxpy_delta_apply(*buf, data, len);
+        },
+        R"pbdoc(
+        Apply delta produced by :func:`UbfDict_diff` to UBF buffer.
+
+        Parameters
+        ----------
+        ptr: int
+            C pointer to atmibuf
+        delta: bytes
+            Delta image
+
+        )pbdoc", py::arg("ptr"), py::arg("delta"));
+
+    m.def(
+        "UbfDict_delta_items",
+        [](py::buffer delta)
+        {
+            py::buffer_info info = delta.request();
+            const char *data = reinterpret_cast<const char *>(info.ptr);
+            size_t len = info.size * info.itemsize;
+            size_t pos = sizeof(ndrxpy_delta_hdr_t);
+            ndrxpy_delta_rec_t rec;
+            static const char *ops[] = {"", "add", "chg", "del"};
+            py::list ret;
+
+            ndrxpy_delta_check(data, len);
+
+            while (ndrxpy_delta_rec(data, len, pos, rec))
+            {
+                char *name = ndrxpy_fldname(rec.fldid);
+
+                ret.append(py::make_tuple(ops[rec.op],
+                    nullptr!=name ? py::object(py::str(name)) : py::object(py::int_(rec.fldid)),
+                    rec.occ));
+            }
+
+            return ret;
+        },
+        R"pbdoc(
+        List delta records.
+
+        Parameters
+        ----------
+        delta: bytes
+            Delta image
+
+        Returns
+        -------
+        ret : list
+            Tuples of (operation, field, occurrence).
+
+        )pbdoc", py::arg("delta"));
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
@@ -1,3 +1,4 @@
+import pickle
 from collections.abc import MutableMapping
 from collections.abc import MutableSequence
 from .endurox import *
@@ -14,6 +15,12 @@ class UbfDictConst:
     # This is PTR buffer
     NDRXPY_SUBBUF_PTR   = 2
 
+    # UBF in shared memory arena
+    NDRXPY_SUBBUF_ARENA = 3
+
+    # Read only buffers
+    NDRXPY_SUBBUF_RO    = (NDRXPY_SUBBUF_UBF, NDRXPY_SUBBUF_ARENA)
+
 # UBF Dictionary field, kind of array
 class UbfDictFld(MutableSequence):
     """Access to UBF field dictionary. Provides
@@ -79,7 +86,7 @@ class UbfDictFld(MutableSequence):
         """
 
         # Validate the parent buffer
-        if self._ubf_dict._is_sub_buffer==UbfDictConst.NDRXPY_SUBBUF_UBF:
+        if self._ubf_dict._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
             raise AttributeError('Cannot change sub-buffer')
 
         return UbfDictFld_del(self, i)
@@ -120,7 +127,7 @@ class UbfDictFld(MutableSequence):
         """
 
         # Validate the parent buffer
-        if self._ubf_dict._is_sub_buffer==UbfDictConst.NDRXPY_SUBBUF_UBF:
+        if self._ubf_dict._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
             raise AttributeError('Cannot change sub-buffer')
 
         return UbfDictFld_set(self, i, value)
@@ -146,7 +153,7 @@ class UbfDictFld(MutableSequence):
         """
 
         # Validate the parent buffer
-        if self._ubf_dict._is_sub_buffer==UbfDictConst.NDRXPY_SUBBUF_UBF:
+        if self._ubf_dict._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
             raise AttributeError('Cannot change sub-buffer')
 
         return UbfDictFld_set(self, i, value)
@@ -314,6 +321,29 @@ class UbfDictItemsOcc:
         """
         return UbfDict_len_occ(self._buf)
 
+# Field name to id, loaded by modules generated by mkfldpy
+_fldtab = {}
+
+def fldtab_load(ids):
+    """Register field name to id table. Attribute access of :class:`UbfDict`
+    fields registered here resolves the id by dictionary lookup, and native
+    field name resolution uses the table before the UBF field tables.
+    Called by field modules generated by **mkfldpy(8)** at import time.
+
+    Parameters
+    ----------
+    ids: dict
+        Field name to field id.
+    """
+    _fldtab.update(ids)
+    ndrxpy_fldtab_load(ids)
+
+def _ubfdict_from_raw(hdr, raw):
+    """Unpickle UbfDict from raw UBF image, see :func:`UbfDict.__reduce_ex__`"""
+    inst = UbfDict(False)
+    inst._buf = UbfDict_from_raw(hdr, raw)
+    return inst
+
 # UBF <-> Dictionary mapping
 class UbfDict(MutableMapping):
     """UBF Based dictionary, direct access to fields
@@ -478,7 +508,7 @@ class UbfDict(MutableMapping):
                 See logs i.e. user log, or debugs for more info.
         """
         # validate the parent buffer
-        if self._is_sub_buffer==UbfDictConst.NDRXPY_SUBBUF_UBF:
+        if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
             raise AttributeError('Cannot change sub-buffer')
 
         UbfDict_set(self._buf, key, value)
@@ -506,7 +536,7 @@ class UbfDict(MutableMapping):
         """
 
         # validate the parent buffer
-        if self._is_sub_buffer==UbfDictConst.NDRXPY_SUBBUF_UBF:
+        if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
             raise AttributeError('Cannot change sub-buffer')
 
         return UbfDict_del(self._buf, key)
@@ -638,6 +668,40 @@ class UbfDict(MutableMapping):
         inst._buf = UbfDict_copy(self._buf)
         return inst
 
+    # Pickle as raw UBF image
+    def __reduce_ex__(self, protocol):
+        """Pickle support. Used part of the UBF buffer is serialized as raw
+        image with version/byte order header, thus unpickling costs single
+        buffer allocation and memory copy. With pickle protocol 5 image is
+        passed as out-of-band :class:`pickle.PickleBuffer` (no copy while
+        pickling). Buffer shall not be modified while out-of-band buffers
+        are in use. Buffers with :data:`.BFLD_PTR` fields are pickled in
+        dictionary form, as pointers are not valid in other processes.
+        Image may be unpickled only on platform with the same byte order
+        and word size.
+
+        Parameters
+        ----------
+        protocol: int
+            Pickle protocol version
+
+        Returns
+        -------
+        ret : tuple
+            Reconstruction function and arguments.
+        """
+        hdr, raw = UbfDict_raw(self)
+
+        if hdr is None:
+            return (UbfDict, (self.to_dict(),))
+
+        if protocol >= 5:
+            raw = pickle.PickleBuffer(raw)
+        else:
+            raw = bytes(raw)
+
+        return (_ubfdict_from_raw, (hdr, raw))
+
     # manual free up of the buffer
     def free(self):
         """Free linked XATMI buffer. Does nothing for sub-ubf buffers.
@@ -709,9 +773,261 @@ class UbfDict(MutableMapping):
         """
         return UbfDict_to_dict(self, self._buf)
 
+    # Build UbfDict from JSON text
+    @staticmethod
+    def from_json(data):
+        """Parse JSON object directly to new UBF buffer, without building
+        Python objects. Object members are field names; array values are
+        loaded as field occurrences, **null** values are skipped. Numbers are
+        converted according to the field type, integers are loaded to
+        integer fields without floating point conversion, and for string fields
+        number text is loaded as is. :data:`.BFLD_CARRAY` values are base64
+        encoded strings, :data:`.BFLD_UBF` values are objects.
+        :data:`.BFLD_VIEW` and :data:`.BFLD_PTR` fields are not supported.
+
+        Parameters
+        ----------
+        data: bytes
+            JSON text, bytes, bytearray, memoryview or str.
+
+        Returns
+        -------
+        ret : UbfDict
+            New buffer.
+
+        Raises
+        ------
+        ValueError
+            Invalid JSON text (error message contains offset), or value does not
+            match the field type.
+        KeyError
+            Field name not found.
+        UbfException
+            Following error codes may be present:
+            :data:`.BFTOPEN` - Failed to open field definition files.
+        """
+        inst = UbfDict(False)
+        inst._buf = UbfDict_from_json(data)
+        return inst
+
+    # Write UbfDict as JSON text
+    def to_json(self, out=None):
+        """Write the buffer as JSON object, in format accepted by :func:`from_json`.
+        Fields with single occurrence are written as values, several occurrences
+        as arrays. Output is written directly to the bytearray, without
+        building Python objects.
+
+        Parameters
+        ----------
+        out: bytearray
+            If set, JSON text is appended to this bytearray.
+
+        Returns
+        -------
+        ret : bytearray
+            JSON text (UTF-8), *out* if given.
+
+        Raises
+        ------
+        ValueError
+            Buffer contains :data:`.BFLD_VIEW` or :data:`.BFLD_PTR` fields,
+            or non finite (NaN, infinity) float or double values.
+        UbfException
+            Following error codes may be present:
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        return UbfDict_to_json(self._buf, out)
+
+    # Bulk update from other buffer
+    def update(self, *args, **kwargs):
+        """Update the buffer. If single :class:`UbfDict` is given, fields are
+        updated natively by **Bupdate(3)** in single call, i.e. occurrences
+        present in *other* are changed or added, the rest are kept. Otherwise
+        :meth:`MutableMapping.update` is used.
+
+        Parameters
+        ----------
+        other: UbfDict
+            Buffer from which to take the fields.
+
+        Raises
+        ------
+        UbfException
+            Following error codes may be present:
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        if len(args) == 1 and not kwargs and isinstance(args[0], UbfDict):
+
+            if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
+                raise AttributeError('Cannot change sub-buffer')
+
+            UbfDict_update(self._buf, args[0]._buf)
+        else:
+            super().update(*args, **kwargs)
+
+    # Add all occurrences of other buffer
+    def concat(self, other):
+        """Add all field occurrences of *other* buffer to this buffer
+        (**Bconcat(3)**), in single call.
+
+        Parameters
+        ----------
+        other: UbfDict
+            Buffer from which to take the fields.
+
+        Raises
+        ------
+        UbfException
+            Following error codes may be present:
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
+            raise AttributeError('Cannot change sub-buffer')
+
+        UbfDict_concat(self._buf, other._buf)
+
+    # Keep only given fields
+    def project(self, fields, copy=False):
+        """Keep only given fields in the buffer (**Bproj(3)**), or with *copy*
+        return new buffer with given fields (**Bprojcpy(3)**).
+
+        Parameters
+        ----------
+        fields: list
+            Field names or field ids.
+        copy: bool
+            If **True**, this buffer is not changed, new buffer is returned.
+
+        Returns
+        -------
+        ret : UbfDict
+            New buffer with *copy*, otherwise this buffer.
+
+        Raises
+        ------
+        KeyError
+            Field name not found.
+        UbfException
+            Following error codes may be present:
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        if copy:
+            inst = UbfDict(False)
+            inst._buf = UbfDict_projcpy(self._buf, fields)
+            return inst
+
+        if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
+            raise AttributeError('Cannot change sub-buffer')
+
+        UbfDict_project(self._buf, fields)
+        return self
+
+    # Remove given fields
+    def delete_fields(self, fields):
+        """Delete all occurrences of given fields (**Bdelete(3)**), in single
+        call. Fields not present in the buffer are ignored.
+
+        Parameters
+        ----------
+        fields: list
+            Field names or field ids.
+
+        Raises
+        ------
+        KeyError
+            Field name not found.
+        UbfException
+            Following error codes may be present:
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
+            raise AttributeError('Cannot change sub-buffer')
+
+        UbfDict_delete_fields(self._buf, fields)
+
+    # Field level delta
+    def diff(self, other):
+        """Compute delta which turns this buffer into *other*. Buffers are
+        compared field by field, occurrence by occurrence. Delta contains
+        added and changed occurrences (with the new values) and removed
+        occurrences. Delta is binary image, which may be stored or sent to
+        other process and applied there with :func:`apply` (on platform with
+        the same byte order and word size).
+
+        Parameters
+        ----------
+        other: UbfDict
+            New version of the buffer.
+
+        Returns
+        -------
+        ret : bytes
+            Delta image, see :func:`delta_items` for the contents.
+
+        Raises
+        ------
+        ValueError
+            Buffers contain :data:`.BFLD_PTR` fields.
+        UbfException
+            Following error codes may be present:
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        return UbfDict_diff(self._buf, other._buf)
+
+    # Apply field level delta
+    def apply(self, delta):
+        """Apply delta produced by :func:`diff` to this buffer.
+
+        Parameters
+        ----------
+        delta: bytes
+            Delta image.
+
+        Raises
+        ------
+        ValueError
+            Invalid delta image.
+        UbfException
+            Following error codes may be present:
+            :data:`.BBADFLD` - Field not found in the buffer.
+            :data:`.BALIGNERR` - Corrupted UBF buffer.
+            :data:`.BNOTFLD` - Buffer not UBF.
+        """
+        # validate the parent buffer
+        if self._is_sub_buffer in UbfDictConst.NDRXPY_SUBBUF_RO:
+            raise AttributeError('Cannot change sub-buffer')
+
+        UbfDict_apply(self._buf, delta)
+
+    # Delta contents
+    @staticmethod
+    def delta_items(delta):
+        """List records of the delta produced by :func:`diff`.
+
+        Parameters
+        ----------
+        delta: bytes
+            Delta image.
+
+        Returns
+        -------
+        ret : list
+            Tuples of (operation, field name, occurrence). Operation is **add**,
+            **chg** or **del** - occurrences from given occurrence are removed.
+        """
+        return UbfDict_delta_items(delta)
+
     # access as attribs
     def __getattr__(self, attr):
         """Access to UBF field values as of class attributes.
+        Fields loaded by :func:`fldtab_load` (modules generated by **mkfldpy**)
+        are accessed by field id, without field name resolution.
         Attributed names **__is_sub_buffer** and **_buf** are
         reserved for internal purpose only.
         If such name shall be read from UBF buffer, access them by
@@ -737,7 +1053,7 @@ class UbfDict(MutableMapping):
         elif attr=="_buf":
             super(UbfDict, self).__getattr__(attr)
         else:
-            return self[attr]
+            return self[_fldtab.get(attr, attr)]
 
     # access as attribs
     def __setattr__(self, attr, value):
@@ -790,7 +1106,7 @@ class UbfDict(MutableMapping):
         elif attr=="_buf":
             super(UbfDict, self).__setattr__(attr, value)
         else:
-            self[attr] = value
+            self[_fldtab.get(attr, attr)] = value
 
     # delete attribute
     def __delattr__(self, name):
@@ -813,6 +1129,6 @@ class UbfDict(MutableMapping):
             :data:`.BNOTFLD` - Buffer not UBF.
             :data:`.BBADFLD` - Invalid field ID given (normally would not be thrown).
         """
-        self.__delitem__(name)
+        self.__delitem__(_fldtab.get(name, name))
 
 # vim: set ts=4 sw=4 et smartindent:
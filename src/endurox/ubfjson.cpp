@@ -0,0 +1,1116 @@
+/**
+ * @brief Enduro/X Python module - JSON transcoder for UBF buffers
+ *
+ * @file ubfjson.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+
+#define NDRXPY_JSON_MAXDEPTH    64          /**< Max nested UBF objects     */
+
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * JSON text to UBF reader. Values are added to the buffer as parsed,
+ * numbers are converted according to the field type.
+ */
+class ndrxpy_json_reader
+{
+public:
+
+    ndrxpy_json_reader(const char *data, size_t len)
+        : M_start(data), M_p(data), M_end(data+len) {}
+
+    void parse(atmibuf &buf);
+
+private:
+
+    [[noreturn]] void fail(const std::string &msg);
+    void ws(void);
+    bool literal(const char *lit);
+    void object(atmibuf &buf, int depth);
+    void value(atmibuf &buf, BFLDID fldid, Bfld_loc_info_t *loc, int depth);
+    void string(std::string &out);
+    void number(atmibuf &buf, BFLDID fldid, Bfld_loc_info_t *loc);
+    void add(atmibuf &buf, BFLDID fldid, const char *val, BFLDLEN len,
+        int usrtype, Bfld_loc_info_t *loc);
+
+    const char *M_start;
+    const char *M_p;
+    const char *M_end;
+    std::string M_str;          /**< Decoded string value               */
+};
+
+/**
+ * UBF to JSON text writer. Output goes directly to the bytearray.
+ */
+class ndrxpy_json_writer
+{
+public:
+
+    ndrxpy_json_writer(PyObject *out);
+
+    void ubf(UBFH *p_ub, int depth);
+    void finish(void);
+    void rollback(void);
+
+private:
+
+    void reserve(size_t n);
+    void put(const char *s, size_t len);
+    void put(char c);
+    void string(const char *s, size_t len);
+    void base64(const char *s, size_t len);
+    void real(BFLDID fldid, double v, int minprec, int maxprec, bool is_float);
+    void value(BFLDID fldid, char *d_ptr, BFLDLEN len, int depth);
+
+    PyObject *M_out;
+    char *M_p;
+    size_t M_start;             /**< Size of out before writing         */
+    size_t M_len;
+    size_t M_cap;
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+exprivate const char M_b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Field name for error messages
+ * @param fldid field id
+ * @return field name, or numeric id if name is not found
+ */
+exprivate std::string ndrxpy_json_fldname(BFLDID fldid)
+{
+    char *name = ndrxpy_fldname(fldid);
+
+    return nullptr!=name ? std::string(name) : std::to_string(fldid);
+}
+
+/**
+ * @brief Report parse error with the position
+ * @param msg error message
+ */
+void ndrxpy_json_reader::fail(const std::string &msg)
+{
+    std::string err = "JSON: "+msg+" at offset "+std::to_string(M_p-M_start);
+    UBF_LOG(log_error, "%s", err.c_str());
+    throw std::invalid_argument(err);
+}
+
+/**
+ * @brief Skip white space
+ */
+void ndrxpy_json_reader::ws(void)
+{
+    while (M_p < M_end && (' '==*M_p || '\t'==*M_p || '\n'==*M_p || '\r'==*M_p))
+    {
+        M_p++;
+    }
+}
+
+/**
+ * @brief Match literal (true, false, null)
+ * @param lit literal text
+ * @return true if matched and consumed
+ */
+bool ndrxpy_json_reader::literal(const char *lit)
+{
+    size_t len = strlen(lit);
+
+    if (static_cast<size_t>(M_end-M_p) >= len && 0==memcmp(M_p, lit, len))
+    {
+        M_p+=len;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Parse top level object into the buffer
+ * @param buf UBF buffer
+ */
+void ndrxpy_json_reader::parse(atmibuf &buf)
+{
+    ws();
+    object(buf, 0);
+    ws();
+
+    if (M_p!=M_end)
+    {
+        fail("trailing data");
+    }
+}
+
+/**
+ * @brief Add field occurrence, grow the buffer if needed
+ */
+void ndrxpy_json_reader::add(atmibuf &buf, BFLDID fldid, const char *val,
+        BFLDLEN len, int usrtype, Bfld_loc_info_t *loc)
+{
+    buf.mutate([&](UBFH *fbfr)
+        {
+            return CBaddfast(fbfr, fldid, const_cast<char *>(val), len, usrtype, loc);
+        }, loc);
+}
+
+/**
+ * @brief Parse object, members are fields
+ * @param buf UBF buffer where to add fields
+ * @param depth nesting level
+ */
+void ndrxpy_json_reader::object(atmibuf &buf, int depth)
+{
+    Bfld_loc_info_t loc;
+    BFLDID max_seen = EXFAIL;
+
+    if (depth > NDRXPY_JSON_MAXDEPTH)
+    {
+        fail("nesting too deep");
+    }
+
+    if (M_p>=M_end || '{'!=*M_p)
+    {
+        fail("expected object");
+    }
+
+    M_p++;
+    ws();
+    memset(&loc, 0, sizeof(loc));
+
+    if (M_p < M_end && '}'==*M_p)
+    {
+        M_p++;
+        return;
+    }
+
+    while (true)
+    {
+        if (M_p>=M_end || '"'!=*M_p)
+        {
+            fail("expected field name");
+        }
+
+        string(M_str);
+
+        BFLDID fldid = ndrxpy_fldid(M_str.c_str());
+
+        if (BBADFLDID==fldid)
+        {
+            char msgbuf[256];
+
+            snprintf(msgbuf, sizeof(msgbuf), 
+                "Failed to resolve field [%s]: %s", M_str.c_str(), Bstrerror(Berror));
+            UBF_LOG(log_warn, "%s", msgbuf);
+            throw py::key_error(msgbuf);
+        }
+
+        /* same fast add location rules as for dict */
+        if (fldid!=loc.last_Baddfast && !(max_seen==loc.last_Baddfast && fldid > max_seen))
+        {
+            memset(&loc, 0, sizeof(loc));
+        }
+
+        if (fldid>max_seen)
+        {
+            max_seen = fldid;
+        }
+
+        ws();
+
+        if (M_p>=M_end || ':'!=*M_p)
+        {
+            fail("expected ':'");
+        }
+
+        M_p++;
+        ws();
+
+        if (M_p < M_end && '['==*M_p)
+        {
+            /* occurrences */
+            M_p++;
+            ws();
+
+            if (M_p < M_end && ']'==*M_p)
+            {
+                M_p++;
+            }
+            else
+            {
+                while (true)
+                {
+                    ws();
+
+                    if (M_p < M_end && '['==*M_p)
+                    {
+                        fail("nested arrays are not supported");
+                    }
+
+                    value(buf, fldid, &loc, depth);
+                    ws();
+
+                    if (M_p < M_end && ','==*M_p)
+                    {
+                        M_p++;
+                    }
+                    else if (M_p < M_end && ']'==*M_p)
+                    {
+                        M_p++;
+                        break;
+                    }
+                    else
+                    {
+                        fail("expected ',' or ']'");
+                    }
+                }
+            }
+        }
+        else
+        {
+            value(buf, fldid, &loc, depth);
+        }
+
+        ws();
+
+        if (M_p < M_end && ','==*M_p)
+        {
+            M_p++;
+            ws();
+        }
+        else if (M_p < M_end && '}'==*M_p)
+        {
+            M_p++;
+            break;
+        }
+        else
+        {
+            fail("expected ',' or '}'");
+        }
+    }
+}
+
+/**
+ * @brief Parse single value and add it as next occurrence of the field
+ * @param buf UBF buffer
+ * @param fldid field id
+ * @param loc fast add location
+ * @param depth nesting level
+ */
+void ndrxpy_json_reader::value(atmibuf &buf, BFLDID fldid,
+        Bfld_loc_info_t *loc, int depth)
+{
+    int type = Bfldtype(fldid);
+
+    if (M_p>=M_end)
+    {
+        fail("unexpected end of data");
+    }
+
+    if ('"'==*M_p)
+    {
+        string(M_str);
+
+        if (BFLD_CARRAY==type)
+        {
+            /* binary data is base64 encoded */
+            std::string bin;
+            unsigned int acc = 0;
+            int bits = 0;
+
+            for (unsigned char c : M_str)
+            {
+                const char *pos;
+
+                if ('='==c)
+                {
+                    break;
+                }
+                else if (EXEOS==c || nullptr==(pos=strchr(M_b64, c)))
+                {
+                    fail("invalid base64 data");
+                }
+
+                acc = (acc << 6) | static_cast<unsigned int>(pos-M_b64);
+                bits+=6;
+
+                if (bits >= 8)
+                {
+                    bits-=8;
+                    bin.push_back(static_cast<char>((acc >> bits) & 0xFF));
+                }
+            }
+
+            add(buf, fldid, bin.data(), bin.size(), BFLD_CARRAY, loc);
+        }
+        else if (BFLD_UBF==type || BFLD_VIEW==type || BFLD_PTR==type)
+        {
+            fail("string value for non data field");
+        }
+        else
+        {
+            /* converted by UBF, as for str values */
+            add(buf, fldid, M_str.data(), M_str.size(), BFLD_CARRAY, loc);
+        }
+    }
+    else if ('{'==*M_p)
+    {
+        if (BFLD_UBF!=type)
+        {
+            fail("object value for non BFLD_UBF field");
+        }
+
+        atmibuf sub("UBF", 1024);
+        object(sub, depth+1);
+        buf.mutate([&](UBFH *fbfr)
+            {
+                return Baddfast(fbfr, fldid, *sub.pp, 0, loc);
+            }, loc);
+    }
+    else if ('-'==*M_p || (*M_p >= '0' && *M_p <= '9'))
+    {
+        number(buf, fldid, loc);
+    }
+    else if ('t'==*M_p || 'f'==*M_p)
+    {
+        long val = ('t'==*M_p);
+
+        if (!literal(val?"true":"false"))
+        {
+            fail("unexpected character");
+        }
+
+        if (BFLD_UBF==type || BFLD_VIEW==type || BFLD_PTR==type)
+        {
+            fail("boolean value for non data field");
+        }
+
+        add(buf, fldid, reinterpret_cast<char *>(&val), 0, BFLD_LONG, loc);
+    }
+    else if (literal("null"))
+    {
+        /* no occurrence, as for None */
+    }
+    else
+    {
+        fail("unexpected character");
+    }
+}
+
+/**
+ * @brief Parse string, decode escapes to UTF-8
+ * @param out decoded string
+ */
+void ndrxpy_json_reader::string(std::string &out)
+{
+    const char *seg;
+
+    out.clear();
+    M_p++;
+
+    while (true)
+    {
+        seg = M_p;
+
+        while (M_p < M_end && '"'!=*M_p && '\\'!=*M_p)
+        {
+            if (static_cast<unsigned char>(*M_p) < 0x20)
+            {
+                fail("control character in string");
+            }
+            M_p++;
+        }
+
+        out.append(seg, M_p-seg);
+
+        if (M_p>=M_end)
+        {
+            fail("unterminated string");
+        }
+
+        if ('"'==*M_p)
+        {
+            M_p++;
+            return;
+        }
+
+        /* escape */
+        M_p++;
+
+        if (M_p>=M_end)
+        {
+            fail("unterminated string");
+        }
+
+        switch (*M_p++)
+        {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u':
+            {
+                unsigned long cp = 0;
+
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    unsigned long u = 0;
+
+                    if (M_end-M_p < 4)
+                    {
+                        fail("invalid \\u escape");
+                    }
+
+                    for (int i = 0; i < 4; i++)
+                    {
+                        char c = *M_p++;
+                        u <<= 4;
+
+                        if (c >= '0' && c <= '9') u |= c-'0';
+                        else if (c >= 'a' && c <= 'f') u |= c-'a'+10;
+                        else if (c >= 'A' && c <= 'F') u |= c-'A'+10;
+                        else fail("invalid \\u escape");
+                    }
+
+                    if (0==pass && u >= 0xD800 && u <= 0xDBFF)
+                    {
+                        /* high surrogate, low one must follow */
+                        if (M_end-M_p < 2 || '\\'!=M_p[0] || 'u'!=M_p[1])
+                        {
+                            fail("invalid surrogate pair");
+                        }
+                        M_p+=2;
+                        cp = u;
+                    }
+                    else if (1==pass)
+                    {
+                        if (u < 0xDC00 || u > 0xDFFF)
+                        {
+                            fail("invalid surrogate pair");
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (u - 0xDC00);
+                        break;
+                    }
+                    else
+                    {
+                        cp = u;
+                        break;
+                    }
+                }
+
+                if (cp < 0x80)
+                {
+                    out.push_back(static_cast<char>(cp));
+                }
+                else if (cp < 0x800)
+                {
+                    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                else if (cp < 0x10000)
+                {
+                    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                else
+                {
+                    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+            }
+            break;
+            default:
+                M_p--;
+                fail("invalid escape");
+        }
+    }
+}
+
+/**
+ * @brief Parse number. Integers go to integer fields without floating
+ *  point round trip, string fields get the number text as is.
+ * @param buf UBF buffer
+ * @param fldid field id
+ * @param loc fast add location
+ */
+void ndrxpy_json_reader::number(atmibuf &buf, BFLDID fldid, Bfld_loc_info_t *loc)
+{
+    const char *start = M_p;
+    bool is_int = true;
+    int type = Bfldtype(fldid);
+
+    if ('-'==*M_p)
+    {
+        M_p++;
+    }
+
+    if (M_p>=M_end || *M_p < '0' || *M_p > '9')
+    {
+        fail("invalid number");
+    }
+
+    /* no leading zeros */
+    if ('0'==*M_p)
+    {
+        M_p++;
+    }
+    else
+    {
+        while (M_p < M_end && *M_p >= '0' && *M_p <= '9') M_p++;
+    }
+
+    if (M_p < M_end && '.'==*M_p)
+    {
+        is_int = false;
+        M_p++;
+
+        if (M_p>=M_end || *M_p < '0' || *M_p > '9')
+        {
+            fail("invalid number");
+        }
+
+        while (M_p < M_end && *M_p >= '0' && *M_p <= '9') M_p++;
+    }
+
+    if (M_p < M_end && ('e'==*M_p || 'E'==*M_p))
+    {
+        is_int = false;
+        M_p++;
+
+        if (M_p < M_end && ('+'==*M_p || '-'==*M_p))
+        {
+            M_p++;
+        }
+
+        if (M_p>=M_end || *M_p < '0' || *M_p > '9')
+        {
+            fail("invalid number");
+        }
+
+        while (M_p < M_end && *M_p >= '0' && *M_p <= '9') M_p++;
+    }
+
+    /* input is not NUL terminated */
+    std::string num(start, M_p-start);
+
+    switch (type)
+    {
+        case BFLD_STRING:
+        case BFLD_CARRAY:
+            add(buf, fldid, num.data(), num.size(), BFLD_CARRAY, loc);
+            break;
+        case BFLD_SHORT:
+        case BFLD_LONG:
+        case BFLD_CHAR:
+            if (is_int)
+            {
+                long val;
+
+                errno = 0;
+                val = strtol(num.c_str(), nullptr, 10);
+
+                if (ERANGE==errno)
+                {
+                    M_p = start;
+                    fail("number out of range");
+                }
+
+                add(buf, fldid, reinterpret_cast<char *>(&val), 0, BFLD_LONG, loc);
+                break;
+            }
+            /* fall through - UBF truncates */
+        case BFLD_FLOAT:
+        case BFLD_DOUBLE:
+        {
+            double val = strtod(num.c_str(), nullptr);
+            add(buf, fldid, reinterpret_cast<char *>(&val), 0, BFLD_DOUBLE, loc);
+        }
+            break;
+        default:
+            M_p = start;
+            fail("number value for non data field");
+    }
+}
+
+/**
+ * @brief Start writing at the end of the bytearray
+ * @param out bytearray
+ */
+ndrxpy_json_writer::ndrxpy_json_writer(PyObject *out)
+    : M_out(out)
+{
+    M_len = PyByteArray_GET_SIZE(out);
+    M_start = M_len;
+    M_cap = M_len;
+    M_p = PyByteArray_AS_STRING(out);
+    reserve(256);
+}
+
+/**
+ * @brief Ensure space for n more bytes
+ * @param n bytes
+ */
+void ndrxpy_json_writer::reserve(size_t n)
+{
+    if (M_len + n > M_cap)
+    {
+        size_t cap = std::max(M_len + n, M_cap*2);
+
+        if (EXSUCCEED!=PyByteArray_Resize(M_out, cap))
+        {
+            throw py::error_already_set();
+        }
+
+        M_p = PyByteArray_AS_STRING(M_out);
+        M_cap = cap;
+    }
+}
+
+/**
+ * @brief Append bytes
+ */
+void ndrxpy_json_writer::put(const char *s, size_t len)
+{
+    reserve(len);
+    memcpy(M_p+M_len, s, len);
+    M_len+=len;
+}
+
+/**
+ * @brief Append character
+ */
+void ndrxpy_json_writer::put(char c)
+{
+    reserve(1);
+    M_p[M_len++] = c;
+}
+
+/**
+ * @brief Trim the bytearray to the written size
+ */
+void ndrxpy_json_writer::finish(void)
+{
+    if (EXSUCCEED!=PyByteArray_Resize(M_out, M_len))
+    {
+        throw py::error_already_set();
+    }
+}
+
+/**
+ * @brief Drop partial output
+ */
+void ndrxpy_json_writer::rollback(void)
+{
+    M_len = M_start;
+    finish();
+}
+
+/**
+ * @brief Write JSON string, bytes >= 0x80 are passed as is (UTF-8)
+ */
+void ndrxpy_json_writer::string(const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t i, seg = 0;
+
+    /* worst case each byte escaped */
+    reserve(len+2);
+    put('"');
+
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+
+        if (c >= 0x20 && '"'!=c && '\\'!=c)
+        {
+            continue;
+        }
+
+        put(s+seg, i-seg);
+        seg = i+1;
+
+        switch (c)
+        {
+            case '"': put("\\\"", 2); break;
+            case '\\': put("\\\\", 2); break;
+            case '\n': put("\\n", 2); break;
+            case '\r': put("\\r", 2); break;
+            case '\t': put("\\t", 2); break;
+            default:
+            {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                put(esc, sizeof(esc));
+            }
+        }
+    }
+
+    put(s+seg, len-seg);
+    put('"');
+}
+
+/**
+ * @brief Write binary data as base64 string
+ */
+void ndrxpy_json_writer::base64(const char *s, size_t len)
+{
+    const unsigned char *d = reinterpret_cast<const unsigned char *>(s);
+    size_t i;
+
+    reserve((len+2)/3*4+2);
+    M_p[M_len++] = '"';
+
+    for (i = 0; i+2 < len; i+=3)
+    {
+        M_p[M_len++] = M_b64[d[i] >> 2];
+        M_p[M_len++] = M_b64[((d[i] & 0x03) << 4) | (d[i+1] >> 4)];
+        M_p[M_len++] = M_b64[((d[i+1] & 0x0F) << 2) | (d[i+2] >> 6)];
+        M_p[M_len++] = M_b64[d[i+2] & 0x3F];
+    }
+
+    if (i < len)
+    {
+        M_p[M_len++] = M_b64[d[i] >> 2];
+
+        if (i+1 < len)
+        {
+            M_p[M_len++] = M_b64[((d[i] & 0x03) << 4) | (d[i+1] >> 4)];
+            M_p[M_len++] = M_b64[(d[i+1] & 0x0F) << 2];
+        }
+        else
+        {
+            M_p[M_len++] = M_b64[(d[i] & 0x03) << 4];
+            M_p[M_len++] = '=';
+        }
+        M_p[M_len++] = '=';
+    }
+
+    M_p[M_len++] = '"';
+}
+
+/**
+ * @brief Write floating point with the shortest precision which
+ *  reads back to the same value. Non finite values have no JSON
+ *  representation (null would drop the occurrence on read), thus rejected.
+ */
+void ndrxpy_json_writer::real(BFLDID fldid, double v, int minprec, int maxprec, bool is_float)
+{
+    char tmp[64];
+    int prec;
+
+    if (!std::isfinite(v))
+    {
+        throw std::invalid_argument("Field ["+ndrxpy_json_fldname(fldid)+
+            "] non finite value is not supported by JSON");
+    }
+
+    for (prec = minprec; prec <= maxprec; prec++)
+    {
+        snprintf(tmp, sizeof(tmp), "%.*g", prec, v);
+
+        if (is_float ? static_cast<float>(v)==strtof(tmp, nullptr) : v==strtod(tmp, nullptr))
+        {
+            break;
+        }
+    }
+
+    put(tmp, strlen(tmp));
+
+    /* keep it float on the way back */
+    if (nullptr==strpbrk(tmp, ".eEn"))
+    {
+        put(".0", 2);
+    }
+}
+
+/**
+ * @brief Write single field occurrence
+ */
+void ndrxpy_json_writer::value(BFLDID fldid, char *d_ptr,
+        BFLDLEN len, int depth)
+{
+    char tmp[32];
+
+    switch (Bfldtype(fldid))
+    {
+        case BFLD_SHORT:
+            snprintf(tmp, sizeof(tmp), "%hd", *reinterpret_cast<short *>(d_ptr));
+            put(tmp, strlen(tmp));
+            break;
+        case BFLD_LONG:
+            snprintf(tmp, sizeof(tmp), "%ld", *reinterpret_cast<long *>(d_ptr));
+            put(tmp, strlen(tmp));
+            break;
+        case BFLD_CHAR:
+            string(d_ptr, EXEOS==d_ptr[0]?0:1);
+            break;
+        case BFLD_FLOAT:
+            real(fldid, *reinterpret_cast<float *>(d_ptr), 6, 9, true);
+            break;
+        case BFLD_DOUBLE:
+            real(fldid, *reinterpret_cast<double *>(d_ptr), 15, 17, false);
+            break;
+        case BFLD_STRING:
+            string(d_ptr, strlen(d_ptr));
+            break;
+        case BFLD_CARRAY:
+            base64(d_ptr, len);
+            break;
+        case BFLD_UBF:
+            ubf(reinterpret_cast<UBFH *>(d_ptr), depth+1);
+            break;
+        default:
+            throw std::invalid_argument("Field ["+ndrxpy_json_fldname(fldid)+
+                "] type is not supported by JSON");
+    }
+}
+
+/**
+ * @brief Write UBF buffer as object. Single occurrence is written as
+ *  value, several as array.
+ * @param p_ub UBF buffer
+ * @param depth nesting level
+ */
+void ndrxpy_json_writer::ubf(UBFH *p_ub, int depth)
+{
+    Bnext_state_t state;
+    BFLDID fldid = BFIRSTFLDID;
+    BFLDOCC oc;
+    BFLDOCC nocc = 0;
+    BFLDLEN len;
+    char *d_ptr;
+    bool first = true;
+    int ret;
+
+    if (depth > NDRXPY_JSON_MAXDEPTH)
+    {
+        throw std::invalid_argument("JSON: nesting too deep");
+    }
+
+    put('{');
+
+    while (1==(ret=Bnext2(&state, p_ub, &fldid, &oc, NULL, &len, &d_ptr)))
+    {
+        if (0==oc)
+        {
+            char *name = ndrxpy_fldname(fldid);
+
+            if (nullptr==name)
+            {
+                throw ubf_exception(Berror);
+            }
+
+            if (nocc > 1)
+            {
+                put(']');
+            }
+
+            if (!first)
+            {
+                put(',');
+            }
+
+            first = false;
+
+            string(name, strlen(name));
+            put(':');
+
+            nocc = Boccur(p_ub, fldid);
+
+            if (nocc > 1)
+            {
+                put('[');
+            }
+        }
+        else
+        {
+            put(',');
+        }
+
+        value(fldid, d_ptr, len, depth);
+    }
+
+    if (EXFAIL==ret)
+    {
+        throw ubf_exception(Berror);
+    }
+
+    if (nocc > 1)
+    {
+        put(']');
+    }
+
+    put('}');
+}
+
+/**
+ * @brief Register JSON transcoder functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_ubfjson(py::module &m)
+{
+    m.def(
+        "UbfDict_from_json",
+        [](py::object data)
+        {
+            const char *p;
+            Py_ssize_t len;
+            py::buffer_info info;
+
+            if (py::isinstance<py::str>(data))
+            {
+                p = PyUnicode_AsUTF8AndSize(data.ptr(), &len);
+
+                if (nullptr==p)
+                {
+                    throw py::error_already_set();
+                }
+            }
+            else
+            {
+                info = py::reinterpret_borrow<py::buffer>(data).request();
+                p = reinterpret_cast<const char *>(info.ptr);
+                len = info.size * info.itemsize;
+            }
+
+            atmibuf buf("UBF", std::max(static_cast<long>(len), 1024L));
+            ndrxpy_json_reader rd(p, len);
+            rd.parse(buf);
+
+            return reinterpret_cast<ndrx_longptr_t>(new atmibuf(std::move(buf)));
+        },
+        R"pbdoc(
+        Parse JSON text to new UBF buffer.
+
+        Parameters
+        ----------
+        data: object
+            JSON text, str or buffer protocol object (UTF-8).
+
+        Returns
+        -------
+        ret : int
+            Pointer to atmibuf
+
+        )pbdoc", py::arg("data"));
+
+    m.def(
+        "UbfDict_to_json",
+        [](ndrx_longptr_t ptr, py::object out)
+        {
+            atmibuf *buf = reinterpret_cast<atmibuf *>(ptr);
+
+            if (out.is_none())
+            {
+                out = py::reinterpret_steal<py::object>(PyByteArray_FromStringAndSize(nullptr, 0));
+
+                if (!out)
+                {
+                    throw py::error_already_set();
+                }
+            }
+            else if (!PyByteArray_Check(out.ptr()))
+            {
+                throw std::invalid_argument("out must be bytearray");
+            }
+
+            ndrxpy_json_writer wr(out.ptr());
+
+            try
+            {
+                wr.ubf(*buf->fbfr(), 0);
+            }
+            catch (...)
+            {
+                wr.rollback();
+                throw;
+            }
+
+            wr.finish();
+
+            return out;
+        },
+        R"pbdoc(
+        Write UBF buffer as JSON text.
+
+        Parameters
+        ----------
+        ptr: int
+            C pointer to atmibuf
+        out: bytearray
+            Output is appended to given bytearray. If **None**, new is allocated.
+
+        Returns
+        -------
+        ret : bytearray
+            Output bytearray.
+
+        )pbdoc", py::arg("ptr"), py::arg("out")=py::none());
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
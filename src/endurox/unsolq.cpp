@@ -0,0 +1,510 @@
+/**
+ * @brief Enduro/X Python module - queued unsolicited messages
+ *
+ * @file unsolq.cpp
+ */
+/* -----------------------------------------------------------------------------
+ * Python module for Enduro/X
+ *
+ * Copyright (C) 2021 - 2022, Mavimax, Ltd. All Rights Reserved.
+ * See LICENSE file for full text.
+ * -----------------------------------------------------------------------------
+ * AGPL license:
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License, version 3 as published
+ * by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU Affero General Public License, version 3
+ * for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * -----------------------------------------------------------------------------
+ * A commercial use license is available from Mavimax, Ltd
+ * contact@mavimax.com
+ * -----------------------------------------------------------------------------
+ */
+
+/*---------------------------Includes-----------------------------------*/
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <atmi.h>
+#include <userlog.h>
+#include <ubf.h>
+#undef _
+
+#include "exceptions.h"
+#include "ndrx_pymod.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <atomic>
+#include <mutex>
+
+#ifdef EX_OS_LINUX
+#include <sys/eventfd.h>
+#endif
+
+/*---------------------------Externs------------------------------------*/
+/*---------------------------Macros-------------------------------------*/
+/*---------------------------Enums--------------------------------------*/
+/*---------------------------Typedefs-----------------------------------*/
+
+namespace py = pybind11;
+
+/**
+ * Queue cell. Bounded MPMC ring, cell sequence tells the cell state
+ * to the producers and the consumer.
+ */
+struct ndrxpy_unsolcell_t
+{
+    std::atomic<size_t> seq;    /**< Cell sequence                      */
+    char *data;                 /**< Owned XATMI buffer, may be NULL    */
+    long len;                   /**< Data length                        */
+};
+
+/*---------------------------Globals------------------------------------*/
+/*---------------------------Statics------------------------------------*/
+
+/** Ring cells, nullptr if queue is not enabled */
+static ndrxpy_unsolcell_t *M_cells = nullptr;
+
+/** Ring size - 1, size is power of 2 */
+static size_t M_mask = 0;
+
+/** Enqueue position */
+static std::atomic<size_t> M_enqpos {0};
+
+/** Dequeue position */
+static std::atomic<size_t> M_deqpos {0};
+
+/** Counters */
+static std::atomic<long> M_enqueued {0};
+static std::atomic<long> M_dropped {0};
+static std::atomic<long> M_hwm {0};
+
+/** Event fd signalled on enqueue */
+static int M_efd = EXFAIL;
+
+/** Queue init lock */
+static std::mutex M_init_mtx;
+
+/*---------------------------Prototypes---------------------------------*/
+
+/**
+ * @brief Add buffer to the ring
+ * @param data buffer
+ * @param len data len
+ * @return false if full
+ */
+exprivate bool ndrxpy_unsolq_push(char *data, long len)
+{
+    ndrxpy_unsolcell_t *cell;
+    size_t pos = M_enqpos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        cell = &M_cells[pos & M_mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (0==diff)
+        {
+            if (M_enqpos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = M_enqpos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->data = data;
+    cell->len = len;
+    cell->seq.store(pos+1, std::memory_order_release);
+
+    return true;
+}
+
+/**
+ * @brief Take buffer from the ring
+ * @param data buffer
+ * @param len data len
+ * @return false if empty
+ */
+exprivate bool ndrxpy_unsolq_pop(char **data, long *len)
+{
+    ndrxpy_unsolcell_t *cell;
+    size_t pos = M_deqpos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        cell = &M_cells[pos & M_mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos+1);
+
+        if (0==diff)
+        {
+            if (M_deqpos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = M_deqpos.load(std::memory_order_relaxed);
+        }
+    }
+
+    *data = cell->data;
+    *len = cell->len;
+    cell->seq.store(pos+M_mask+1, std::memory_order_release);
+
+    return true;
+}
+
+/**
+ * @brief Copy notification buffer, as it is owned by Enduro/X
+ * @param data buffer
+ * @param len data len
+ * @return copy or nullptr on error
+ */
+exprivate char *ndrxpy_unsolq_dup(char *data, long len)
+{
+    char type[8]={EXEOS};
+    char subtype[16]={EXEOS};
+    char *ret;
+    long size;
+
+    if (EXFAIL==tptypes(data, type, subtype))
+    {
+        return nullptr;
+    }
+
+    if (0==strcmp(type, "UBF"))
+    {
+        size = Bused(reinterpret_cast<UBFH *>(data));
+    }
+    else
+    {
+        size = len;
+    }
+
+    if (nullptr==(ret=tpalloc(type, EXEOS==subtype[0]?nullptr:subtype, size)))
+    {
+        return nullptr;
+    }
+
+    if (0==strcmp(type, "UBF"))
+    {
+        if (EXSUCCEED!=Bcpy(reinterpret_cast<UBFH *>(ret), reinterpret_cast<UBFH *>(data)))
+        {
+            tpfree(ret);
+            return nullptr;
+        }
+    }
+    else if (size > 0)
+    {
+        memcpy(ret, data, size);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Unsolicited message callback, queue the message. Runs with out GIL,
+ *  in thread which processes the notifications (tpchkunsol() or ATMI call).
+ * @param data message buffer
+ * @param len data len
+ * @param flags not used
+ */
+exprivate void ndrxpy_unsolq_callback(char *data, long len, long flags)
+{
+    char *copy = nullptr;
+    long depth;
+    long hwm;
+
+    if (nullptr!=data && nullptr==(copy=ndrxpy_unsolq_dup(data, len)))
+    {
+        NDRX_LOG(log_error, "Failed to copy unsolicited message: %s",
+            tpstrerror(tperrno));
+        M_dropped++;
+        return;
+    }
+
+    if (!ndrxpy_unsolq_push(copy, len))
+    {
+        NDRX_LOG(log_warn, "Unsolicited queue full, message dropped");
+
+        if (nullptr!=copy)
+        {
+            tpfree(copy);
+        }
+
+        M_dropped++;
+        return;
+    }
+
+    M_enqueued++;
+
+    depth = static_cast<long>(M_enqpos.load() - M_deqpos.load());
+    hwm = M_hwm.load();
+
+    while (depth > hwm && !M_hwm.compare_exchange_weak(hwm, depth));
+
+#ifdef EX_OS_LINUX
+    uint64_t one = 1;
+
+    if (sizeof(one)!=write(M_efd, &one, sizeof(one)))
+    {
+        NDRX_LOG(log_debug, "eventfd write: %s", strerror(errno));
+    }
+#endif
+}
+
+/**
+ * @brief Enable queued mode for current ATMI context
+ * @param capacity ring size, rounded up to power of 2
+ * @return event fd
+ */
+exprivate int ndrxpy_unsolq_enable(long capacity)
+{
+#ifndef EX_OS_LINUX
+    throw std::invalid_argument("Unsolicited queue requires eventfd (Linux only)");
+#else
+    {
+        std::lock_guard<std::mutex> lock(M_init_mtx);
+
+        if (nullptr==M_cells)
+        {
+            size_t size = 2;
+
+            if (capacity < 1)
+            {
+                throw std::invalid_argument("Invalid queue capacity");
+            }
+
+            while (size < static_cast<size_t>(capacity))
+            {
+                size<<=1;
+            }
+
+            if (EXFAIL==(M_efd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)))
+            {
+                NDRX_LOG(log_error, "eventfd failed: %s", strerror(errno));
+                throw atmi_exception(TPEOS);
+            }
+
+            M_cells = new ndrxpy_unsolcell_t[size];
+
+            for (size_t i=0; i<size; i++)
+            {
+                M_cells[i].seq.store(i, std::memory_order_relaxed);
+                M_cells[i].data = nullptr;
+                M_cells[i].len = 0;
+            }
+
+            M_mask = size-1;
+        }
+    }
+
+    if (TPUNSOLERR==tpsetunsol(ndrxpy_unsolq_callback))
+    {
+        throw atmi_exception(tperrno);
+    }
+
+    return M_efd;
+#endif
+}
+
+/**
+ * @brief Drain queued messages
+ * @param max max messages to return, 0 - all
+ * @return list of ATMI buffers
+ */
+exprivate py::list ndrxpy_unsolq_drain(long max)
+{
+    py::list ret;
+    char *data;
+    long len;
+    long n = 0;
+
+    if (nullptr==M_cells)
+    {
+        return ret;
+    }
+
+#ifdef EX_OS_LINUX
+    uint64_t cnt;
+
+    //Reset the counter, remaining messages are checked below
+    if (sizeof(cnt)!=read(M_efd, &cnt, sizeof(cnt)) && EAGAIN!=errno)
+    {
+        NDRX_LOG(log_debug, "eventfd read: %s", strerror(errno));
+    }
+#endif
+
+    while ((0==max || n < max) && ndrxpy_unsolq_pop(&data, &len))
+    {
+        n++;
+
+        if (nullptr==data)
+        {
+            py::dict d;
+            d["buftype"] = "NULL";
+            ret.append(d);
+            continue;
+        }
+
+        atmibuf b;
+        b.p = data;
+        b.len = len;
+
+        ret.append(ndrx_to_py(b, false));
+    }
+
+#ifdef EX_OS_LINUX
+    //Not all returned, keep the fd readable
+    if (M_enqpos.load() != M_deqpos.load())
+    {
+        uint64_t one = 1;
+
+        if (sizeof(one)!=write(M_efd, &one, sizeof(one)))
+        {
+            NDRX_LOG(log_debug, "eventfd write: %s", strerror(errno));
+        }
+    }
+#endif
+
+    return ret;
+}
+
+/**
+ * @brief Register unsolicited queue functions
+ *
+ * @param m Pybind11 module handle
+ */
+expublic void ndrxpy_register_unsolq(py::module &m)
+{
+    m.def(
+        "ndrxpy_unsolq_enable", [](long capacity)
+        { return ndrxpy_unsolq_enable(capacity); },
+        R"pbdoc(
+        Enable queued delivery of unsolicited messages for current ATMI context
+        (replaces handler set by :func:`.tpsetunsol`). Messages posted by
+        :func:`.tpnotify` and :func:`.tpbroadcast` are copied by native code
+        into lock-free ring buffer, with out acquiring GIL, and eventfd
+        is signalled. Thus burst of notifications does not stall the ATMI call
+        or :func:`.tpchkunsol` which received them. Messages are then taken
+        in batches by :func:`.ndrxpy_unsolq_drain`, for example when the
+        eventfd becomes readable in :mod:`selectors`, asyncio or
+        :func:`.tpext_addpollerfd`.
+
+        Queue is shared by all ATMI contexts of the process. Function shall
+        be called by every context which shall queue its messages; *capacity*
+        is used by the first call only. If queue is full, messages are dropped
+        and counted.
+
+        Function requires Linux **eventfd**.
+
+        .. code-block:: python
+            :caption: ndrxpy_unsolq_enable example
+            :name: ndrxpy_unsolq_enable-example
+
+            import selectors
+            import endurox as e
+
+            efd = e.ndrxpy_unsolq_enable(4096)
+            sel = selectors.DefaultSelector()
+            sel.register(efd, selectors.EVENT_READ)
+
+            while True:
+                e.tpchkunsol()
+                for key, mask in sel.select(1):
+                    for msg in e.ndrxpy_unsolq_drain():
+                        print(msg)
+
+        :raise AtmiException: 
+            | Following error codes may be present:
+            | :data:`.TPEINVAL` - Invalid environment.
+            | :data:`.TPESYSTEM` -  System error occurred.
+            | :data:`.TPEOS` - Operating system error occurred.
+
+        Parameters
+        ----------
+        capacity : int
+            Max messages queued, rounded up to power of 2.
+
+        Returns
+        -------
+        int
+            eventfd file descriptor, readable while messages are queued.
+            Descriptor is owned by the module and shall not be closed.
+        )pbdoc",
+        py::arg("capacity")=1024);
+
+    m.def(
+        "ndrxpy_unsolq_drain", [](long max)
+        { return ndrxpy_unsolq_drain(max); },
+        R"pbdoc(
+        Take queued unsolicited messages, see :func:`.ndrxpy_unsolq_enable`.
+
+        Parameters
+        ----------
+        max : int
+            Max messages to return, **0** - all queued.
+
+        Returns
+        -------
+        list
+            List of ATMI buffers, in order of arrival.
+        )pbdoc",
+        py::arg("max")=0);
+
+    m.def(
+        "ndrxpy_unsolq_stats", [](void)
+        {
+            py::dict ret;
+
+            ret["capacity"] = nullptr==M_cells?0:M_mask+1;
+            ret["depth"] = static_cast<long>(M_enqpos.load() - M_deqpos.load());
+            ret["maxdepth"] = M_hwm.load();
+            ret["enqueued"] = M_enqueued.load();
+            ret["dropped"] = M_dropped.load();
+
+            return ret;
+        },
+        R"pbdoc(
+        Return unsolicited queue counters.
+
+        Returns
+        -------
+        dict
+            **capacity** - queue size, **depth** - messages queued now,
+            **maxdepth** - max depth seen, **enqueued** - total messages
+            queued, **dropped** - messages dropped due to full queue or
+            copy failure.
+        )pbdoc");
+}
+
+/* vim: set ts=4 sw=4 et smartindent: */
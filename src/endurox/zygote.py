@@ -0,0 +1,354 @@
+"""Zygote-style prefork launcher for the Enduro/X Python ATMI servers.
+
+Warm parent process (zygote) imports the application modules once and forks
+server instances on request. Instances are requested by the launcher stub,
+which is the process started by ndrxd. Stub passes its arguments, environment,
+working directory and standard file descriptors to the zygote, forwards signals
+to the forked server and exits with the server exit status. Thus ndrxd
+process supervision (start, stop, respawn) works as with normal servers.
+"""
+
+import array
+import importlib
+import json
+import os
+import random
+import selectors
+import signal
+import socket
+import struct
+import sys
+
+# Signals forwarded by the stub to the server instance
+FORWARD_SIGNALS = [signal.SIGTERM, signal.SIGINT, signal.SIGHUP,
+    signal.SIGQUIT, signal.SIGUSR1, signal.SIGUSR2]
+
+# Max request message size
+MAX_MSG = 1024*1024
+
+# prctl() option to signal the process on parent exit (Linux)
+PR_SET_PDEATHSIG = 1
+
+def _send_msg(sock, obj, fds=None):
+    """Send length prefixed JSON message, optionally with file descriptors
+
+    Parameters
+    ----------
+    sock: socket
+        Unix socket
+    obj: dict
+        Message to send
+    fds: list
+        File descriptors to pass
+    """
+    data = json.dumps(obj).encode()
+    data = struct.pack("!I", len(data)) + data
+
+    if fds:
+        sock.sendmsg([data], [(socket.SOL_SOCKET, socket.SCM_RIGHTS,
+            array.array("i", fds))])
+    else:
+        sock.sendall(data)
+
+def _recv_exact(sock, n):
+    """Receive exactly n bytes, None on EOF"""
+    buf = b""
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return buf
+
+def _recv_msg(sock, nfds=0):
+    """Receive length prefixed JSON message, optionally with file descriptors
+
+    Parameters
+    ----------
+    sock: socket
+        Unix socket
+    nfds: int
+        Number of file descriptors expected
+
+    Returns
+    -------
+    msg : tuple
+        (dict, list of fds) or (None, []) on EOF
+    """
+    fds = array.array("i")
+    hdr = b""
+
+    if nfds > 0:
+        hdr, ancdata, flags, addr = sock.recvmsg(4,
+            socket.CMSG_LEN(nfds * fds.itemsize))
+        for cmsg_level, cmsg_type, cmsg_data in ancdata:
+            if cmsg_level == socket.SOL_SOCKET and cmsg_type == socket.SCM_RIGHTS:
+                fds.frombytes(cmsg_data[:len(cmsg_data) - (len(cmsg_data) % fds.itemsize)])
+        if not hdr:
+            return None, list(fds)
+
+    rest = _recv_exact(sock, 4 - len(hdr))
+    if rest is None:
+        return None, list(fds)
+    hdr += rest
+
+    n, = struct.unpack("!I", hdr)
+    if n > MAX_MSG:
+        raise RuntimeError("Zygote message too large: %d" % n)
+
+    data = _recv_exact(sock, n)
+    if data is None:
+        return None, list(fds)
+
+    return json.loads(data.decode()), list(fds)
+
+def _resolve_factory(spec):
+    """Resolve server class/factory from "module:attr" spec
+
+    Parameters
+    ----------
+    spec: str
+        Module and server class (or factory function) name
+
+    Returns
+    -------
+    factory : object
+        Callable returning server object
+    """
+    mod, sep, attr = spec.partition(":")
+    if not sep:
+        attr = "Server"
+    return getattr(importlib.import_module(mod), attr)
+
+def _set_pdeathsig(sig):
+    """Request signal on zygote exit, so that the instances do not outlive
+    their parent. Best effort, no-op where prctl() is not available.
+
+    Parameters
+    ----------
+    sig: int
+        Signal to deliver
+    """
+    try:
+        import ctypes
+        libc = ctypes.CDLL(None, use_errno=True)
+        libc.prctl(PR_SET_PDEATHSIG, int(sig), 0, 0, 0)
+    except (OSError, AttributeError):
+        pass
+
+def _child_run(factory, req, fds):
+    """Forked server instance entry. Never returns.
+
+    Parameters
+    ----------
+    factory: object
+        Server class or factory
+    req: dict
+        Stub request (argv, env, cwd)
+    fds: list
+        stdin, stdout, stderr of the stub
+    """
+    rc = 0
+    try:
+        for sig in FORWARD_SIGNALS + [signal.SIGCHLD]:
+            signal.signal(sig, signal.SIG_DFL)
+
+        _set_pdeathsig(signal.SIGKILL)
+
+        for i, fd in enumerate(fds[:3]):
+            os.dup2(fd, i)
+            os.close(fd)
+
+        os.environ.clear()
+        os.environ.update(req["env"])
+        os.chdir(req["cwd"])
+        sys.argv = req["argv"]
+        random.seed()
+
+        import endurox as e
+        e.tprun(factory(), req["argv"])
+    except SystemExit as ex:
+        rc = ex.code if isinstance(ex.code, int) else 1
+    except BaseException:
+        import traceback
+        traceback.print_exc()
+        rc = 1
+    finally:
+        try:
+            sys.stdout.flush()
+            sys.stderr.flush()
+        finally:
+            os._exit(rc)
+
+def serve(sockpath, spec, preload=None):
+    """Run zygote: preload the modules and fork the server instances
+    requested by stubs (see :func:`launch`). Function does not return.
+
+    ATMI or logging APIs shall not be used by the zygote process or by
+    the preloaded modules at the import time, as the ATMI state is
+    initialized by every instance after the fork.
+
+    Parameters
+    ----------
+    sockpath: str
+        Unix socket path to listen on.
+    spec: str
+        Server class in form of "module:Class". Class is instantiated
+        in the forked instance and passed to :func:`.tprun`.
+    preload: list
+        Additional modules to import before forking.
+    """
+    for mod in preload or []:
+        importlib.import_module(mod)
+
+    # warm up the extension module too
+    import endurox
+    factory = _resolve_factory(spec)
+
+    if os.path.exists(sockpath):
+        os.unlink(sockpath)
+
+    lsn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    lsn.bind(sockpath)
+    lsn.listen(128)
+
+    # pid -> stub connection (None if stub is gone)
+    children = {}
+
+    # wake up selector on child exit
+    rfd, wfd = os.pipe()
+    os.set_blocking(wfd, False)
+    signal.set_wakeup_fd(wfd)
+    signal.signal(signal.SIGCHLD, lambda signum, frame: None)
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+
+    sel = selectors.DefaultSelector()
+    sel.register(lsn, selectors.EVENT_READ)
+    sel.register(rfd, selectors.EVENT_READ)
+
+    try:
+        while True:
+            for key, mask in sel.select():
+                if key.fileobj == rfd:
+                    os.read(rfd, 512)
+                    continue
+
+                if key.fileobj != lsn:
+                    # stub sends nothing after the request, thus readable
+                    # connection means that stub has died (e.g. killed
+                    # by ndrxd). Do not leave the instance orphaned.
+                    pid = key.data
+                    sel.unregister(key.fileobj)
+                    key.fileobj.close()
+                    children[pid] = None
+                    try:
+                        os.kill(pid, signal.SIGKILL)
+                    except OSError:
+                        pass
+                    continue
+
+                conn, addr = lsn.accept()
+                try:
+                    req, fds = _recv_msg(conn, 3)
+                    if req is None or len(fds) != 3:
+                        raise RuntimeError("Invalid stub request")
+                except Exception as ex:
+                    sys.stderr.write("zygote: %s\n" % ex)
+                    conn.close()
+                    continue
+
+                pid = os.fork()
+                if pid == 0:
+                    lsn.close()
+                    conn.close()
+                    for c in children.values():
+                        if c is not None:
+                            c.close()
+                    sel.close()
+                    os.close(rfd)
+                    os.close(wfd)
+                    signal.set_wakeup_fd(-1)
+                    _child_run(factory, req, fds)
+
+                for fd in fds:
+                    os.close(fd)
+
+                children[pid] = conn
+                sel.register(conn, selectors.EVENT_READ, pid)
+                try:
+                    _send_msg(conn, {"pid": pid})
+                except OSError:
+                    pass
+
+            # reap the instances, report status to stubs
+            while children:
+                pid, status = os.waitpid(-1, os.WNOHANG)
+                if pid == 0:
+                    break
+
+                conn = children.pop(pid, None)
+                if conn is not None:
+                    sel.unregister(conn)
+                    if os.WIFEXITED(status):
+                        rc = os.WEXITSTATUS(status)
+                    else:
+                        rc = 128 + os.WTERMSIG(status)
+                    try:
+                        _send_msg(conn, {"status": rc})
+                    except OSError:
+                        pass
+                    conn.close()
+    finally:
+        lsn.close()
+        os.unlink(sockpath)
+
+def launch(sockpath, argv):
+    """Launcher stub: request server instance from the zygote, forward
+    signals to it and return its exit status.
+
+    Parameters
+    ----------
+    sockpath: str
+        Zygote unix socket path.
+    argv: list
+        Server command line arguments (as passed by ndrxd).
+
+    Returns
+    -------
+    rc : int
+        Server instance exit status.
+    """
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(sockpath)
+
+    _send_msg(sock, {"argv": argv, "env": dict(os.environ), "cwd": os.getcwd()},
+        [0, 1, 2])
+
+    msg, fds = _recv_msg(sock)
+    if msg is None or "pid" not in msg:
+        return -1
+
+    pid = msg["pid"]
+
+    def forward(signum, frame):
+        try:
+            os.kill(pid, signum)
+        except OSError:
+            pass
+
+    for sig in FORWARD_SIGNALS:
+        signal.signal(sig, forward)
+
+    while True:
+        try:
+            msg, fds = _recv_msg(sock)
+            break
+        except InterruptedError:
+            continue
+
+    if msg is None or "status" not in msg:
+        return -1
+
+    return msg["status"]
+
+# vim: set ts=4 sw=4 et smartindent:
@@ -3,6 +3,12 @@ import endurox as e
 from endurox.ubfdict import UbfDict
 import exutils as u
 from copy import deepcopy
+import pickle
+import json
+import os
+import subprocess
+import sys
+import tempfile
 
 # UBF Dicitionary tests
 class TestUbfDict(unittest.TestCase):
@@ -299,6 +305,301 @@ class TestUbfDict(unittest.TestCase):
             self.assertEqual(b2.T_STRING_FLD[0], "HELLO")
             self.assertEqual(b2.T_STRING_FLD[1], "WORLD")
 
+    # pickle as raw UBF image
+    def test_ubfdict_pickle(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            b1 = e.UbfDict({"T_STRING_FLD":["HELLO", "WORLD"], "T_LONG_FLD":[1, 2, 3],
+                "T_UBF_FLD":{"T_STRING_2_FLD":"EHLO"}})
+
+            for proto in range(2, pickle.HIGHEST_PROTOCOL+1):
+                b2 = pickle.loads(pickle.dumps(b1, protocol=proto))
+                self.assertEqual(b1, b2)
+
+            # out-of-band buffers
+            if pickle.HIGHEST_PROTOCOL >= 5:
+                bufs = []
+                data = pickle.dumps(b1, protocol=5, buffer_callback=bufs.append)
+                self.assertEqual(len(bufs), 1)
+                b2 = pickle.loads(data, buffers=bufs)
+                self.assertEqual(b1, b2)
+
+            # new buffer is independent and writable
+            b2.T_STRING_FLD.append("TEST1")
+            self.assertEqual(len(b1.T_STRING_FLD), 2)
+            self.assertEqual(len(b2.T_STRING_FLD), 3)
+
+            # ptr fields go in dictionary form
+            b3 = e.UbfDict({"T_STRING_FLD":"HELLO", "T_PTR_FLD":{"data":{"T_STRING_2_FLD":"EHLO"}}})
+            b4 = pickle.loads(pickle.dumps(b3))
+            self.assertEqual(b4.T_PTR_FLD[0]["data"].T_STRING_2_FLD[0], "EHLO")
+
+    # native JSON transcoding
+    def test_ubfdict_json(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            b1 = e.UbfDict.from_json(b'{"T_STRING_FLD":["HELLO", "W\\"\\u00e9"], "T_LONG_FLD":[1, -2],'
+                b'"T_SHORT_FLD":7, "T_DOUBLE_FLD":0.1, "T_CARRAY_FLD":"AAECAw==",'
+                b'"T_STRING_2_FLD":12.50, "T_FLOAT_FLD":null, "T_UBF_FLD":{"T_STRING_FLD":"SUB"}}')
+            self.assertEqual(b1.T_STRING_FLD[1], 'W"\u00e9')
+            self.assertEqual(b1.T_LONG_FLD[1], -2)
+            self.assertEqual(b1.T_SHORT_FLD[0], 7)
+            self.assertEqual(b1.T_DOUBLE_FLD[0], 0.1)
+            self.assertEqual(b1.T_CARRAY_FLD[0], b'\x00\x01\x02\x03')
+            self.assertEqual(b1.T_STRING_2_FLD[0], "12.50")
+            self.assertFalse("T_FLOAT_FLD" in b1)
+            self.assertEqual(b1.T_UBF_FLD[0].T_STRING_FLD[0], "SUB")
+
+            # output is valid JSON, single occurrences as values
+            out = b1.to_json()
+            self.assertIsInstance(out, bytearray)
+            d = json.loads(out)
+            self.assertEqual(d["T_STRING_FLD"], ["HELLO", 'W"\u00e9'])
+            self.assertEqual(d["T_SHORT_FLD"], 7)
+            self.assertEqual(d["T_UBF_FLD"], {"T_STRING_FLD":"SUB"})
+            self.assertEqual(e.UbfDict.from_json(out), b1)
+
+            # appended to given bytearray
+            out = bytearray(b'PREFIX')
+            self.assertIs(b1.to_json(out), out)
+            self.assertEqual(out[6:], b1.to_json())
+
+            # non finite values cannot round trip
+            with self.assertRaises(ValueError):
+                e.UbfDict({"T_DOUBLE_FLD":[1.0, float("nan")]}).to_json()
+            with self.assertRaises(ValueError):
+                e.UbfDict({"T_FLOAT_FLD":float("inf")}).to_json()
+
+            with self.assertRaises(ValueError):
+                e.UbfDict.from_json('{"T_LONG_FLD":1,}')
+            with self.assertRaises(ValueError):
+                e.UbfDict.from_json('{"T_UBF_FLD":"X"}')
+            with self.assertRaises(KeyError):
+                e.UbfDict.from_json('{"NO_SUCH_FLD":1}')
+
+    # native bulk operations
+    def test_ubfdict_bulk(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            b1 = e.UbfDict({"T_STRING_FLD":["HELLO", "WORLD"], "T_LONG_FLD":1})
+            b2 = e.UbfDict({"T_STRING_FLD":"THERE", "T_DOUBLE_FLD":1.5,
+                "T_CARRAY_FLD":b'\x00'*5000})
+
+            b3 = e.UbfDict(b1)
+            b3.update(b2)
+            self.assertEqual(b3.T_STRING_FLD, ["THERE", "WORLD"])
+            self.assertEqual(b3.T_LONG_FLD[0], 1)
+            self.assertEqual(b3.T_DOUBLE_FLD[0], 1.5)
+            self.assertEqual(len(b3.T_CARRAY_FLD[0]), 5000)
+
+            # non UbfDict goes by keys
+            b3.update({"T_LONG_FLD":5}, T_DOUBLE_FLD=2.5)
+            self.assertEqual(b3.T_LONG_FLD[0], 5)
+            self.assertEqual(b3.T_DOUBLE_FLD[0], 2.5)
+
+            b3 = e.UbfDict(b1)
+            b3.concat(b2)
+            self.assertEqual(b3.T_STRING_FLD, ["HELLO", "WORLD", "THERE"])
+
+            b4 = b3.project(["T_STRING_FLD", "T_LONG_FLD"], copy=True)
+            self.assertEqual(b4, e.UbfDict({"T_STRING_FLD":["HELLO", "WORLD", "THERE"], "T_LONG_FLD":1}))
+            self.assertEqual(len(b3), 4)
+
+            b3.project(["T_DOUBLE_FLD"])
+            self.assertEqual(b3, e.UbfDict({"T_DOUBLE_FLD":1.5}))
+
+            b4.delete_fields(["T_LONG_FLD", "T_DOUBLE_FLD"])
+            self.assertEqual(list(b4.keys()), ["T_STRING_FLD"])
+
+            with self.assertRaises(KeyError):
+                b4.delete_fields(["NO_SUCH_FLD"])
+
+    # field level delta
+    def test_ubfdict_diff(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            b1 = e.UbfDict({"T_STRING_FLD":["HELLO", "WORLD", "X"], "T_LONG_FLD":[1, 2],
+                "T_UBF_FLD":{"T_STRING_FLD":"SUB"}, "T_DOUBLE_FLD":1.5})
+            b2 = e.UbfDict(b1)
+            b2.T_STRING_FLD[1] = "THERE"
+            del b2.T_STRING_FLD[2]
+            b2.T_LONG_FLD.append(3)
+            b2.T_UBF_FLD[0] = {"T_STRING_FLD":"SUB2"}
+            del b2.T_DOUBLE_FLD
+            b2.T_CARRAY_FLD = b'\x00\x01'
+
+            delta = b1.diff(b2)
+            self.assertIsInstance(delta, bytes)
+            self.assertEqual(sorted(e.UbfDict.delta_items(delta)), sorted([
+                ("chg", "T_STRING_FLD", 1), ("del", "T_STRING_FLD", 2),
+                ("add", "T_LONG_FLD", 2), ("chg", "T_UBF_FLD", 0),
+                ("del", "T_DOUBLE_FLD", 0), ("add", "T_CARRAY_FLD", 0)]))
+
+            b3 = e.UbfDict(b1)
+            b3.apply(delta)
+            self.assertEqual(b3, b2)
+
+            # no changes
+            self.assertEqual(e.UbfDict.delta_items(b2.diff(b3)), [])
+
+            # reverse
+            b2.apply(b2.diff(b1))
+            self.assertEqual(b2, b1)
+
+            with self.assertRaises(ValueError):
+                b2.apply(b"XXXX")
+
+            # error names the field
+            b4 = e.UbfDict({"T_PTR_FLD":{"data":e.UbfDict({"T_STRING_FLD":"PTR"})}})
+            with self.assertRaisesRegex(ValueError, "T_PTR_FLD"):
+                b1.diff(b4)
+
+    # shared memory arena handoff
+    def test_ubfdict_arena(self):
+        name = "/ubfdict_arena_%d" % os.getpid()
+        a1 = e.UbfArena(name, 1024*1024)
+        # second mapping, as by receiver process
+        a2 = e.UbfArena(name, create=False)
+        a1.unlink()
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            b1 = e.UbfDict({"T_STRING_FLD":["HELLO", "WORLD"], "T_LONG_FLD":[1, 2, 3]})
+            h = a1.put(b1, refs=2)
+            self.assertIsInstance(h, int)
+
+            # read-only view
+            v = a2.take(h)
+            self.assertEqual(b1, v)
+            with self.assertRaises(AttributeError):
+                v.T_STRING_FLD.append("TEST1")
+
+            # writable copy
+            b2 = e.UbfDict(v)
+            b2.T_STRING_FLD.append("TEST1")
+            self.assertEqual(len(v.T_STRING_FLD), 2)
+            b3 = a2.take(h, copy=True)
+            self.assertEqual(b1, b3)
+            del v
+
+            # all references gone
+            with self.assertRaises(ValueError):
+                a2.take(h)
+
+            # reference is taken once
+            h = a1.put(b1)
+            v = a2.take(h)
+            with self.assertRaises(ValueError):
+                a2.take(h)
+            with self.assertRaises(ValueError):
+                a2.release(h)
+
+            # PTR field gets XATMI copy, view keeps its reference
+            b4 = e.UbfDict({"T_PTR_FLD":{"data":v}})
+            self.assertEqual(b4.T_PTR_FLD[0]["data"].T_STRING_FLD[1], "WORLD")
+            self.assertEqual(v.T_STRING_FLD[0], "HELLO")
+            del b4
+            del v
+
+            # block reused, handle differs
+            h2 = a1.put({"T_STRING_FLD":"HELLO"})
+            self.assertNotEqual(h, h2)
+            a1.retain(h2)
+            a1.release(h2)
+            a1.release(h2)
+            with self.assertRaises(ValueError):
+                a1.release(h2)
+
+        st = a1.stats()
+        self.assertEqual(st["live"], 0)
+        self.assertEqual(st["allocs"], st["frees"])
+
+        # arena full
+        with self.assertRaises(e.AtmiException) as cm:
+            a1.put({"T_CARRAY_FLD":b'\0'*2*1024*1024})
+        self.assertEqual(cm.exception.code, e.TPELIMIT)
+
+        # view outlives the arena object
+        v = a2.take(a1.put(b1))
+        a2.close()
+        self.assertEqual(b1, v)
+        del v
+        a1.close()
+        with self.assertRaises(e.AtmiException):
+            a1.put(b1)
+
+    def test_ubfdict_arena_ipc(self):
+        name = "/ubfdict_arena_ipc_%d" % os.getpid()
+        a = e.UbfArena(name, 1024*1024)
+        # receiver process takes the handle and replies with new one
+        child = ("import sys\n"
+            "import endurox as e\n"
+            "a = e.UbfArena(sys.argv[1], create=False)\n"
+            "v = a.take(int(sys.argv[2]))\n"
+            "h = a.put({'T_STRING_FLD':v.T_STRING_FLD[0]+' WORLD'})\n"
+            "del v\n"
+            "a.close()\n"
+            "print(h)\n")
+        try:
+            w = u.NdrxStopwatch()
+            while w.get_delta_sec() < u.test_duratation():
+                h = a.put({"T_STRING_FLD":"HELLO"})
+                out = subprocess.check_output([sys.executable, "-c", child, name, str(h)])
+
+                # taken by the receiver
+                with self.assertRaises(ValueError):
+                    a.take(h)
+
+                v = a.take(int(out))
+                self.assertEqual(v.T_STRING_FLD[0], "HELLO WORLD")
+                del v
+                self.assertEqual(a.stats()["live"], 0)
+        finally:
+            a.unlink()
+            a.close()
+
+    def test_ubfdict_mkfldpy(self):
+        src = os.path.dirname(os.path.abspath(__file__))
+        mkfldpy = os.path.join(src, "../../../../scripts/mkfldpy")
+        with tempfile.TemporaryDirectory() as tmp:
+            subprocess.check_call([sys.executable, mkfldpy,
+                "-d", tmp, os.path.join(src, "../../../resources/test.fd")])
+            sys.path.insert(0, tmp)
+            try:
+                import test_fd as f
+            finally:
+                sys.path.remove(tmp)
+
+            self.assertEqual(f.T_STRING_FLD, e.Bfldid("T_STRING_FLD"))
+            self.assertEqual(f.T_CARRAY_FLD, e.Bfldid("T_CARRAY_FLD"))
+            self.assertEqual(f.NAMES[f.T_LONG_FLD], "T_LONG_FLD")
+            w = u.NdrxStopwatch()
+            while w.get_delta_sec() < u.test_duratation():
+                b1 = e.UbfDict({f.T_STRING_FLD:"HELLO", f.T_LONG_FLD:[1, 2]})
+                self.assertEqual(b1.T_STRING_FLD[0], "HELLO")
+                self.assertEqual(b1[f.T_LONG_FLD][1], 2)
+                b1.T_SHORT_FLD = 5
+                self.assertEqual(b1["T_SHORT_FLD"][0], 5)
+                del b1.T_SHORT_FLD
+                self.assertEqual(b1.to_dict(), {"T_STRING_FLD":["HELLO"], "T_LONG_FLD":[1, 2]})
+
+                # reload does not change resolution
+                e.fldtab_load(f.IDS)
+                self.assertEqual(e.Bfname(f.T_LONG_FLD), "T_LONG_FLD")
+
+            # missing field table
+            with self.assertRaises(subprocess.CalledProcessError):
+                subprocess.check_call([sys.executable, mkfldpy,
+                    "-d", tmp, os.path.join(tmp, "no_such.fd")], stderr=subprocess.DEVNULL)
+
+            # names which cannot be module globals
+            for name in ["class", "IDS", "NAMES", "endurox", "1FLD"]:
+                fd = os.path.join(tmp, "bad.fd")
+                with open(fd, "w") as fp:
+                    fp.write("*base 9000\n%s 1 long - 1\n" % name)
+                with self.assertRaises(subprocess.CalledProcessError):
+                    subprocess.check_call([sys.executable, mkfldpy,
+                        "-d", tmp, fd], stderr=subprocess.DEVNULL)
+
 
 if __name__ == '__main__':
     unittest.main()
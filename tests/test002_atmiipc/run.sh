@@ -103,6 +103,58 @@ if [ $RET != 0 ]; then
 fi
 
 
+################################################################################
+echo "Running native routing test"
+################################################################################
+
+python3 -m unittest tproute.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "tproute.py failed"
+    go_out -1
+fi
+
+################################################################################
+echo "Running service cache test"
+################################################################################
+
+python3 -m unittest svccache.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "svccache.py failed"
+    go_out -1
+fi
+
+################################################################################
+echo "Running dispatch instrumentation test"
+################################################################################
+
+python3 -m unittest svcstats.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "svcstats.py failed"
+    go_out -1
+fi
+
+################################################################################
+echo "Running micro-batched service test"
+################################################################################
+
+python3 -m unittest tpbatch.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "tpbatch.py failed"
+    go_out -1
+fi
+
 ################################################################################
 echo "Running tppost test"
 ################################################################################
@@ -182,6 +234,19 @@ if [ $RET != 0 ]; then
     go_out -1
 fi
 
+################################################################################
+echo "Running unsolq test"
+################################################################################
+
+python3 -m unittest unsolq.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "unsolq.py failed"
+    go_out -1
+fi
+
 ################################################################################
 echo "Running tpcancel test"
 ################################################################################
@@ -20,6 +20,28 @@ class Server:
         e.tpadvertise('BCASTSV', 'BCASTSV', Server.BCASTSV)
         e.tpadvertise('TOUT', 'TOUT', Server.TOUT)
 
+        # native routes, not matched goes to ROUTESVC
+        e.tpadvertise_route('ROUTESVC', "T_STRING_FLD=='OK'", 'OKSVC', Server.ROUTESVC)
+        e.tpadvertise_route('ROUTESVC', 'T_STRING_FLD', {'FAIL':'FAILSVC', 'F'*300:'FAILSVC'})
+        # route only service
+        e.tpadvertise_route('ROUTEONLY', "T_STRING_FLD=='OK'", 'OKSVC')
+
+        # cached service, keyed by T_STRING_FLD
+        self.cache_counter = 0
+        e.tpadvertise('CACHESVC', 'CACHESVC', Server.CACHESVC)
+        e.tpadvertise('CACHEINV', 'CACHEINV', Server.CACHEINV)
+        e.ndrxpy_svccache_add('CACHESVC', 2, 60, ['T_STRING_FLD'])
+
+        # micro-batched service, 5 reqs or 200ms
+        e.tpadvertise_batch('BATCHSVC', Server.BATCHSVC, 5, 200000)
+        # batched and cached
+        e.tpadvertise_batch('BATCHCACHE', Server.BATCHSVC, 5, 200000)
+        e.ndrxpy_svccache_add('BATCHCACHE', 100, 60, ['T_STRING_FLD'])
+
+        # dispatch instrumentation
+        e.tpadvertise('STATSSVC', 'STATSSVC', Server.STATSSVC)
+        e.ndrxpy_svcstats_enable(True, 5)
+
         # subscribe to TESTEV event.
         e.tplog_info("ev subs %d" % e.tpsubscribe('TESTEV', None, e.TPEVCTL(name1="EVSVC", flags=e.TPEVSERVICE)))
 
@@ -58,6 +80,51 @@ class Server:
             args.data["data"]["T_STRING_3_FLD"]=args.data["data"]["T_STRING_FLD"][0]
         return e.tpforward("OKSVC", args.data, 0)
 
+    #
+    # Requests not routed natively
+    #
+    def ROUTESVC(self, args):
+        return e.tpreturn(e.TPSUCCESS, 7, args.data)
+
+    #
+    # Return counter, which is cached
+    #
+    def CACHESVC(self, args):
+        self.cache_counter+=1
+        args.data["data"]["T_LONG_FLD"]=self.cache_counter
+        return e.tpreturn(e.TPSUCCESS, 9, args.data)
+
+    #
+    # Drop cache, return stats
+    #
+    def CACHEINV(self, args):
+        st = e.ndrxpy_svccache_stats('CACHESVC')
+        e.ndrxpy_svccache_invalidate('CACHESVC')
+        return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":st["hits"], 
+            "T_LONG_2_FLD":st["misses"], "T_LONG_3_FLD":st["size"]}})
+
+    #
+    # Batch handler, return batch size to each caller
+    #
+    def BATCHSVC(self, reqs):
+        ret = []
+        for r in reqs:
+            r.data["data"]["T_LONG_FLD"]=len(reqs)
+            ret.append((e.TPSUCCESS, 3, r.data))
+        return ret
+
+    #
+    # Return OKSVC dispatch statistics
+    #
+    def STATSSVC(self, args):
+        stats = e.ndrxpy_svcstats_get()
+        if "OKSVC" not in stats:
+            return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":0, 
+                "T_LONG_2_FLD":0, "T_LONG_3_FLD":0}})
+        st = stats["OKSVC"]
+        return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":st["handler"]["count"], 
+            "T_LONG_2_FLD":sum(st["gil"]["hist"]), "T_LONG_3_FLD":st["reply"]["count"]}})
+
     #
     # Just consume event, return NULL buffer.
     #
@@ -0,0 +1,42 @@
+import unittest
+import endurox as e
+import exutils as u
+
+class TestSvccache(unittest.TestCase):
+
+    def call(self, key, other):
+        tperrno, tpurcode, retbuf = e.tpcall("CACHESVC", { "data":{"T_STRING_FLD":key, "T_STRING_2_FLD":other}})
+        self.assertEqual(tperrno, 0)
+        self.assertEqual(tpurcode, 9)
+        self.assertEqual(retbuf["data"]["T_STRING_FLD"][0], key)
+        return retbuf["data"]["T_LONG_FLD"][0]
+
+    # Validate hits, misses and invalidate
+    def test_svccache(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            tperrno, tpurcode, st0 = e.tpcall("CACHEINV", {})
+            self.assertEqual(tperrno, 0)
+
+            a = self.call("A", "X")
+            # not key field, hit
+            self.assertEqual(self.call("A", "Y"), a)
+            b = self.call("B", "X")
+            self.assertNotEqual(a, b)
+            self.assertEqual(self.call("B", "Z"), b)
+            # evicts A (maxsize 2)
+            self.call("C", "X")
+            self.assertNotEqual(self.call("A", "X"), a)
+
+            tperrno, tpurcode, retbuf = e.tpcall("CACHEINV", {})
+            self.assertEqual(tperrno, 0)
+            # stats are cumulative
+            self.assertEqual(retbuf["data"]["T_LONG_FLD"][0] - st0["data"]["T_LONG_FLD"][0], 2)
+            self.assertEqual(retbuf["data"]["T_LONG_2_FLD"][0] - st0["data"]["T_LONG_2_FLD"][0], 4)
+            self.assertEqual(retbuf["data"]["T_LONG_3_FLD"][0], 2)
+
+            # invalidated, new value
+            self.assertNotEqual(self.call("B", "X"), b)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,25 @@
+import unittest
+import endurox as e
+import exutils as u
+
+class TestSvcstats(unittest.TestCase):
+
+    # Validate that OKSVC calls are counted
+    def test_svcstats(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            tperrno, tpurcode, st0 = e.tpcall("STATSSVC", {})
+            self.assertEqual(tperrno, 0)
+
+            for i in range(10):
+                tperrno, tpurcode, retbuf = e.tpcall("OKSVC", { "data":{"T_STRING_FLD":"Hi Jim"}})
+                self.assertEqual(tperrno, 0)
+
+            tperrno, tpurcode, st = e.tpcall("STATSSVC", {})
+            self.assertEqual(tperrno, 0)
+            self.assertEqual(st["data"]["T_LONG_FLD"][0] - st0["data"]["T_LONG_FLD"][0], 10)
+            self.assertEqual(st["data"]["T_LONG_2_FLD"][0], st["data"]["T_LONG_FLD"][0])
+            self.assertEqual(st["data"]["T_LONG_3_FLD"][0], st["data"]["T_LONG_FLD"][0])
+
+if __name__ == '__main__':
+    unittest.main()
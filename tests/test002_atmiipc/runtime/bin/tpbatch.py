@@ -0,0 +1,57 @@
+import unittest
+import endurox as e
+import exutils as u
+
+class TestTpbatch(unittest.TestCase):
+
+    # Full batch
+    def test_tpbatch_full(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            cds = {}
+            for i in range(0, 5):
+                cd = e.tpacall("BATCHSVC", { "data":{"T_STRING_FLD":"REQ%d" % i}})
+                cds[cd] = "REQ%d" % i
+
+            for i in range(0, 5):
+                tperrno, tpurcode, retbuf, cd = e.tpgetrply(0, e.TPGETANY)
+                self.assertEqual(tperrno, 0)
+                self.assertEqual(tpurcode, 3)
+                # each caller gets own reply
+                self.assertEqual(retbuf["data"]["T_STRING_FLD"][0], cds[cd])
+                self.assertEqual(retbuf["data"]["T_LONG_FLD"][0], 5)
+
+    # Batched and cached service, replies are cached under own keys
+    def test_tpbatch_cache(self):
+        w = u.NdrxStopwatch()
+        n = 0
+        while w.get_delta_sec() < u.test_duratation():
+            keys = {}
+            for i in range(0, 5):
+                key = "KEY%d" % (n % 50)
+                n+=1
+                cd = e.tpacall("BATCHCACHE", { "data":{"T_STRING_FLD":key}})
+                keys[cd] = key
+
+            for i in range(0, 5):
+                tperrno, tpurcode, retbuf, cd = e.tpgetrply(0, e.TPGETANY)
+                self.assertEqual(tperrno, 0)
+                self.assertEqual(retbuf["data"]["T_STRING_FLD"][0], keys[cd])
+
+            # served from cache, with own reply
+            for key in keys.values():
+                tperrno, tpurcode, retbuf = e.tpcall("BATCHCACHE", { "data":{"T_STRING_FLD":key}})
+                self.assertEqual(tperrno, 0)
+                self.assertEqual(tpurcode, 3)
+                self.assertEqual(retbuf["data"]["T_STRING_FLD"][0], key)
+
+    # Single request, flushed by timer
+    def test_tpbatch_timeout(self):
+        tperrno, tpurcode, retbuf = e.tpcall("BATCHSVC", { "data":{"T_STRING_FLD":"ONE"}})
+        self.assertEqual(tperrno, 0)
+        self.assertEqual(tpurcode, 3)
+        self.assertEqual(retbuf["data"]["T_STRING_FLD"][0], "ONE")
+        self.assertEqual(retbuf["data"]["T_LONG_FLD"][0], 1)
+
+if __name__ == '__main__':
+    unittest.main()
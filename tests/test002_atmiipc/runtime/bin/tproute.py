@@ -0,0 +1,50 @@
+import unittest
+import endurox as e
+import exutils as u
+
+class TestTproute(unittest.TestCase):
+
+    # Boolean expression route
+    def test_tproute_expr(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            tperrno, tpurcode, retbuf = e.tpcall("ROUTESVC", { "data":{"T_STRING_FLD":"OK"}})
+            self.assertEqual(tperrno, 0)
+            self.assertEqual(tpurcode, 5)
+            self.assertEqual(retbuf["data"]["T_STRING_2_FLD"][0], "OK")
+
+    # Field value map route
+    def test_tproute_valmap(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            tperrno, tpurcode, retbuf = e.tpcall("ROUTESVC", { "data":{"T_STRING_FLD":"FAIL"}})
+            self.assertEqual(tperrno, e.TPESVCFAIL)
+            self.assertEqual(tpurcode, 5)
+            self.assertEqual(retbuf["data"]["T_STRING_2_FLD"][0], "FAIL")
+
+            # values longer than conversion stack buffer
+            tperrno, tpurcode, retbuf = e.tpcall("ROUTESVC", { "data":{"T_STRING_FLD":"F"*300}})
+            self.assertEqual(tperrno, e.TPESVCFAIL)
+            self.assertEqual(tpurcode, 5)
+
+    # Not matched, goes to python
+    def test_tproute_python(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            tperrno, tpurcode, retbuf = e.tpcall("ROUTESVC", { "data":{"T_STRING_FLD":"PY"}})
+            self.assertEqual(tperrno, 0)
+            self.assertEqual(tpurcode, 7)
+            self.assertEqual(retbuf["data"]["T_STRING_FLD"][0], "PY")
+
+    # Route only service, not matched
+    def test_tproute_nomatch(self):
+        log = u.NdrxLogConfig()
+        log.set_lev(e.log_always)
+        tperrno, tpurcode, retbuf = e.tpcall("ROUTEONLY", { "data":{"T_STRING_FLD":"PY"}})
+        self.assertEqual(tperrno, e.TPESVCFAIL)
+        tperrno, tpurcode, retbuf = e.tpcall("ROUTEONLY", { "data":{"T_STRING_FLD":"OK"}})
+        self.assertEqual(tperrno, 0)
+        log.restore()
+
+if __name__ == '__main__':
+    unittest.main()
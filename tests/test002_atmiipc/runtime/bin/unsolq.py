@@ -0,0 +1,54 @@
+import select
+import unittest
+import endurox as e
+import exutils as u
+
+class TestUnsolq(unittest.TestCase):
+
+    # notifications are queued and drained in batches
+    def test_unsolq(self):
+        efd = e.ndrxpy_unsolq_enable(16)
+        st = e.ndrxpy_unsolq_stats()
+        self.assertEqual(st["capacity"], 16)
+        enqueued = st["enqueued"]
+
+        w = u.NdrxStopwatch()
+        cnt = 0
+        while w.get_delta_sec() < u.test_duratation():
+            for i in range(10):
+                tperrno, tpurcode, retbuf = e.tpcall("NOTIFSV", { "data":{"T_STRING_FLD":"Hi Jim"}})
+                self.assertEqual(tperrno, 0)
+                cnt+=1
+
+            r, _, _ = select.select([efd], [], [], 5)
+            self.assertEqual(r, [efd])
+
+            msgs = e.ndrxpy_unsolq_drain(5)
+            self.assertEqual(len(msgs), 5)
+            msgs += e.ndrxpy_unsolq_drain()
+            self.assertEqual(len(msgs), 10)
+            for m in msgs:
+                self.assertEqual(m["data"], "HELLO WORLD")
+
+            # all consumed
+            r, _, _ = select.select([efd], [], [], 0)
+            self.assertEqual(r, [])
+            self.assertEqual(e.ndrxpy_unsolq_drain(), [])
+
+        st = e.ndrxpy_unsolq_stats()
+        self.assertEqual(st["enqueued"], enqueued+cnt)
+        self.assertEqual(st["dropped"], 0)
+        self.assertEqual(st["depth"], 0)
+        self.assertGreaterEqual(st["maxdepth"], 10)
+
+        # overflow
+        for i in range(20):
+            tperrno, tpurcode, retbuf = e.tpcall("NOTIFSV", { "data":{"T_STRING_FLD":"Hi Jim"}})
+            self.assertEqual(tperrno, 0)
+
+        self.assertEqual(len(e.ndrxpy_unsolq_drain()), 16)
+        self.assertEqual(e.ndrxpy_unsolq_stats()["dropped"], 4)
+        e.tpterm()
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,3 +1,6 @@
+import subprocess
+import sys
+import threading
 import unittest
 import endurox as e
 import exutils as u
@@ -117,6 +120,165 @@ class TestTpenqueue(unittest.TestCase):
 
         e.tpclose()
 
+    # batch enqueue/dequeue
+    def test_tpenqueue_many(self):
+        e.tpopen()
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            data = [{"data":"SOME DATA %d" % i} for i in range(100)]
+            qctls = e.tpenqueue_many("SAMPLESPACE", "TESTQ", e.TPQCTL(), data, tran=60)
+            self.assertEqual(len(qctls), 100)
+            self.assertNotEqual(qctls[0].msgid, qctls[1].msgid)
+
+            # no transaction, partial reads
+            msgs = e.tpdequeue_many("SAMPLESPACE", "TESTQ", None, 40)
+            self.assertEqual(len(msgs), 40)
+            msgs += e.tpdequeue_many("SAMPLESPACE", "TESTQ", e.TPQCTL(), 1000, tran=60)
+            self.assertEqual(len(msgs), 100)
+
+            for i in range(100):
+                qctl, retbuf = msgs[i]
+                self.assertEqual(retbuf["data"], "SOME DATA %d" % i)
+                self.assertEqual(qctl.msgid, qctls[i].msgid)
+
+            # empty queue
+            self.assertEqual(e.tpdequeue_many("SAMPLESPACE", "TESTQ", None, 10), [])
+
+            # abort of own transaction
+            try:
+                e.tpenqueue_many("SAMPLESPACE", "NOSUCHQ",
+                    None, data, tran=60)
+            except (e.AtmiException, e.QmException):
+                pass
+            else:
+                self.assertEqual(True,False)
+            self.assertEqual(e.tpgetlev(), 0)
+
+            # failure without transaction reports the failing index
+            try:
+                e.tpenqueue_many("SAMPLESPACE", "NOSUCHQ", None, data)
+            except (e.AtmiException, e.QmException) as ex:
+                self.assertEqual(ex.index, 0)
+                self.assertEqual(ex.results, [])
+            else:
+                self.assertEqual(True,False)
+
+        e.tpclose()
+
+    # native prefetching consumer
+    def test_queue_consumer(self):
+        e.tpopen()
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            data = [{"data":"SOME DATA %d" % i} for i in range(50)]
+            e.tpenqueue_many("SAMPLESPACE", "TESTQ", None, data, tran=60)
+
+            # non transactional, bounded buffer
+            qc = e.QueueConsumer("SAMPLESPACE", "TESTQ", prefetch=10, idle=0.01)
+            got = []
+            self.assertEqual(qc.consume(lambda qctl, buf: got.append(buf["data"]), 50), 50)
+            self.assertEqual(got, [d["data"] for d in data])
+            st = qc.stats()
+            self.assertEqual(st["dequeued"], 50)
+            self.assertEqual(st["delivered"], 50)
+            self.assertLessEqual(st["buffered"], 10)
+            self.assertIsNone(qc.get(0.05))
+            qc.close()
+
+            # no read ahead, closed consumer does not lose messages
+            e.tpenqueue_many("SAMPLESPACE", "TESTQ", None, data[:3], tran=60)
+            qc = e.QueueConsumer("SAMPLESPACE", "TESTQ", prefetch=10, idle=0.01)
+            qctl, buf = qc.get()
+            self.assertEqual(buf["data"], data[0]["data"])
+            qc.close()
+
+            # iteration stops at empty queue
+            qc = e.QueueConsumer("SAMPLESPACE", "TESTQ", idle=0.01)
+            self.assertEqual([buf["data"] for qctl, buf in qc], [d["data"] for d in data[1:3]])
+            qc.close()
+
+            # transactional batches, rollback redelivers
+            e.tpenqueue_many("SAMPLESPACE", "TESTQ", None, data[:20], tran=60)
+            qc = e.QueueConsumer("SAMPLESPACE", "TESTQ", prefetch=5, tran=60, idle=0.01)
+            qctl, buf = qc.get()
+            qc.nack()
+            got = set()
+            for qctl, buf in qc:
+                got.add(buf["data"])
+                if len(got) == 20:
+                    qc.ack()
+                    break
+            qc.close()
+            st = qc.stats()
+            self.assertEqual(st["commits"], 4)
+            self.assertGreaterEqual(st["aborts"], 1)
+            self.assertEqual(e.tpdequeue_many("SAMPLESPACE", "TESTQ", None, 10), [])
+
+            # transactional iteration stops at empty queue
+            qc = e.QueueConsumer("SAMPLESPACE", "TESTQ", prefetch=5, tran=60, idle=0.01)
+            self.assertEqual(list(qc), [])
+            qc.close()
+
+        e.tpclose()
+
+    # shared transactions for many threads
+    def test_group_commit(self):
+        e.tpopen()
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            gc = e.GroupCommitWriter(max_batch=50, max_delay=0.01)
+            futs = []
+
+            def producer(n):
+                for i in range(25):
+                    futs.append(gc.enqueue("SAMPLESPACE", "TESTQ", None, {"data":"GC %d %d" % (n, i)}))
+
+            threads = [threading.Thread(target=producer, args=(n,)) for n in range(8)]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+
+            msgids = set(f.result(60).msgid for f in futs)
+            self.assertEqual(len(msgids), 200)
+
+            # UbfDict is copied at submit
+            ub = e.UbfDict({"T_STRING_FLD":"GC DICT"})
+            fut = gc.enqueue("SAMPLESPACE", "TESTQ", None, {"data":ub})
+            del ub
+            fut.result(60)
+
+            # failed batch completes every future with the error
+            fut = gc.enqueue("SAMPLESPACE", "NOSUCHQ", None, {"data":"GC"})
+            with self.assertRaises((e.AtmiException, e.QmException)):
+                fut.result(60)
+
+            gc.close()
+            st = gc.stats()
+            self.assertEqual(st["messages"], 202)
+            self.assertEqual(st["failed"], 1)
+            self.assertLess(st["batches"], 202)
+            self.assertLessEqual(st["batch_max"], 50)
+
+            with self.assertRaises(e.AtmiException):
+                gc.enqueue("SAMPLESPACE", "TESTQ", None, {"data":"GC"})
+
+            msgs = e.tpdequeue_many("SAMPLESPACE", "TESTQ", None, 1000)
+            self.assertEqual(len(msgs), 201)
+            ubfs = [buf["data"] for qctl, buf in msgs if buf["buftype"]=="UBF"]
+            self.assertEqual(len(ubfs), 1)
+            self.assertEqual(ubfs[0]["T_STRING_FLD"][0], "GC DICT")
+
+        # writer not closed is flushed at exit, without hang
+        subprocess.run([sys.executable, "-c", "import endurox as e\n"
+            "gc = e.GroupCommitWriter()\n"
+            "gc.enqueue('SAMPLESPACE', 'TESTQ', None, {'data':'GC EXIT'})\n"],
+            timeout=60, check=True)
+        msgs = e.tpdequeue_many("SAMPLESPACE", "TESTQ", None, 10)
+        self.assertEqual([buf["data"] for qctl, buf in msgs], ["GC EXIT"])
+
+        e.tpclose()
+
     # enq/deq by corrid
     def test_tpenqueue_tpabort(self):
         e.tpopen()
@@ -13,6 +13,7 @@ export TEST_OUT=`pwd`/test.out
 #
 source ~/ndrx_home
 export PYTHONPATH=`pwd`/../libs
+export PATH=`pwd`/../../scripts:$PATH
 
 TIMES=200
 pushd .
@@ -61,6 +62,12 @@ echo "Memck pid = $MEMCK_PID"
 cd ../bin
 # Be on safe side...
 unset NDRX_CCTAG 
+
+# warm parent for zygotesv.py instances
+expyzygote serve -s $NDRX_APPHOME/zygote.sock -m zygotesv:Server &
+export ZYGOTE_PID=$!
+sleep 1
+
 xadmin start -y
 xadmin psc
 #
@@ -71,6 +78,7 @@ function go_out {
     xadmin stop -y
     xadmin down -y
     kill -9 $MEMCK_PID
+    kill $ZYGOTE_PID
 
     popd 2>/dev/null
     exit $1
@@ -141,6 +149,19 @@ if [ $RET != 0 ]; then
     go_out -1
 fi
 
+################################################################################
+echo "Running timer wheel test"
+################################################################################
+
+python3 -m unittest timercl.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "timercl.py failed"
+    go_out -1
+fi
+
 ################################################################################
 echo "Running fdpoller test"
 ################################################################################
@@ -180,6 +201,32 @@ if [ $RET != 0 ]; then
     go_out -1
 fi
 
+################################################################################
+echo "Running zygotecl.py test"
+################################################################################
+
+python3 -m unittest zygotecl.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "zygotecl.py failed"
+    go_out -1
+fi
+
+################################################################################
+echo "Running aiocl.py test"
+################################################################################
+
+python3 -m unittest aiocl.py
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "aiocl.py failed"
+    go_out -1
+fi
+
 ################################################################################
 echo "Running stdcfgstr.py test"
 ################################################################################
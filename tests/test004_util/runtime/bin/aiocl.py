@@ -0,0 +1,47 @@
+import unittest
+import os
+import socket
+import time
+import endurox as e
+import exutils as u
+
+class TestAio(unittest.TestCase):
+
+    # asyncio unix socket server shall serve along with ATMI services
+    def test_aio_socket(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+            s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            s.connect(os.path.join(os.environ["NDRX_APPHOME"], "aio.sock"))
+            s.sendall(b"HELLO\n")
+            self.assertEqual(s.makefile("rb").readline(), b"HELLO\n")
+            s.close()
+
+            tperrno, tpurcode, retbuf = e.tpcall("AIOGET", {})
+            self.assertEqual(tperrno, 0)
+
+    # timers scheduled by service shall fire
+    def test_aio_timer(self):
+        tperrno, tpurcode, retbuf = e.tpcall("AIOGET", {})
+        self.assertEqual(tperrno, 0)
+        ticks = retbuf["data"]["T_LONG_FLD"][0]
+
+        for i in range(3):
+            tperrno, tpurcode, retbuf = e.tpcall("AIOTICK", {})
+            self.assertEqual(tperrno, 0)
+
+        time.sleep(1)
+        tperrno, tpurcode, retbuf = e.tpcall("AIOGET", {})
+        self.assertEqual(tperrno, 0)
+        self.assertEqual(retbuf["data"]["T_LONG_FLD"][0], ticks+3)
+
+    # user before poll callback shall be kept by the loop
+    def test_aio_b4poll_chained(self):
+        tperrno, tpurcode, retbuf = e.tpcall("AIOGET", {})
+        self.assertEqual(tperrno, 0)
+        tperrno, tpurcode, retbuf = e.tpcall("AIOGET", {})
+        self.assertEqual(tperrno, 0)
+        self.assertGreater(retbuf["data"]["T_SHORT_FLD"][0], 0)
+
+if __name__ == '__main__':
+    unittest.main()
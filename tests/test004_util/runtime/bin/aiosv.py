@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+
+import sys
+import os
+import asyncio
+import endurox as e
+import endurox.aio
+
+SOCK = os.path.join(os.environ["NDRX_APPHOME"], "aio.sock")
+
+class Server:
+
+    async def echo(self, reader, writer):
+        data = await reader.readline()
+        writer.write(data)
+        await writer.drain()
+        writer.close()
+
+    async def tick(self):
+        await asyncio.sleep(0.2)
+        self.ticks+=1
+
+    def b4poll(self):
+        self.b4polls+=1
+        return 0
+
+    def tpsvrinit(self, args):
+        e.userlog('asyncio server startup')
+        self.ticks = 0
+        self.b4polls = 0
+        # user callback shall survive the loop install
+        e.tpext_addb4pollcb(self.b4poll)
+        self.loop = endurox.aio.install()
+        self.loop.create_task(asyncio.start_unix_server(self.echo, path=SOCK))
+        e.tpadvertise('AIOTICK', 'AIOTICK', Server.AIOTICK)
+        e.tpadvertise('AIOGET', 'AIOGET', Server.AIOGET)
+        return 0
+
+    def tpsvrdone(self):
+        e.userlog('asyncio server shutdown')
+        endurox.aio.uninstall()
+
+    # schedule coroutine from the service
+    def AIOTICK(self, args):
+        self.loop.create_task(self.tick())
+        return e.tpreturn(e.TPSUCCESS, 0, {})
+
+    def AIOGET(self, args):
+        return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":self.ticks, "T_SHORT_FLD":min(self.b4polls, 100)}})
+
+if __name__ == '__main__':
+    e.tprun(Server(), sys.argv)
@@ -13,6 +13,11 @@ obj = SomeClass()
 
 POLLIN = select.POLLIN
 
+# batched fd
+outb = None
+pathb = "/tmp/tmp_py_b"
+M_batchcnt = 0
+
 #
 # se
 #
@@ -58,6 +63,20 @@ def cb(fd, events, ptr1):
     e.tpext_addpollerfd(outx, POLLIN, obj, cb)
     return 0
 
+#
+# batch callback, receives list of (fd, events, ptr1)
+#
+def cbbatch(events):
+    global M_batchcnt
+    for fd, ev, ptr1 in events:
+        assert fd == outb
+        assert ptr1 == "batch"
+        try:
+            M_batchcnt+=len(os.read(fd, 1024))
+        except io.BlockingIOError:
+            pass
+    return 0
+
 #
 # first time poller init...
 #
@@ -67,6 +86,7 @@ def b4poll():
     global outx
     global POLLIN
     e.tpext_addpollerfd(outx, POLLIN, obj, cb)
+    e.tpext_addpollerfd(outb, POLLIN, "batch", cbbatch, batch=True)
     e.tpext_delb4pollcb()
     return 0
 #
@@ -82,8 +102,13 @@ class Server:
         os.remove(path) if os.path.exists(path) else None
         os.mkfifo( path, 0O644 )
         outx = os.open(path, os.O_NONBLOCK | os.O_RDWR)
+        global outb
+        os.remove(pathb) if os.path.exists(pathb) else None
+        os.mkfifo( pathb, 0O644 )
+        outb = os.open(pathb, os.O_NONBLOCK | os.O_RDWR)
         e.tpext_addb4pollcb(b4poll)
         e.tpadvertise('POLLERSYNC', 'POLLERSYNC', Server.POLLERSYNC)
+        e.tpadvertise('POLLERBATCH', 'POLLERBATCH', Server.POLLERBATCH)
 
         # configure OS specifics
         if 'kqueue' == e.ndrx_epoll_mode():
@@ -97,11 +122,17 @@ class Server:
         global path
         os.close(outx)
         os.remove(path) if os.path.exists(path) else None
+        os.close(outb)
+        os.remove(pathb) if os.path.exists(pathb) else None
         e.userlog('Server shutdown')
 
     def POLLERSYNC(self, args):
         return e.tpreturn(e.TPSUCCESS, 0, {})
 
+    # bytes received by batch callback
+    def POLLERBATCH(self, args):
+        return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":M_batchcnt}})
+
 
 if __name__ == '__main__':
     e.tprun(Server(), sys.argv)
@@ -43,6 +43,22 @@ class TestFdpoll(unittest.TestCase):
 
         self.assertEqual(sent, handled)
 
+    # batch callback
+    def test_fdpoll_batch(self):
+        tperrno, _, retbuf = e.tpcall("POLLERBATCH", {})
+        self.assertEqual(tperrno, 0)
+        cnt = retbuf["data"]["T_LONG_FLD"][0]
+
+        for i in range(10):
+            outx = os.open("/tmp/tmp_py_b", os.O_WRONLY)
+            os.write(outx, b'\x65')
+            os.close(outx)
+
+        time.sleep( 1 )
+        tperrno, _, retbuf = e.tpcall("POLLERBATCH", {})
+        self.assertEqual(tperrno, 0)
+        self.assertEqual(retbuf["data"]["T_LONG_FLD"][0], cnt+10)
+
 if __name__ == '__main__':
     unittest.main()
 
@@ -0,0 +1,31 @@
+import unittest
+import endurox as e
+import time
+
+class TestTimer(unittest.TestCase):
+
+    # timer wheel callbacks
+    def test_timer(self):
+
+        time.sleep( 2 )
+
+        tperrno, _, retbuf = e.tpcall("TIMERSTATS", {})
+        self.assertEqual(tperrno, 0)
+        every, once, selfcnl, svc = retbuf["data"]["T_LONG_FLD"]
+        # 50ms period, allow some jitter
+        self.assertGreater(every, 20)
+        self.assertEqual(once, 1)
+        self.assertEqual(selfcnl, 3)
+
+        tperrno, _, retbuf = e.tpcall("TIMERADD", {})
+        self.assertEqual(tperrno, 0)
+        time.sleep( 1 )
+
+        tperrno, _, retbuf = e.tpcall("TIMERSTATS", {})
+        self.assertEqual(tperrno, 0)
+        self.assertEqual(retbuf["data"]["T_LONG_FLD"][1], 1)
+        self.assertEqual(retbuf["data"]["T_LONG_FLD"][2], 3)
+        self.assertEqual(retbuf["data"]["T_LONG_FLD"][3], svc+10)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+import sys
+import endurox as e
+
+# fire counters
+M_every = 0
+M_once = 0
+M_self = 0
+M_svc = 0
+
+def every():
+    global M_every
+    M_every+=1
+
+def once():
+    global M_once
+    M_once+=1
+
+# cancels itself at 3rd fire
+def selfcancel():
+    global M_self
+    M_self+=1
+    if M_self >= 3:
+        e.ndrxpy_timer_cancel(M_selfid)
+
+def fromsvc():
+    global M_svc
+    M_svc+=1
+
+#
+# Test timer wheel
+#
+class Server:
+
+    def tpsvrinit(self, args):
+        global M_selfid
+        e.userlog('Server startup')
+        e.ndrxpy_call_every(0.05, every)
+        e.ndrxpy_call_later(0.1, once)
+        M_selfid = e.ndrxpy_call_every(0.01, selfcancel)
+        # cancelled before fire
+        e.ndrxpy_timer_cancel(e.ndrxpy_call_later(0.01, once))
+        e.tpadvertise('TIMERADD', 'TIMERADD', Server.TIMERADD)
+        e.tpadvertise('TIMERSTATS', 'TIMERSTATS', Server.TIMERSTATS)
+        return 0
+
+    def tpsvrdone(self):
+        e.userlog('Server shutdown')
+
+    # add timers from service
+    def TIMERADD(self, args):
+        for i in range(10):
+            e.ndrxpy_call_later(0.001*i, fromsvc)
+        return e.tpreturn(e.TPSUCCESS, 0, {})
+
+    def TIMERSTATS(self, args):
+        return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":[M_every, 
+            M_once, M_self, M_svc]}})
+
+if __name__ == '__main__':
+    e.tprun(Server(), sys.argv)
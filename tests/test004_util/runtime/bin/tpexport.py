@@ -1,3 +1,4 @@
+import io
 import unittest
 import endurox as e
 import exutils as u
@@ -18,7 +19,58 @@ class TestTpexport(unittest.TestCase):
             buf=e.tpexport({"buftype":"UBF", "data":{"T_STRING_FLD":["HELLO TEST", "HELLO 2"]}}, e.TPEX_STRING)
             buf2=e.tpimport(buf, e.TPEX_STRING)
             self.assertEqual( (buf2=={"buftype":"UBF", "data":{"T_STRING_FLD":["HELLO TEST", "HELLO 2"]}}), True)
-            
+
+    def test_tpexport_stream(self):
+        w = u.NdrxStopwatch()
+        while w.get_delta_sec() < u.test_duratation():
+
+            # caller buffer reuse
+            out = bytearray(b"x" * 10000)
+            n = e.tpexport_into({"buftype":"UBF", "data":{"T_STRING_FLD":"HELLO TEST"}}, out)
+            self.assertEqual(n, len(out))
+            self.assertEqual(bytes(out), e.tpexport({"buftype":"UBF", "data":{"T_STRING_FLD":"HELLO TEST"}}))
+            n = e.tpexport_into({"data":"HELLO"}, out, e.TPEX_STRING)
+            self.assertEqual(e.tpimport(out.decode(), e.TPEX_STRING), {"buftype":"STRING", "data":"HELLO"})
+
+            # newline delimited records
+            bufs = [{"buftype":"UBF", "data":{"T_STRING_FLD":"REC %d" % i, "T_LONG_FLD":i}} for i in range(1000)]
+            for flags in [0, e.TPEX_STRING]:
+                f = io.BytesIO()
+                self.assertEqual(e.tpexport_many(bufs, f, flags), 1000)
+                self.assertEqual(f.getvalue().count(b"\n"), 1000)
+                f.seek(0)
+                got = list(e.tpimport_iter(f, flags))
+                self.assertEqual(len(got), 1000)
+                for i in range(1000):
+                    self.assertEqual(got[i]["data"]["T_STRING_FLD"][0], "REC %d" % i)
+                    self.assertEqual(got[i]["data"]["T_LONG_FLD"][0], i)
+
+            # records with different fields, nothing of the previous remains
+            bufs = [{"buftype":"UBF", "data":{"T_STRING_FLD":"A", "T_LONG_FLD":1}},
+                {"buftype":"UBF", "data":{"T_SHORT_FLD":2}},
+                {"buftype":"UBF", "data":{"T_STRING_2_FLD":"B"}},
+                {"data":"STR"},
+                {"buftype":"UBF", "data":{"T_LONG_FLD":3}}]
+            f = io.BytesIO()
+            e.tpexport_many(bufs, f)
+            f.seek(0)
+            self.assertEqual(list(e.tpimport_iter(f)), bufs[:3] + [{"buftype":"STRING", "data":"STR"}, bufs[4]])
+
+            # UbfDict input (no length known) larger than the initial estimate
+            big = e.UbfDict({"T_STRING_FLD":["X" * 1000] * 100, "T_SHORT_FLD":list(range(2000))})
+            exp = e.tpexport({"data":big})
+            self.assertGreater(len(exp), 100000)
+            self.assertEqual(e.tpimport(exp)["data"], big.to_dict())
+            out = bytearray()
+            self.assertEqual(e.tpexport_into({"data":big}, out), len(exp))
+            self.assertEqual(bytes(out), exp)
+            f = io.BytesIO()
+            e.tpexport_many([{"data":big}], f)
+            self.assertEqual(f.getvalue(), exp + b"\n")
+
+            # text mode, empty lines
+            f = io.StringIO("\n" + e.tpexport({"data":"HELLO"}).decode() + "\n\n")
+            self.assertEqual(list(e.tpimport_iter(f)), [{"buftype":"STRING", "data":"HELLO"}])
 
 if __name__ == '__main__':
     unittest.main()
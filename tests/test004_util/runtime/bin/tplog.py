@@ -4,6 +4,7 @@ import os
 import time
 import subprocess
 import glob
+import logging
 from subprocess import PIPE
 
 #
@@ -50,6 +51,139 @@ class TestTplog(unittest.TestCase):
 
         e.tpterm()
 
+    # cached level and lazy formatting
+    def test_tplog_lazy(self):
+        e.tpinit()
+
+        filename = "%s/tplog_lazy" % e.tuxgetenv('NDRX_ULOG')
+        os.remove(filename) if os.path.exists(filename) else None
+        e.tplogconfig(e.LOG_FACILITY_TP, e.log_info, None, "TEST", filename)
+
+        self.assertEqual(e.tplog_level(), e.log_info)
+        self.assertTrue(e.tplog_isenabledfor(e.log_info))
+        self.assertFalse(e.tplog_isenabledfor(e.log_debug))
+
+        class Bomb:
+            def __str__(self):
+                raise Exception("must not be formatted")
+
+        e.tplog_debug("HELLO %s", Bomb())
+        e.tplog(e.log_debug, "HELLO %s", Bomb())
+
+        e.tplog_info("HELLO %s %d", "LAZY", 5)
+        self.assertEqual(chk_file(filename, "HELLO LAZY 5"), 1)
+        e.tplog_info("HELLO %(name)s", {"name":"MAPPED"})
+        self.assertEqual(chk_file(filename, "HELLO MAPPED"), 1)
+
+        # cache is refreshed by config change
+        e.tplogconfig(e.LOG_FACILITY_TP, -1, "tp=5", None, None)
+        self.assertTrue(e.tplog_isenabledfor(e.log_debug))
+        e.tplog_debug("HELLO %s", "DEBUG2")
+        self.assertEqual(chk_file(filename, "HELLO DEBUG2"), 1)
+        self.assertEqual(e.tplog_level(True), e.log_debug)
+
+        e.tpterm()
+
+    # logging module handler
+    def test_tplog_handler(self):
+        e.tpinit()
+
+        filename = "%s/tplog_handler" % e.tuxgetenv('NDRX_ULOG')
+        filename_req = "%s/tplog_handler_req" % e.tuxgetenv('NDRX_ULOG')
+        os.remove(filename) if os.path.exists(filename) else None
+        os.remove(filename_req) if os.path.exists(filename_req) else None
+        e.tplogconfig(e.LOG_FACILITY_TP, e.log_info, None, "TEST", filename)
+
+        log = logging.getLogger("tplogtest")
+        log.setLevel(logging.DEBUG)
+        h = e.TplogHandler(fmt="%(name)s:%(levelname)-5s:%(lineno)d: %(message)s %%")
+        self.assertIsInstance(h, logging.Handler)
+        log.addHandler(h)
+
+        log.info("HELLO %s", "HANDLER")
+        self.assertEqual(chk_file(filename, "tplogtest:INFO :"), 1)
+        self.assertEqual(chk_file(filename, "HELLO HANDLER %"), 1)
+
+        # level is checked before formatting
+        log.debug("HELLO %s", "NODEBUG")
+        self.assertEqual(chk_file(filename, "NODEBUG"), 0)
+
+        try:
+            raise Exception("HANDLER EXC")
+        except Exception:
+            log.exception("FAILED")
+        self.assertEqual(chk_file(filename, "Exception: HANDLER EXC"), 1)
+
+        # request file routing
+        e.tplogsetreqfile_direct(filename_req)
+        log.warning("HELLO REQ")
+        e.tplogclosereqfile()
+        self.assertEqual(chk_file(filename_req, "HELLO REQ"), 1)
+        self.assertEqual(chk_file(filename, "HELLO REQ"), 0)
+
+        # python formatter takes precedence
+        h.setFormatter(logging.Formatter("FMT %(message)s"))
+        log.error("HELLO FORMATTER")
+        self.assertEqual(chk_file(filename, "FMT HELLO FORMATTER"), 1)
+
+        log.removeHandler(h)
+        with self.assertRaises(ValueError):
+            e.TplogHandler(fmt="%(message)")
+
+        e.tpterm()
+
+    # background writer
+    def test_tplog_async(self):
+        e.tpinit()
+
+        filename = "%s/tplog_async" % e.tuxgetenv('NDRX_ULOG')
+        filename_req = "%s/tplog_async_req" % e.tuxgetenv('NDRX_ULOG')
+        os.remove(filename) if os.path.exists(filename) else None
+        os.remove(filename_req) if os.path.exists(filename_req) else None
+        e.tplogconfig(e.LOG_FACILITY_TP, e.log_info, None, "TEST", filename)
+
+        e.tplog_async(True)
+        for i in range(100):
+            e.tplog_info("ASYNC %d" % i)
+
+        # request file of the caller is kept
+        e.tplogsetreqfile_direct(filename_req)
+        e.tplog_info("ASYNC REQ")
+        e.tplogclosereqfile()
+        e.tplog_info("ASYNC LAST")
+        e.tplog_flush()
+
+        self.assertEqual(chk_file(filename, "ASYNC 99"), 1)
+        self.assertEqual(chk_file(filename, "ASYNC LAST"), 1)
+        self.assertEqual(chk_file(filename, "ASYNC REQ"), 0)
+        self.assertEqual(chk_file(filename_req, "ASYNC REQ"), 1)
+
+        with open(filename) as f:
+            data = f.read()
+        self.assertLess(data.index("ASYNC 9\n"), data.index("ASYNC 10\n"))
+
+        st = e.tplog_async_stats()
+        self.assertTrue(st["enabled"])
+        self.assertEqual(st["written"], st["enqueued"])
+
+        # forked child has no writer thread, logs synchronously
+        pid = os.fork()
+        if 0 == pid:
+            e.tplog_info("ASYNC CHILD")
+            e.tplog_flush()
+            os._exit(1 if e.tplog_async_stats()["enabled"] else 0)
+        self.assertEqual(os.waitpid(pid, 0)[1], 0)
+        self.assertEqual(chk_file(filename, "ASYNC CHILD"), 1)
+
+        e.tplog_async(False)
+        self.assertFalse(e.tplog_async_stats()["enabled"])
+
+        # sync mode again
+        e.tplog_info("SYNC AGAIN")
+        self.assertEqual(chk_file(filename, "SYNC AGAIN"), 1)
+
+        e.tpterm()
+
     # request logging...
     def test_tplog_reqfile(self):
         e.tpinit()
@@ -0,0 +1,15 @@
+import unittest
+import os
+import endurox as e
+import exutils as u
+
+class TestZygote(unittest.TestCase):
+
+    # Instance shall be forked by zygote
+    def test_zygote(self):
+        tperrno, tpurcode, retbuf = e.tpcall("ZYGSVC", {})
+        self.assertEqual(tperrno, 0)
+        self.assertEqual(retbuf["data"]["T_LONG_2_FLD"][0], int(os.environ["ZYGOTE_PID"]))
+
+if __name__ == '__main__':
+    unittest.main()
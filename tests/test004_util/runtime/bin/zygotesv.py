@@ -0,0 +1,23 @@
+#!/usr/bin/env python3
+
+import os
+import sys
+import endurox as e
+
+class Server:
+
+    def tpsvrinit(self, args):
+        e.userlog('Zygote server startup')
+        e.tpadvertise('ZYGSVC', 'ZYGSVC', Server.ZYGSVC)
+        return 0
+
+    def tpsvrdone(self):
+        e.userlog('Zygote server shutdown')
+
+    # return instance pid and parent pid (zygote)
+    def ZYGSVC(self, args):
+        return e.tpreturn(e.TPSUCCESS, 0, {"data":{"T_LONG_FLD":os.getpid(), 
+            "T_LONG_2_FLD":os.getppid()}})
+
+if __name__ == '__main__':
+    e.tprun(Server(), sys.argv)
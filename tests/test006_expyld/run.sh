@@ -446,6 +446,58 @@ fi
 
 popd
 
+################################################################################
+echo ">>> Compiler test010_static, endurox module linked statically"
+################################################################################
+cleanup
+pushd .
+
+cd tmp
+
+# archive from in-source build with cmake -DNDRXPY_STATIC=ON,
+# otherwise build it here
+ARCHIVE=`pwd`/../../../libendurox.a
+
+if [ ! -f $ARCHIVE ]; then
+
+    echo "$ARCHIVE not found, building"
+    mkdir static
+    (cd static && cmake -DNDRXPY_STATIC=ON ../../../.. && \
+        cmake --build . --target endurox_static)
+    RET=$?
+    if [ $RET != 0 ]; then
+        echo "test010 failed to build libendurox.a $RET"
+        go_out -1
+    fi
+
+    ARCHIVE=`pwd`/static/libendurox.a
+fi
+
+expyld -m ../src/test010_static/main.py -o test010 -i endurox -n -s endurox.endurox=$ARCHIVE
+RET=$?
+if [ $RET != 0 ]; then
+    echo "test010 failed to compile $RET"
+    go_out -1
+fi
+
+OUT=`./test010`
+
+RET=$?
+
+if [ $RET != 0 ]; then
+    echo "test010 failed to exec: $RET"
+    go_out -1
+fi
+
+expected='True'
+
+if [ "$OUT" != "$expected" ]; then
+    echo "test010 failed: expected [$expected] got [$OUT]"
+    go_out 1
+fi
+
+popd
+
 ###############################################################################
 echo ">>> Done"
 ###############################################################################
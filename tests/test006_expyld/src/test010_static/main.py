@@ -0,0 +1,7 @@
+# endurox module linked in the binary
+import sys
+import endurox as e
+
+if __name__ == "__main__":
+   e.tplog_info("static binary")
+   print("endurox.endurox" in sys.builtin_module_names)